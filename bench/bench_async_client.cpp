@@ -0,0 +1,78 @@
+#include "bench/bench_util.h"
+#include "include/async_client.h"
+#include <limits>
+
+/**
+ * Compare a strategy that waits for every response, like TCPClient, with the
+ * AsyncClient keeping a window of orders in flight. Every order is placed and
+ * deleted again, so the book stays empty.
+ *
+ *   ./bench_async_client [orders] [window] [port]
+ */
+int main(int argc, char **argv) {
+  uint64_t numOrders = argc > 1 ? std::stoull(argv[1]) : 50000;
+  uint32_t window = argc > 2 ? std::stoul(argv[2]) : 256;
+  std::string port = argc > 3 ? argv[3] : "4107";
+
+  ServerConfig config;
+  config.BuyLimit = std::numeric_limits<uint64_t>::max();
+  config.SellLimit = std::numeric_limits<uint64_t>::max();
+  config.SnapshotFile = "/dev/null";
+  bench::start_server(port, config);
+  std::cerr.rdbuf(nullptr);
+
+  // One round trip per request
+  int fd = bench::connect_loopback(port);
+  auto start = bench::Clock::now();
+  for (uint64_t id = 1; id <= numOrders; ++id) {
+    bench::place_order(fd, id % 8 + 1, id, 1, 10000, 'B');
+    Message<DeleteOrder> msg;
+    std::memset(&msg, 0, sizeof(msg));
+    bench::prepare_header(msg);
+    msg.data.orderId = id;
+    bench::round_trip<OrderResponse>(fd, msg);
+  }
+  double blockingNs = bench::elapsed_ns(start);
+
+  // A window of requests in flight, in both protocol versions
+  for (uint16_t version : {PROTOCOL_V1, PROTOCOL_V2}) {
+    AsyncClient client{window};
+    if (!client.connect("127.0.0.1", port, version)) {
+      return 1;
+    }
+
+    uint64_t accepted = 0;
+    auto count = [&accepted](OrderResponse const &resp) {
+      accepted += resp.status == OrderResponse::Status::ACCEPTED;
+    };
+    auto delete_it = [&client, &count](OrderResponse const &resp) {
+      client.delete_order(resp.orderId, count); // its own slot was freed
+    };
+
+    start = bench::Clock::now();
+    uint64_t next = 1;
+    while (next <= numOrders || client.in_flight() != 0) {
+      // keep a slot free so every response can send its delete
+      while (next <= numOrders && client.in_flight() + 1 < window) {
+        client.new_order(next % 8 + 1, next, 1, 10000, 'B', delete_it);
+        ++next;
+      }
+      if (!client.poll(100)) {
+        return 1;
+      }
+    }
+    double asyncNs = bench::elapsed_ns(start);
+    if (accepted != numOrders) {
+      std::printf("only %lu of %lu deletes were accepted\n", accepted,
+                  numOrders);
+      return 1;
+    }
+
+    std::printf("v%u window %u: %8.0f orders/s, %.1f frames per writev\n",
+                client.version(), window, numOrders / (asyncNs / 1e9),
+                client.frames_per_batch());
+  }
+  std::printf("one at a time: %8.0f orders/s\n",
+              numOrders / (blockingNs / 1e9));
+  return 0;
+}
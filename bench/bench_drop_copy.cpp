@@ -0,0 +1,148 @@
+#include "bench/bench_util.h"
+#include "include/drop_copy.h"
+#include <algorithm>
+#include <sys/un.h>
+#include <vector>
+
+/**
+ * Publish a stream of decisions to the drop copy feed in sweeps the way the
+ * risk loop does, with a few subscribers reading as fast as they can and one
+ * that never reads. The publish cost is timed on the publishing thread, every
+ * reading subscriber is checked to receive the events in order without gaps
+ * other than the events the ring had no room for, and the stalled subscriber
+ * is expected to be detached.
+ *
+ *   ./bench_drop_copy [events] [subscribers] [events per sweep]
+ */
+struct Received {
+  uint64_t Events{0};
+  uint64_t Gaps{0};
+};
+
+static int connect_feed(std::string const &path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1) {
+    std::perror("bench connect: ");
+    exit(1);
+  }
+  DropCopyHeader header;
+  if (recv(fd, &header, sizeof(header), MSG_WAITALL) != sizeof(header) ||
+      header.Magic != DROP_COPY_MAGIC) {
+    std::printf("bad drop copy header\n");
+    exit(1);
+  }
+  return fd;
+}
+
+/// Read the feed until it stays quiet for a while
+static void read_feed(int fd, Received &received) {
+  timeval timeout{.tv_sec = 1, .tv_usec = 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  std::vector<DropCopyEvent> events(1024);
+  size_t filled = 0; // bytes of a partially received event
+  uint64_t next = 0;
+  while (true) {
+    char *out = reinterpret_cast<char *>(events.data());
+    ssize_t n = recv(fd, out + filled,
+                     events.size() * sizeof(DropCopyEvent) - filled, 0);
+    if (n <= 0) {
+      break;
+    }
+    filled += static_cast<size_t>(n);
+    size_t complete = filled / sizeof(DropCopyEvent);
+    for (size_t i = 0; i < complete; ++i) {
+      received.Gaps += events[i].Sequence != next;
+      next = events[i].Sequence + 1;
+    }
+    received.Events += complete;
+    filled -= complete * sizeof(DropCopyEvent);
+    std::memmove(out, out + complete * sizeof(DropCopyEvent), filled);
+  }
+  close(fd);
+}
+
+static uint64_t metric_value(std::string const &name) {
+  std::istringstream lines(Metrics::render());
+  std::string line;
+  while (std::getline(lines, line)) {
+    if (line.compare(0, name.size() + 1, name + " ") == 0) {
+      return std::stoull(line.substr(name.size() + 1));
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  uint64_t total = argc > 1 ? std::stoull(argv[1]) : 1000000;
+  unsigned readers = argc > 2 ? std::stoul(argv[2]) : 2;
+  uint64_t sweep = argc > 3 ? std::stoull(argv[3]) : 64;
+  std::string path = "/tmp/bench_drop_copy.sock";
+  FastClock::calibrate();
+
+  DropCopy copies;
+  if (!copies.start(path)) {
+    return 1;
+  }
+  std::vector<Received> received(readers);
+  std::vector<std::jthread> threads;
+  for (unsigned i = 0; i < readers; ++i) {
+    int fd = connect_feed(path);
+    threads.emplace_back([fd, &received, i] { read_feed(fd, received[i]); });
+  }
+  int stalled = connect_feed(path); // never read
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  DropCopyEvent event;
+  event.TraderId = 1;
+  event.MessageType = 1;
+  event.Quantity = 10;
+  event.Price = 10000;
+  event.Side = 'B';
+  std::vector<double> sweeps;
+  sweeps.reserve(total / sweep + 1);
+  auto start = bench::Clock::now();
+  for (uint64_t i = 0; i < total; i += sweep) {
+    auto sweepStart = bench::Clock::now();
+    for (uint64_t j = i; j < std::min(i + sweep, total); ++j) {
+      event.OrderId = j;
+      event.ListingId = j % 64;
+      copies.publish(event);
+    }
+    sweeps.push_back(bench::elapsed_ns(sweepStart));
+    copies.flush();
+    std::this_thread::yield(); // the loop would wait in poll here
+  }
+  double elapsed = bench::elapsed_ns(start);
+  threads.clear();
+  close(stalled);
+
+  uint64_t lost = metric_value("risk_drop_copy_lost_total");
+  uint64_t detached = metric_value("risk_drop_copy_detached_total");
+  bool valid = detached >= 1;
+  std::sort(sweeps.begin(), sweeps.end());
+  std::printf("%lu events to %u subscribers and a stalled one, %lu per sweep\n",
+              total, readers, sweep);
+  // a sweep that woke the fan-out thread may have been preempted by it
+  std::printf("publish       %8.1f ns/event, sweep p50 %6.0f p99 %8.0f ns\n",
+              sweeps[sweeps.size() / 2] / sweep, sweeps[sweeps.size() / 2],
+              sweeps[sweeps.size() * 99 / 100]);
+  std::printf("feed          %8.1f ns/event with the subscribers\n",
+              elapsed / total);
+  std::printf("lost          %8lu events, stalled subscriber %s\n", lost,
+              detached >= 1 ? "detached" : "still attached");
+  for (unsigned i = 0; i < readers; ++i) {
+    // a reader may only miss the events that never made it into the ring
+    valid = valid && received[i].Events + lost == total;
+    std::printf("subscriber %u  %8lu events, %lu gaps\n", i,
+                received[i].Events, received[i].Gaps);
+  }
+  if (!valid) {
+    std::printf("events were lost on the way to a subscriber\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include "bench/bench_util.h"
+#include "include/connection.h"
+#include "include/transport.h"
+#include <limits>
+#include <vector>
+
+/**
+ * Measure the decode -> risk -> encode pipeline of a single Connection with
+ * the kernel taken out of the numbers. Pre-encoded NewOrder / DeleteOrder
+ * pairs are fed through a MemoryTransport in chunks of the connection buffer
+ * size, every response is encoded and counted but goes nowhere. Both the
+ * state machine sessions and the coroutine sessions are measured, the latter
+ * see EAGAIN once a round is consumed like on a non-blocking socket.
+ *
+ *   ./bench_engine [frames] [rounds]
+ */
+template <Sendable T>
+static void append_frame(std::string &input, Message<T> msg,
+                         uint16_t version) {
+  char frame[64];
+  size_t size = WIRE_CODECS<T>[version].Encode(msg, frame);
+  input.append(frame, size);
+}
+
+/**
+ * @brief Encode `frames` requests: NewOrder / DeleteOrder pairs spread over
+ * a few listings so the product state stays bounded across rounds.
+ */
+static std::string encode_requests(uint64_t frames, uint16_t version) {
+  std::string input;
+  for (uint64_t id = 1; id <= frames / 2; ++id) {
+    Message<NewOrder> order;
+    std::memset(&order, 0, sizeof(order));
+    bench::prepare_header(order);
+    order.header.version = version;
+    order.header.payloadSize = static_cast<uint16_t>(
+        WIRE_CODECS<NewOrder>[version].FrameSize - sizeof(Header));
+    order.data.listingId = id % 16 + 1;
+    order.data.orderId = id;
+    order.data.orderQuantity = 10;
+    order.data.orderPrice = 1000000;
+    order.data.side = id % 2 == 0 ? 'B' : 'S';
+    append_frame(input, order, version);
+
+    Message<DeleteOrder> cancel;
+    std::memset(&cancel, 0, sizeof(cancel));
+    bench::prepare_header(cancel);
+    cancel.header.version = version;
+    cancel.header.payloadSize = static_cast<uint16_t>(
+        WIRE_CODECS<DeleteOrder>[version].FrameSize - sizeof(Header));
+    cancel.data.orderId = id;
+    append_frame(input, cancel, version);
+  }
+  return input;
+}
+
+static double frames_per_sec(uint16_t version, uint64_t frames,
+                             uint64_t rounds, bool coroutine) {
+  ServerInfo info;
+  info.BuyLimit = std::numeric_limits<uint64_t>::max();
+  info.SellLimit = std::numeric_limits<uint64_t>::max();
+  info.FairBudget = std::numeric_limits<uint32_t>::max();
+  ProductTable products;
+  LimitTree groups; // no groups, every listing stands alone
+  std::vector<uint64_t> dirtyProducts;
+  PositionView positions;  // never mapped, publishing is a no-op
+  ExchangeGateway gateway; // never started, nothing is forwarded
+  OrderJournal journal;    // never opened, nothing is recorded
+  DropCopy copies;         // never started, nothing is copied
+  RiskContext context{info,      products, groups,  dirtyProducts,
+                      positions, gateway,  journal, copies,
+                      std::pmr::get_default_resource()};
+
+  // version 2 is negotiated once, the rounds replay only the requests
+  std::string input;
+  if (version != PROTOCOL_V1) {
+    Message<Hello> hello;
+    std::memset(&hello, 0, sizeof(hello));
+    bench::prepare_header(hello);
+    hello.data.maxVersion = version;
+    append_frame(input, hello, PROTOCOL_V1);
+  }
+  size_t requestsStart = input.size();
+  input += encode_requests(frames, version);
+
+  auto transport = std::make_unique<MemoryTransport>(input, 1024);
+  MemoryTransport &memory = *transport;
+  memory.set_nonblocking(coroutine);
+  Connection conn{std::move(transport), 1, &context, coroutine};
+  AdmissionState admission;
+
+  auto start = bench::Clock::now();
+  for (uint64_t round = 0; round < rounds; ++round) {
+    memory.rewind(round == 0 ? 0 : requestsStart);
+    while (memory.has_input() || conn.has_runnable_request()) {
+      if (!conn.handle_client_request(memory.has_input(), admission)) {
+        std::printf("the connection gave up\n");
+        exit(1);
+      }
+    }
+  }
+  double ns = bench::elapsed_ns(start);
+  if (memory.bytes_out() == 0) {
+    std::printf("no responses\n");
+    exit(1);
+  }
+  if (coroutine && conn.frame_pool().heap_frames() != 0) {
+    std::printf("%lu coroutine frames missed the pool\n",
+                conn.frame_pool().heap_frames());
+    exit(1);
+  }
+  return frames * rounds / (ns / 1e9);
+}
+
+int main(int argc, char **argv) {
+  uint64_t frames = argc > 1 ? std::stoull(argv[1]) : 100000;
+  uint64_t rounds = argc > 2 ? std::stoull(argv[2]) : 20;
+  std::cout.rdbuf(nullptr); // drop the per request logging
+  std::cerr.rdbuf(nullptr);
+  FastClock::calibrate();
+
+  frames_per_sec(PROTOCOL_V1, frames, 1, false); // warm up
+  std::printf("%lu frames x %lu rounds through one connection, no sockets\n",
+              frames, rounds);
+  for (bool coroutine : {false, true}) {
+    char const *mode = coroutine ? "coroutine" : "state    ";
+    double v1 = frames_per_sec(PROTOCOL_V1, frames, rounds, coroutine);
+    double v2 = frames_per_sec(PROTOCOL_V2, frames, rounds, coroutine);
+    std::printf("%s v1 %12.0f frames/s %8.1f ns/frame\n", mode, v1, 1e9 / v1);
+    std::printf("%s v2 %12.0f frames/s %8.1f ns/frame\n", mode, v2, 1e9 / v2);
+  }
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include "bench/bench_util.h"
+#include "include/executor.h"
+#include "include/metrics.h"
+#include <algorithm>
+#include <poll.h>
+#include <sstream>
+#include <vector>
+
+/**
+ * Measure what the slow path executor costs and saves the event loop:
+ *  - closing sockets of disconnected traders inline versus handing them to
+ *    the workers, timed on the posting thread,
+ *  - the round trip of a task that posts a completion, from the post until
+ *    the completion ran on a thread polling the completion fd like the loop,
+ *  - a batch where every fourth task is slow, with the tasks the workers
+ *    stole from each other read back from the metrics.
+ *
+ *   ./bench_executor [threads] [tasks]
+ */
+
+/// Current value of a metric, summed over the threads
+static uint64_t metric_value(std::string const &name) {
+  std::istringstream lines(Metrics::render());
+  std::string line;
+  while (std::getline(lines, line)) {
+    if (line.compare(0, name.size() + 1, name + " ") == 0) {
+      return std::stoull(line.substr(name.size() + 1));
+    }
+  }
+  return 0;
+}
+
+static std::vector<int> open_sockets(uint64_t count) {
+  std::vector<int> fds(count);
+  for (int &fd : fds) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+  }
+  return fds;
+}
+
+/// ns spent on the posting thread per closed socket
+static double close_ns(Executor &executor, uint64_t count) {
+  std::vector<int> fds = open_sockets(count);
+  auto start = bench::Clock::now();
+  for (int fd : fds) {
+    executor.post([fd] { close(fd); });
+  }
+  double elapsed = bench::elapsed_ns(start);
+  while (executor.queued() != 0) {
+    std::this_thread::yield();
+  }
+  return elapsed / count;
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = argc > 1 ? std::stoul(argv[1]) : 2;
+  uint64_t tasks = argc > 2 ? std::stoull(argv[2]) : 20000;
+  FastClock::calibrate();
+
+  Executor direct;
+  Executor executor;
+  if (!direct.start(0) || !executor.start(threads)) {
+    return 1;
+  }
+  double inlineClose = close_ns(direct, tasks);
+  double postedClose = close_ns(executor, tasks);
+
+  // round trips, one at a time so the latency is not queueing
+  std::vector<double> trips;
+  trips.reserve(tasks);
+  pollfd done{.fd = executor.completion_fd(), .events = POLLIN, .revents = 0};
+  for (uint64_t i = 0; i < tasks; ++i) {
+    bool finished = false;
+    auto start = bench::Clock::now();
+    executor.post([&executor, &finished] {
+      executor.complete([&finished] { finished = true; });
+    });
+    while (!finished) {
+      poll(&done, 1, -1);
+      executor.run_completions();
+    }
+    trips.push_back(bench::elapsed_ns(start));
+  }
+  std::sort(trips.begin(), trips.end());
+
+  // skewed batch, the slow tasks pile up on the queues they were posted to
+  uint64_t stolenBefore = metric_value("risk_executor_tasks_stolen_total");
+  auto start = bench::Clock::now();
+  for (uint64_t i = 0; i < tasks; ++i) {
+    uint64_t spinNs = i % 4 == 0 ? 20000 : 500;
+    executor.post([spinNs] {
+      uint64_t until = FastClock::now_ns() + spinNs;
+      while (FastClock::now_ns() < until) {
+      }
+    });
+  }
+  while (executor.queued() != 0) {
+    std::this_thread::yield();
+  }
+  double skewedMs = bench::elapsed_ns(start) / 1e6;
+  uint64_t stolen =
+      metric_value("risk_executor_tasks_stolen_total") - stolenBefore;
+
+  std::printf("%u executor threads, %lu tasks\n", threads, tasks);
+  std::printf("close on the loop   %8.0f ns/socket\n", inlineClose);
+  std::printf("post the close      %8.0f ns/socket\n", postedClose);
+  std::printf("round trip ns       p50 %6.0f  p99 %6.0f  max %8.0f\n",
+              trips[trips.size() / 2], trips[trips.size() * 99 / 100],
+              trips.back());
+  std::printf("skewed batch        %8.1f ms, %lu tasks stolen\n", skewedMs,
+              stolen);
+  return 0;
+}
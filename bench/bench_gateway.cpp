@@ -0,0 +1,128 @@
+#include "bench/bench_util.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/**
+ * Measure the whole order -> risk -> exchange -> fill -> position path. The
+ * server forwards every accepted NewOrder through the exchange gateway to the
+ * in-process mock exchange, which fills it completely. The fill comes back
+ * into the risk loop as a Trade, updates the position and is reported to the
+ * trader.
+ *
+ *   ./bench_gateway [orders] [window] [port]
+ *
+ * The latency pass keeps one order in flight, the throughput pass keeps
+ * `window` orders in flight.
+ */
+static Message<NewOrder> make_order(uint64_t orderId) {
+  Message<NewOrder> msg;
+  std::memset(&msg, 0, sizeof(msg));
+  bench::prepare_header(msg);
+  msg.data.listingId = orderId % 8 + 1;
+  msg.data.orderId = orderId;
+  msg.data.orderQuantity = 10;
+  msg.data.orderPrice = 1000000;
+  msg.data.side = orderId % 2 == 0 ? 'B' : 'S'; // keep the positions flat
+  serialize(msg);
+  return msg;
+}
+
+/**
+ * @brief Read whatever arrived and count the fills among the frames.
+ */
+static uint64_t read_fills(int fd, std::vector<char> &buf, size_t &pos) {
+  ssize_t n = recv(fd, buf.data() + pos, buf.size() - pos, 0);
+  if (n <= 0) {
+    std::perror("bench recv: ");
+    exit(1);
+  }
+  pos += static_cast<size_t>(n);
+
+  uint64_t fills = 0;
+  size_t rd = 0;
+  while (pos - rd >= sizeof(Header) + sizeof(uint16_t)) {
+    uint16_t payload = 0, msgType = 0;
+    std::memcpy(&payload, buf.data() + rd + offsetof(Header, payloadSize),
+                sizeof(payload));
+    size_t frame = sizeof(Header) + ntohs(payload);
+    if (pos - rd < frame) {
+      break;
+    }
+    std::memcpy(&msgType, buf.data() + rd + sizeof(Header), sizeof(msgType));
+    fills += ntohs(msgType) == Trade::MESSAGE_TYPE;
+    rd += frame;
+  }
+  std::memmove(buf.data(), buf.data() + rd, pos - rd);
+  pos -= rd;
+  return fills;
+}
+
+int main(int argc, char **argv) {
+  uint64_t numOrders = argc > 1 ? std::stoull(argv[1]) : 100000;
+  uint64_t window = argc > 2 ? std::stoull(argv[2]) : 64;
+  std::string port = argc > 3 ? argv[3] : "4104";
+
+  ServerConfig config;
+  config.BuyLimit = std::numeric_limits<uint64_t>::max();
+  config.SellLimit = std::numeric_limits<uint64_t>::max();
+  config.SnapshotFile = "/dev/null";
+  config.Exchange = "mock";
+  config.FairBudget = static_cast<uint32_t>(window);
+  bench::start_server(port, config);
+  int fd = bench::connect_loopback(port);
+
+  // Latency: one order in flight, acknowledged by the risk server first and
+  // then filled through the exchange
+  std::vector<double> ackUs, fillUs;
+  ackUs.reserve(numOrders / 10);
+  fillUs.reserve(numOrders / 10);
+  uint64_t orderId = 1;
+  for (uint64_t i = 0; i < numOrders / 10; ++i, ++orderId) {
+    Message<NewOrder> msg = make_order(orderId);
+    auto start = bench::Clock::now();
+    send(fd, &msg, sizeof(msg), 0);
+    if (bench::receive<OrderResponse>(fd).data.status !=
+        OrderResponse::Status::ACCEPTED) {
+      std::printf("order rejected\n");
+      return 1;
+    }
+    ackUs.push_back(bench::elapsed_ns(start) / 1000.0);
+    Message<Trade> fill = bench::receive<Trade>(fd);
+    fillUs.push_back(bench::elapsed_ns(start) / 1000.0);
+    if (fill.data.tradeId != orderId) {
+      std::printf("unexpected fill\n");
+      return 1;
+    }
+  }
+
+  // Throughput: a window of orders in flight
+  std::vector<char> rx(64 * 1024);
+  size_t rxPos = 0;
+  uint64_t sent = 0, filled = 0;
+  auto start = bench::Clock::now();
+  while (filled != numOrders) {
+    while (sent != numOrders && sent - filled < window) {
+      Message<NewOrder> msg = make_order(orderId++);
+      send(fd, &msg, sizeof(msg), 0);
+      ++sent;
+    }
+    filled += read_fills(fd, rx, rxPos);
+  }
+  double totalNs = bench::elapsed_ns(start);
+
+  auto pct = [](std::vector<double> &samples, double p) {
+    std::sort(samples.begin(), samples.end());
+    return samples[static_cast<size_t>(p * (samples.size() - 1))];
+  };
+  std::printf("one order in flight, %zu orders, latency in us\n",
+              ackUs.size());
+  std::printf("%-22s %9s %9s %9s\n", "", "p50", "p99", "p99.9");
+  std::printf("%-22s %9.2f %9.2f %9.2f\n", "order -> risk ack", pct(ackUs, 0.5),
+              pct(ackUs, 0.99), pct(ackUs, 0.999));
+  std::printf("%-22s %9.2f %9.2f %9.2f\n", "order -> fill", pct(fillUs, 0.5),
+              pct(fillUs, 0.99), pct(fillUs, 0.999));
+  std::printf("window %lu, %lu orders filled: %.0f orders/s\n", window,
+              numOrders, numOrders / (totalNs / 1e9));
+  return 0;
+}
@@ -0,0 +1,178 @@
+#include "bench/bench_util.h"
+#include "include/connection.h"
+#include "include/limit_tree.h"
+#include "include/transport.h"
+#include <limits>
+#include <random>
+#include <vector>
+
+/**
+ * Measure what the group limits add to the risk check of an order. Listings
+ * belong to underlyings, underlyings to sectors and sectors to the firm, so
+ * every order is checked and committed along a chain of three groups. The
+ * same NewOrder / DeleteOrder stream runs through one connection without and
+ * with the hierarchy. Afterwards orders are left resting and the incremental
+ * group aggregates are compared with a re-sum over the products, and a tight
+ * firm limit is checked to hold. No sockets are involved.
+ *
+ *   ./bench_group_limits [listings] [frames] [rounds]
+ */
+static constexpr uint64_t UNDERLYING_LISTINGS = 8; // listings per underlying
+static constexpr uint64_t SECTORS = 16;
+
+template <Sendable T>
+static void append_frame(std::string &input, Message<T> msg) {
+  char frame[64];
+  bench::prepare_header(msg);
+  size_t size = WIRE_CODECS<T>[PROTOCOL_V1].Encode(msg, frame);
+  input.append(frame, size);
+}
+
+/**
+ * @brief Encode `orders` NewOrders on random listings, each followed by its
+ * DeleteOrder if `cancel` is set.
+ */
+static std::string encode_orders(uint64_t listings, uint64_t orders,
+                                 bool cancel) {
+  std::mt19937_64 rng(7);
+  std::string input;
+  for (uint64_t id = 1; id <= orders; ++id) {
+    Message<NewOrder> order;
+    std::memset(&order, 0, sizeof(order));
+    order.data.listingId = rng() % listings + 1;
+    order.data.orderId = id;
+    order.data.orderQuantity = rng() % 10 + 1;
+    order.data.orderPrice = 1000000;
+    order.data.side = rng() % 2 == 0 ? 'B' : 'S';
+    append_frame(input, order);
+    if (cancel) {
+      Message<DeleteOrder> del;
+      std::memset(&del, 0, sizeof(del));
+      del.data.orderId = id;
+      append_frame(input, del);
+    }
+  }
+  return input;
+}
+
+/// Listing -> underlying -> sector -> firm, the firm is group 0
+static void build_tree(LimitTree &groups, uint64_t listings,
+                       Notional firmGross) {
+  uint32_t firm = groups.add_group("firm", NO_GROUP, firmGross, NOTIONAL_MAX);
+  std::vector<uint32_t> sectors;
+  for (uint64_t sector = 0; sector < SECTORS; ++sector) {
+    sectors.push_back(groups.add_group("sector" + std::to_string(sector),
+                                       firm, NOTIONAL_MAX, NOTIONAL_MAX));
+  }
+  uint32_t underlying = NO_GROUP;
+  for (uint64_t listing = 1; listing <= listings; ++listing) {
+    uint64_t index = (listing - 1) / UNDERLYING_LISTINGS;
+    if ((listing - 1) % UNDERLYING_LISTINGS == 0) {
+      underlying = groups.add_group("underlying" + std::to_string(index),
+                                    sectors[index % SECTORS], NOTIONAL_MAX,
+                                    NOTIONAL_MAX);
+    }
+    groups.assign_listing(listing, underlying);
+  }
+}
+
+struct Run {
+  double NsPerFrame{0};
+  bool Consistent{true}; // the aggregates match a re-sum of the products
+  Notional FirmGross{0};
+};
+
+static Run run(uint64_t listings, std::string const &input, uint64_t frames,
+               uint64_t rounds, bool withGroups, Notional firmGross) {
+  ServerInfo info;
+  info.BuyLimit = std::numeric_limits<uint64_t>::max();
+  info.SellLimit = std::numeric_limits<uint64_t>::max();
+  info.FairBudget = std::numeric_limits<uint32_t>::max();
+  ProductTable products;
+  LimitTree groups;
+  if (withGroups) {
+    build_tree(groups, listings, firmGross);
+  }
+  std::vector<uint64_t> dirtyProducts;
+  PositionView positions;  // never mapped, publishing is a no-op
+  ExchangeGateway gateway; // never started, nothing is forwarded
+  OrderJournal journal;    // never opened, nothing is recorded
+  DropCopy copies;         // never started, nothing is copied
+  RiskContext context{info,      products, groups,  dirtyProducts,
+                      positions, gateway,  journal, copies,
+                      std::pmr::get_default_resource()};
+
+  auto transport = std::make_unique<MemoryTransport>(input, 1024);
+  MemoryTransport &memory = *transport;
+  Connection conn{std::move(transport), 1, &context};
+  AdmissionState admission;
+
+  auto start = bench::Clock::now();
+  for (uint64_t round = 0; round < rounds; ++round) {
+    memory.rewind(0);
+    while (memory.has_input() || conn.has_pending_request()) {
+      conn.handle_client_request(memory.has_input(), admission);
+    }
+  }
+  Run result;
+  result.NsPerFrame =
+      bench::elapsed_ns(start) / static_cast<double>(rounds * frames);
+
+  // re-sum every group from the products below it
+  std::vector<GroupNode> sums(groups.size());
+  for (auto const &[listingId, prod] : products) {
+    Notional gross = prod.Exposure.gross();
+    for (uint32_t group = prod.Group; group != NO_GROUP;
+         group = groups.node(group).Parent) {
+      sums[group].Gross = notional_add(sums[group].Gross, gross);
+      apply_delta(sums[group].Exposure, prod.Exposure);
+    }
+  }
+  for (uint32_t group = 0; group < groups.size(); ++group) {
+    GroupNode const &node = groups.node(group);
+    result.Consistent &= node.Gross == sums[group].Gross &&
+                         node.Exposure.Buy == sums[group].Exposure.Buy &&
+                         node.Exposure.Sell == sums[group].Exposure.Sell &&
+                         node.Exposure.Pos == sums[group].Exposure.Pos &&
+                         node.Gross <= node.GrossLimit;
+  }
+  if (groups.size() != 0) {
+    result.FirmGross = groups.node(0).Gross;
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  uint64_t listings = argc > 1 ? std::stoull(argv[1]) : 4096;
+  uint64_t frames = argc > 2 ? std::stoull(argv[2]) : 100000;
+  uint64_t rounds = argc > 3 ? std::stoull(argv[3]) : 20;
+  std::cout.rdbuf(nullptr); // drop the per request logging
+  std::cerr.rdbuf(nullptr);
+  FastClock::calibrate();
+
+  std::string pairs = encode_orders(listings, frames / 2, true);
+  uint64_t pairFrames = frames / 2 * 2;
+  run(listings, pairs, pairFrames, 1, false, NOTIONAL_MAX); // warm up
+  Run flat = run(listings, pairs, pairFrames, rounds, false, NOTIONAL_MAX);
+  Run tree = run(listings, pairs, pairFrames, rounds, true, NOTIONAL_MAX);
+
+  // resting orders, once unlimited and once against a firm gross limit
+  std::string resting = encode_orders(listings, frames, false);
+  Notional cap = 1000000 * IMPLICIT_DEC;
+  Run open = run(listings, resting, frames, 1, true, NOTIONAL_MAX);
+  Run capped = run(listings, resting, frames, 1, true, cap);
+  if (!tree.Consistent || !open.Consistent || !capped.Consistent) {
+    std::printf("the group aggregates drifted from the products\n");
+    return 1;
+  }
+  if (open.FirmGross <= cap || capped.FirmGross < cap / 2) {
+    std::printf("the firm limit was not reached or not enforced\n");
+    return 1;
+  }
+
+  std::printf("%lu listings in %lu underlyings and %lu sectors, %lu frames\n",
+              listings, listings / UNDERLYING_LISTINGS, SECTORS, frames);
+  std::printf("listing limits only  %8.1f ns/frame\n", flat.NsPerFrame);
+  std::printf("with 3 group levels  %8.1f ns/frame\n", tree.NsPerFrame);
+  return 0;
+}
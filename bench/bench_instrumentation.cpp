@@ -0,0 +1,92 @@
+#include "bench/bench_util.h"
+#include "include/instrumentation.h"
+#include "include/protocol.h"
+#include <algorithm>
+
+/**
+ * Run the per message path of a session, decode a NewOrder frame and encode
+ * its OrderResponse, with the hooks of every instrumentation policy at recv,
+ * decode, decision and send, and without any hooks. The null policy must
+ * cost exactly what the path without hooks does, the others show what
+ * counting and armed-but-unattached USDT probes add per message. The server
+ * itself is built with one policy, see RISK_INSTRUMENTATION.
+ *
+ *   ./bench_instrumentation [iterations]
+ */
+struct NoHooks {};
+
+template <typename Policy> double pipeline_ns(uint64_t iterations) {
+  constexpr bool HOOKED = !std::is_same_v<Policy, NoHooks>;
+  Message<NewOrder> order;
+  std::memset(&order, 0, sizeof(order));
+  bench::prepare_header(order);
+  order.data.listingId = 7;
+  order.data.orderQuantity = 10;
+  order.data.orderPrice = 1000000;
+  order.data.side = 'B';
+
+  alignas(8) std::array<char, 64> frame{};
+  alignas(8) std::array<char, 64> out{};
+  Message<OrderResponse> rsp;
+  std::memset(&rsp, 0, sizeof(rsp));
+  rsp.data.messageType = OrderResponse::MESSAGE_TYPE;
+  rsp.data.status = OrderResponse::Status::ACCEPTED;
+  size_t size = WIRE_CODECS<NewOrder>[PROTOCOL_V1].Encode(order, frame.data());
+
+  uint64_t check = 0;
+  uint32_t traderId = 1;
+  auto start = bench::Clock::now();
+  for (uint64_t i = 0; i < iterations; ++i) {
+    asm volatile("" : : "r"(frame.data()) : "memory"); // as if received
+    if constexpr (HOOKED) {
+      Policy::on_recv(traderId, size);
+    }
+
+    Message<NewOrder> msg;
+    WIRE_CODECS<NewOrder>[PROTOCOL_V1].Decode(frame.data(), msg);
+    if constexpr (HOOKED) {
+      Policy::on_decode(traderId, NewOrder::MESSAGE_TYPE);
+      Policy::on_decision(traderId, NewOrder::MESSAGE_TYPE,
+                          static_cast<uint16_t>(rsp.data.status));
+    }
+
+    rsp.data.orderId = msg.data.orderId + i;
+    size_t sent =
+        WIRE_CODECS<OrderResponse>[PROTOCOL_V1].Encode(rsp, out.data());
+    asm volatile("" : : "r"(out.data()) : "memory"); // as if sent
+    if constexpr (HOOKED) {
+      Policy::on_send(traderId, sent);
+    }
+    check += sent;
+  }
+  double ns = bench::elapsed_ns(start);
+  if (check == 0) {
+    std::printf("unexpected\n");
+  }
+  return ns / iterations;
+}
+
+int main(int argc, char **argv) {
+  uint64_t iterations = argc > 1 ? std::stoull(argv[1]) : 20000000;
+
+  // warm up every path once, then take the best of a few runs of each
+  double best[4] = {1e9, 1e9, 1e9, 1e9};
+  pipeline_ns<NoHooks>(iterations / 10);
+  pipeline_ns<TraceInstrumentation>(iterations / 10);
+  for (int run = 0; run < 5; ++run) {
+    best[0] = std::min(best[0], pipeline_ns<NoHooks>(iterations));
+    best[1] = std::min(best[1], pipeline_ns<NullInstrumentation>(iterations));
+    best[2] =
+        std::min(best[2], pipeline_ns<CounterInstrumentation>(iterations));
+    best[3] = std::min(best[3], pipeline_ns<TraceInstrumentation>(iterations));
+  }
+
+  std::printf("iterations: %lu, decode NewOrder, encode response, server "
+              "built with %s\n",
+              iterations, Instrumentation::NAME);
+  std::printf("no hooks  %8.2f ns/message\n", best[0]);
+  std::printf("null      %8.2f ns/message\n", best[1]);
+  std::printf("counters  %8.2f ns/message\n", best[2]);
+  std::printf("trace     %8.2f ns/message\n", best[3]);
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include "bench/bench_util.h"
+#include <limits>
+
+/**
+ * Compare cancelling a strategy with one DeleteOrder round trip per order
+ * against a single CancelAll / CancelByListing round trip.
+ *
+ *   ./bench_mass_cancel [orders] [listings] [port]
+ */
+int main(int argc, char **argv) {
+  uint64_t numOrders = argc > 1 ? std::stoull(argv[1]) : 10000;
+  uint64_t numListings = argc > 2 ? std::stoull(argv[2]) : 8;
+  std::string port = argc > 3 ? argv[3] : "4101";
+
+  ServerConfig config;
+  config.BuyLimit = std::numeric_limits<uint64_t>::max();
+  config.SellLimit = std::numeric_limits<uint64_t>::max();
+  bench::start_server(port, config);
+  int fd = bench::connect_loopback(port);
+
+  auto place_all = [&]() {
+    for (uint64_t id = 1; id <= numOrders; ++id) {
+      bench::place_order(fd, id % numListings + 1, id, 1, 10000, 'B');
+    }
+  };
+
+  // One DeleteOrder round trip per order
+  place_all();
+  auto start = bench::Clock::now();
+  for (uint64_t id = 1; id <= numOrders; ++id) {
+    Message<DeleteOrder> msg;
+    std::memset(&msg, 0, sizeof(msg));
+    bench::prepare_header(msg);
+    msg.data.orderId = id;
+    bench::round_trip<OrderResponse>(fd, msg);
+  }
+  double deleteNs = bench::elapsed_ns(start);
+
+  // A single CancelAll round trip
+  place_all();
+  start = bench::Clock::now();
+  Message<CancelAll> all;
+  std::memset(&all, 0, sizeof(all));
+  bench::prepare_header(all);
+  uint64_t allCount =
+      bench::round_trip<MassCancelResponse>(fd, all).data.cancelledCount;
+  double cancelAllNs = bench::elapsed_ns(start);
+
+  // One CancelByListing round trip per listing
+  place_all();
+  uint64_t listingCount = 0;
+  start = bench::Clock::now();
+  for (uint64_t listing = 1; listing <= numListings; ++listing) {
+    Message<CancelByListing> msg;
+    std::memset(&msg, 0, sizeof(msg));
+    bench::prepare_header(msg);
+    msg.data.listingId = listing;
+    listingCount +=
+        bench::round_trip<MassCancelResponse>(fd, msg).data.cancelledCount;
+  }
+  double byListingNs = bench::elapsed_ns(start);
+
+  std::printf("orders: %lu, listings: %lu\n", numOrders, numListings);
+  std::printf("DeleteOrder x%-8lu %12.0f ns total %10.1f ns/order\n",
+              numOrders, deleteNs, deleteNs / numOrders);
+  std::printf("CancelAll x1         %12.0f ns total %10.1f ns/order "
+              "(cancelled %lu)\n",
+              cancelAllNs, cancelAllNs / numOrders, allCount);
+  std::printf("CancelByListing x%-4lu %12.0f ns total %10.1f ns/order "
+              "(cancelled %lu)\n",
+              numListings, byListingNs, byListingNs / numOrders, listingCount);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include "bench/bench_util.h"
+#include "include/precheck.h"
+#include <bit>
+#include <random>
+#include <vector>
+
+/**
+ * Ask which of a batch of candidate orders would pass risk, the way a router
+ * sizes its child orders, against a product table with random resting
+ * quantity and positions. The batched pre-check is compared with checking
+ * the candidates one by one, the lookup and the limit check interleaved as
+ * in the NewOrder handler. Both must agree on every candidate and leave the
+ * product table as it was.
+ *
+ *   ./bench_precheck [listings] [batch] [rounds]
+ */
+static void precheck_scalar(ServerInfo const &info,
+                            ProductTable const &products,
+                            NotionalExposure const &trader,
+                            std::vector<WhatIfOrder> const &orders,
+                            std::vector<uint64_t> &passed) {
+  std::fill(passed.begin(), passed.end(), 0);
+  for (size_t i = 0; i < orders.size(); ++i) {
+    WhatIfOrder const &ord = orders[i];
+    auto it = products.find(ord.ListingId);
+    ProductInfo prod = it == products.end() ? ProductInfo{} : it->second;
+    NotionalExposure exposure = trader;
+    RiskDelta delta =
+        RiskDelta::resting(ord.Side, ord.Quantity, ord.OrderPrice, 1);
+    prod.apply(delta);
+    apply_delta(exposure, delta.Exposure);
+    if (!info.exceeds_limits(prod, exposure)) {
+      passed[i / 64] |= 1ull << (i % 64);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  uint64_t listings = argc > 1 ? std::stoull(argv[1]) : 100000;
+  uint64_t batch = argc > 2 ? std::stoull(argv[2]) : 256;
+  uint64_t rounds = argc > 3 ? std::stoull(argv[3]) : 2000;
+
+  ServerInfo info;
+  info.BuyLimit = 800;
+  info.SellLimit = 800;
+  info.ProductGrossLimit = 500000 * IMPLICIT_DEC;
+  info.TraderGrossLimit = 2000000 * IMPLICIT_DEC;
+
+  std::mt19937_64 rng(42);
+  ProductTable products{std::pmr::get_default_resource()};
+  products.reserve(listings);
+  for (uint64_t id = 1; id <= listings; ++id) {
+    ProductInfo prod;
+    prod.NetPos = static_cast<int64_t>(rng() % 400) - 200;
+    prod.apply(RiskDelta::resting('B', rng() % 800, 1000000, 1));
+    prod.apply(RiskDelta::resting('S', rng() % 800, 1000000, 1));
+    products.emplace(id, prod);
+  }
+  LimitTree groups; // listing limits only, like the one by one check
+  NotionalExposure trader;
+  trader.Buy = 1500000 * IMPLICIT_DEC;
+
+  // a share of the candidates is on listings that have no state yet
+  std::vector<std::vector<WhatIfOrder>> batches(64);
+  for (std::vector<WhatIfOrder> &orders : batches) {
+    orders.resize(batch);
+    for (WhatIfOrder &ord : orders) {
+      ord = WhatIfOrder{.ListingId = rng() % (listings + listings / 8) + 1,
+                        .Quantity = rng() % 400 + 1,
+                        .OrderPrice = 1000000 + rng() % 10000,
+                        .Side = rng() % 2 == 0 ? 'B' : 'S'};
+    }
+  }
+
+  std::vector<uint64_t> expected(precheck_words(batch));
+  std::vector<uint64_t> passed(precheck_words(batch));
+  uint64_t accepted = 0;
+  for (std::vector<WhatIfOrder> const &orders : batches) {
+    precheck_scalar(info, products, trader, orders, expected);
+    precheck_orders(info, products, groups, trader, orders, passed);
+    if (passed != expected) {
+      std::printf("batched and scalar pre-checks disagree\n");
+      return 1;
+    }
+    for (uint64_t word : passed) {
+      accepted += std::popcount(word);
+    }
+  }
+
+  auto start = bench::Clock::now();
+  for (uint64_t round = 0; round < rounds; ++round) {
+    precheck_scalar(info, products, trader, batches[round % batches.size()],
+                    expected);
+  }
+  double scalarNs = bench::elapsed_ns(start);
+  start = bench::Clock::now();
+  for (uint64_t round = 0; round < rounds; ++round) {
+    precheck_orders(info, products, groups, trader,
+                    batches[round % batches.size()], passed);
+  }
+  double batchNs = bench::elapsed_ns(start);
+
+  if (products.size() != listings) {
+    std::printf("the pre-check added %zu products\n",
+                products.size() - listings);
+    return 1;
+  }
+  double orders = static_cast<double>(rounds * batch);
+  std::printf("%lu candidates per batch over %lu listings, %.1f%% pass\n",
+              batch, listings, 100.0 * accepted / (batches.size() * batch));
+  std::printf("one by one  %8.1f ns/order\n", scalarNs / orders);
+  std::printf("batched     %8.1f ns/order\n", batchNs / orders);
+  return 0;
+}
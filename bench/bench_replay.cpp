@@ -0,0 +1,138 @@
+#include "bench/bench_util.h"
+#include "include/order_journal.h"
+#include "include/protocol.h"
+#include "include/replay.h"
+#include <random>
+#include <vector>
+
+/**
+ * Write a synthetic order log through the OrderJournal and replay it under
+ * several sets of limits with an increasing number of worker threads. The
+ * listings get a skewed share of the requests so a few partitions dominate,
+ * which is what the work stealing has to even out.
+ *
+ *   ./bench_replay [requests] [listings] [traders] [max threads]
+ */
+template <Sendable T>
+static void journal_request(OrderJournal &journal, uint32_t traderId,
+                            Message<T> msg) {
+  char frame[64];
+  bench::prepare_header(msg);
+  size_t size = WIRE_CODECS<T>[PROTOCOL_V1].Encode(msg, frame);
+  journal.append(0, traderId, PROTOCOL_V1, frame, size);
+}
+
+/**
+ * @brief Mix of NewOrder, ModifyOrderQuantity, Trade and DeleteOrder requests
+ * of `traders` traders, ending every session.
+ */
+static void write_log(std::string const &path, uint64_t requests,
+                      uint64_t listings, uint32_t traders) {
+  OrderJournal journal;
+  if (!journal.open(path)) {
+    exit(1);
+  }
+
+  std::mt19937_64 rng(42);
+  std::vector<std::vector<std::pair<uint64_t, uint64_t>>> live(traders + 1);
+  uint64_t nextOrderId = 1;
+  for (uint64_t i = 0; i < requests; ++i) {
+    uint32_t traderId = static_cast<uint32_t>(rng() % traders + 1);
+    std::vector<std::pair<uint64_t, uint64_t>> &orders = live[traderId];
+    uint64_t dice = rng() % 10;
+    if (orders.empty() || dice < 5) {
+      // the square skews the listings towards the low ids
+      uint64_t r = rng() % listings;
+      Message<NewOrder> msg;
+      msg.data.listingId = r * r / listings + 1;
+      msg.data.orderId = nextOrderId++;
+      msg.data.orderQuantity = rng() % 100 + 1;
+      msg.data.orderPrice = 10000;
+      msg.data.side = rng() % 2 == 0 ? 'B' : 'S';
+      orders.emplace_back(uint64_t{msg.data.orderId},
+                          uint64_t{msg.data.listingId});
+      journal_request(journal, traderId, msg);
+    } else if (dice < 7) {
+      Message<ModifyOrderQuantity> msg;
+      msg.data.orderId = orders[rng() % orders.size()].first;
+      msg.data.newQuantity = rng() % 150 + 1;
+      journal_request(journal, traderId, msg);
+    } else if (dice < 8) {
+      auto [orderId, listingId] = orders[rng() % orders.size()];
+      Message<Trade> msg;
+      msg.data.listingId = listingId;
+      msg.data.tradeId = orderId;
+      msg.data.tradeQuantity = 1;
+      msg.data.tradePrice = 10000;
+      journal_request(journal, traderId, msg);
+    } else {
+      size_t pos = rng() % orders.size();
+      Message<DeleteOrder> msg;
+      msg.data.orderId = orders[pos].first;
+      orders[pos] = orders.back();
+      orders.pop_back();
+      journal_request(journal, traderId, msg);
+    }
+    if (i % 4096 == 0) {
+      journal.flush();
+    }
+  }
+  for (uint32_t traderId = 1; traderId <= traders; ++traderId) {
+    journal.append(0, traderId, ORDER_LOG_SESSION_END, nullptr, 0);
+  }
+  journal.flush();
+}
+
+int main(int argc, char **argv) {
+  uint64_t requests = argc > 1 ? std::stoull(argv[1]) : 2000000;
+  uint64_t listings = argc > 2 ? std::stoull(argv[2]) : 256;
+  uint32_t traders = argc > 3 ? std::stoul(argv[3]) : 64;
+  unsigned maxThreads =
+      argc > 4 ? std::stoul(argv[4])
+               : std::max(4u, std::thread::hardware_concurrency());
+
+  std::string path = "/tmp/bench_replay.log";
+  write_log(path, requests, listings, traders);
+  ReplayLog log;
+  if (!load_order_log(path, log)) {
+    return 1;
+  }
+  unlink(path.c_str());
+
+  std::vector<ReplayLimits> limits;
+  for (uint64_t limit : {500, 1000, 2000, 4000, 8000, 16000}) {
+    limits.push_back(ReplayLimits{.BuyLimit = limit, .SellLimit = limit});
+  }
+
+  std::printf("%lu records over %zu listings, %zu sets of limits\n",
+              log.Records, log.Listings.size(), limits.size());
+  std::vector<ReplayResult> reference;
+  for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+    auto start = bench::Clock::now();
+    std::vector<ReplayResult> results = replay_order_log(log, limits, threads);
+    double ns = bench::elapsed_ns(start);
+
+    if (reference.empty()) {
+      reference = results;
+    }
+    for (size_t cfg = 0; cfg < results.size(); ++cfg) {
+      if (results[cfg].Total.NewRejected != reference[cfg].Total.NewRejected ||
+          results[cfg].Total.ModifyRejected !=
+              reference[cfg].Total.ModifyRejected) {
+        std::printf("results differ with %u threads\n", threads);
+        return 1;
+      }
+    }
+    std::printf("%2u threads %8.1f ms %10.0f records/s\n", threads, ns / 1e6,
+                log.Records / (ns / 1e9));
+  }
+
+  for (ReplayResult const &result : reference) {
+    std::printf("limits %6lu:%-6lu rejected %8lu of %8lu new orders, %8lu "
+                "of %8lu modifies\n",
+                result.Limits.BuyLimit, result.Limits.SellLimit,
+                result.Total.NewRejected, result.Total.NewOrders,
+                result.Total.ModifyRejected, result.Total.Modifies);
+  }
+  return 0;
+}
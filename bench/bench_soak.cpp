@@ -0,0 +1,164 @@
+#include "bench/bench_util.h"
+#include <algorithm>
+#include <csignal>
+#include <fstream>
+#include <limits>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <vector>
+
+/**
+ * Ramp one server process up to many loopback trader sessions, most of them
+ * idle, and keep a small hot subset placing and deleting orders. Reports the
+ * resident memory the server spends per idle session, how fast the sessions
+ * were accepted, and the round trip latency of the hot subset while the idle
+ * sessions send a request now and then. The server runs in a child process so
+ * its memory and its fd limit are its own.
+ *
+ * Every session costs an fd on both sides, raise the limit for the larger
+ * runs, e.g. ulimit -n 60000 for 50k sessions.
+ *
+ *   ./bench_soak [sessions] [hot sessions] [rounds] [port]
+ */
+
+/// Resident memory of a process in bytes
+static uint64_t resident_bytes(pid_t pid) {
+  std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0) {
+      return std::stoull(line.substr(6)) * 1024;
+    }
+  }
+  return 0;
+}
+
+/// A request the server rejects without touching any state
+static OrderResponse::Status idle_request(int fd) {
+  Message<DeleteOrder> msg;
+  std::memset(&msg, 0, sizeof(msg));
+  bench::prepare_header(msg);
+  msg.data.orderId = std::numeric_limits<uint64_t>::max();
+  return bench::round_trip<OrderResponse>(fd, msg).data.status;
+}
+
+static void wait_for_server(std::string const &port) {
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(std::stoi(port)));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bool up = connect(fd, reinterpret_cast<sockaddr *>(&addr),
+                      sizeof(addr)) == 0;
+    close(fd);
+    if (up) {
+      return;
+    }
+  }
+  std::printf("the server did not come up\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  uint64_t sessions = argc > 1 ? std::stoull(argv[1]) : 10000;
+  uint64_t hot = argc > 2 ? std::stoull(argv[2]) : 64;
+  uint64_t rounds = argc > 3 ? std::stoull(argv[3]) : 200;
+  std::string port = argc > 4 ? argv[4] : "4111";
+
+  rlimit files;
+  getrlimit(RLIMIT_NOFILE, &files);
+  files.rlim_cur = files.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &files);
+  if (sessions + 64 > files.rlim_cur) {
+    sessions = files.rlim_cur - 64;
+    std::printf("fd limit %lu, ramping to %lu sessions\n", files.rlim_cur,
+                sessions);
+  }
+  hot = std::min(hot, sessions);
+
+  pid_t server = fork();
+  if (server == 0) {
+    ServerConfig config;
+    config.BuyLimit = std::numeric_limits<uint64_t>::max();
+    config.SellLimit = std::numeric_limits<uint64_t>::max();
+    config.SnapshotFile = "/dev/null";
+    std::cerr.rdbuf(nullptr);
+    bench::start_server(port, config);
+    pause(); // until the benchmark is done
+    return 0;
+  }
+  wait_for_server(port);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  uint64_t baseline = resident_bytes(server);
+
+  // ramp up, the last session answering means every session was accepted
+  std::vector<int> fds;
+  fds.reserve(sessions);
+  auto start = bench::Clock::now();
+  for (uint64_t i = 0; i < sessions; ++i) {
+    fds.push_back(bench::connect_loopback(port));
+  }
+  if (idle_request(fds.back()) != OrderResponse::Status::REJECTED) {
+    return 1;
+  }
+  double rampNs = bench::elapsed_ns(start);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  uint64_t ramped = resident_bytes(server);
+
+  // every idle session has been served once, so it holds what it keeps
+  // between requests
+  for (uint64_t i = hot; i < sessions; ++i) {
+    idle_request(fds[i]);
+  }
+  uint64_t served = resident_bytes(server);
+
+  // the hot subset trades, a few idle sessions chime in every round
+  std::vector<double> trips;
+  trips.reserve(rounds * hot * 2);
+  uint64_t nextIdle = hot;
+  uint64_t orderId = 0;
+  for (uint64_t round = 0; round < rounds; ++round) {
+    for (uint64_t i = 0; i < hot; ++i) {
+      ++orderId;
+      auto tripStart = bench::Clock::now();
+      bench::place_order(fds[i], orderId % 8 + 1, orderId, 1, 10000, 'B');
+      trips.push_back(bench::elapsed_ns(tripStart));
+
+      Message<DeleteOrder> msg;
+      std::memset(&msg, 0, sizeof(msg));
+      bench::prepare_header(msg);
+      msg.data.orderId = orderId;
+      tripStart = bench::Clock::now();
+      bench::round_trip<OrderResponse>(fds[i], msg);
+      trips.push_back(bench::elapsed_ns(tripStart));
+    }
+    for (int i = 0; i < 8 && sessions > hot; ++i) {
+      idle_request(fds[nextIdle]);
+      nextIdle = nextIdle + 1 == sessions ? hot : nextIdle + 1;
+    }
+  }
+  std::sort(trips.begin(), trips.end());
+
+  for (int fd : fds) {
+    close(fd);
+  }
+  kill(server, SIGKILL);
+  waitpid(server, nullptr, 0);
+
+  auto per_session = [sessions, baseline](uint64_t rss) {
+    return rss > baseline ? static_cast<double>(rss - baseline) / sessions
+                          : 0.0;
+  };
+  std::printf("%lu sessions, %lu hot, %lu rounds\n", sessions, hot, rounds);
+  std::printf("accept rate      %10.0f sessions/s\n",
+              sessions / (rampNs / 1e9));
+  std::printf("rss per session  %10.0f bytes connected, %.0f bytes served\n",
+              per_session(ramped), per_session(served));
+  std::printf("hot round trip   p50 %8.0f  p99 %8.0f  p99.9 %8.0f ns\n",
+              trips[trips.size() / 2], trips[trips.size() * 99 / 100],
+              trips[trips.size() * 999 / 1000]);
+  return 0;
+}
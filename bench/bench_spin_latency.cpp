@@ -0,0 +1,73 @@
+#include "bench/bench_util.h"
+#include "include/tuning.h"
+#include <algorithm>
+#include <limits>
+#include <sys/wait.h>
+#include <vector>
+
+/**
+ * Compare the NewOrder round trip latency of the blocking event loop against
+ * the spinning one. Each mode runs its own server in a child process, so a
+ * spinning server does not linger while the other mode is measured. The
+ * client and the event loop can be pinned to separate cores, without that
+ * they share whatever core the scheduler picks.
+ *
+ *   ./bench_spin_latency [round trips] [server cpu] [client cpu] [port]
+ */
+static void measure(bool spin, uint64_t roundTrips, int serverCpu,
+                    int clientCpu, std::string const &port) {
+  ServerConfig config;
+  config.BuyLimit = std::numeric_limits<uint64_t>::max();
+  config.SellLimit = std::numeric_limits<uint64_t>::max();
+  config.SpinPoll = spin;
+  config.PinCpu = serverCpu;
+  config.LockMemory = spin;
+  config.SnapshotFile = "/dev/null"; // keep the table readable
+  bench::start_server(port, config);
+  if (clientCpu >= 0) {
+    pin_thread(clientCpu);
+  }
+  int fd = bench::connect_loopback(port);
+
+  std::vector<double> samples(roundTrips);
+  for (uint64_t id = 0; id < roundTrips / 10; ++id) { // warm up
+    bench::place_order(fd, 1, id, 1, 10000, 'B');
+  }
+  for (uint64_t id = 0; id < roundTrips; ++id) {
+    auto start = bench::Clock::now();
+    bench::place_order(fd, 2, id, 1, 10000, 'B');
+    samples[id] = bench::elapsed_ns(start);
+  }
+  std::sort(samples.begin(), samples.end());
+
+  auto pct = [&](double p) {
+    return samples[static_cast<size_t>(p * (samples.size() - 1))] / 1000.0;
+  };
+  std::printf("%-6s %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+              spin ? "spin" : "block", pct(0.5), pct(0.99), pct(0.999),
+              pct(0.9999), samples.back() / 1000.0);
+}
+
+int main(int argc, char **argv) {
+  uint64_t roundTrips = argc > 1 ? std::stoull(argv[1]) : 100000;
+  int serverCpu = argc > 2 ? std::stoi(argv[2]) : -1;
+  int clientCpu = argc > 3 ? std::stoi(argv[3]) : -1;
+  std::string port = argc > 4 ? argv[4] : "4102";
+
+  std::printf("round trips: %lu, NewOrder -> OrderResponse latency in us\n",
+              roundTrips);
+  std::printf("%-6s %9s %9s %9s %9s %9s\n", "mode", "p50", "p99", "p99.9",
+              "p99.99", "max");
+  std::fflush(stdout);
+  for (bool spin : {false, true}) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      measure(spin, roundTrips, serverCpu, clientCpu,
+              std::to_string(std::stoi(port) + spin));
+      std::fflush(stdout);
+      _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include "bench/bench_util.h"
+#include "include/timer_wheel.h"
+#include <random>
+#include <vector>
+
+/**
+ * Arm a large number of session timers with deadlines spread over a minute,
+ * cancel a share of them and re-arm the rest the way heartbeats are pushed
+ * back, then advance the wheel through the minute in 1 ms steps. Every timer
+ * is checked to fire within one tick after its deadline.
+ *
+ *   ./bench_timer_wheel [timers] [cancel pct]
+ */
+int main(int argc, char **argv) {
+  uint64_t timers = argc > 1 ? std::stoull(argv[1]) : 100000;
+  uint64_t cancelPct = argc > 2 ? std::stoull(argv[2]) : 50;
+  constexpr uint64_t TICK_NS = 1000000;
+  constexpr uint64_t SPAN_NS = 60 * NS_PER_SEC;
+
+  std::mt19937_64 rng(42);
+  std::vector<uint64_t> deadlines(timers);
+  for (uint64_t &deadline : deadlines) {
+    deadline = rng() % SPAN_NS + 1;
+  }
+
+  TimerWheel<uint64_t> wheel{TICK_NS, 0};
+  wheel.reserve(timers);
+  std::vector<TimerId> ids(timers);
+  auto start = bench::Clock::now();
+  for (uint64_t i = 0; i < timers; ++i) {
+    ids[i] = wheel.schedule(deadlines[i], i);
+  }
+  double scheduleNs = bench::elapsed_ns(start);
+
+  // cancel a share, move the rest later by a random amount
+  std::vector<bool> cancelled(timers, false);
+  start = bench::Clock::now();
+  for (uint64_t i = 0; i < timers; ++i) {
+    if (rng() % 100 < cancelPct) {
+      cancelled[i] = wheel.cancel(ids[i]);
+    } else {
+      wheel.cancel(ids[i]);
+      deadlines[i] = std::min(deadlines[i] + rng() % NS_PER_SEC, SPAN_NS);
+      ids[i] = wheel.schedule(deadlines[i], i);
+    }
+  }
+  double rearmNs = bench::elapsed_ns(start);
+  size_t armed = wheel.size();
+
+  uint64_t fired = 0;
+  uint64_t late = 0;
+  uint64_t steps = 0;
+  start = bench::Clock::now();
+  for (uint64_t now = 0; now <= SPAN_NS; now += TICK_NS, ++steps) {
+    fired += wheel.advance(now, [&](uint64_t i) {
+      late += cancelled[i] || deadlines[i] > now ||
+              now - deadlines[i] >= TICK_NS;
+    });
+  }
+  double advanceNs = bench::elapsed_ns(start);
+
+  if (fired != armed || late != 0 || wheel.size() != 0) {
+    std::printf("%lu of %zu timers fired, %lu at the wrong time\n", fired,
+                armed, late);
+    return 1;
+  }
+  std::printf("%lu timers over %lu s, %lu%% cancelled\n", timers,
+              SPAN_NS / NS_PER_SEC, cancelPct);
+  std::printf("schedule      %8.1f ns/timer\n", scheduleNs / timers);
+  std::printf("cancel/rearm  %8.1f ns/timer\n", rearmNs / timers);
+  std::printf("advance       %8.1f ns/tick over %lu ticks, %lu fired\n",
+              advanceNs / steps, steps, fired);
+  return 0;
+}
@@ -0,0 +1,135 @@
+#ifndef BENCH_UTIL_INCLUDED_H
+#define BENCH_UTIL_INCLUDED_H
+
+#include "include/clock.h"
+#include "include/orders.h"
+#include "include/server.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Start a risk server on the loopback interface in a detached thread.
+ * The per-request logging of the server is discarded so it does not dominate
+ * the measurement. The server lives until the process exits.
+ * @param port - the port the server should listen on
+ * @param config - the limits the server should enforce
+ */
+inline void start_server(std::string const &port, ServerConfig config) {
+  std::cout.rdbuf(nullptr); // drop server logging
+  FastClock::calibrate();
+  auto *srv = new Server{"127.0.0.1", port, config};
+  srv->listen();
+  std::thread([srv]() { srv->run(); }).detach();
+}
+
+/**
+ * @brief Connect a blocking TCP socket to the loopback server.
+ * @param port - the port the server is listening on
+ * @return the connected socket, the process exits on failure
+ */
+inline int connect_loopback(std::string const &port) {
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(std::stoi(port)));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int yes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int));
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1) {
+    std::perror("bench connect: ");
+    exit(1);
+  }
+  return fd;
+}
+
+/**
+ * @brief Fill in the header of an outgoing request.
+ */
+template <Sendable T> void prepare_header(Message<T> &msg) {
+  static uint32_t seq = 0;
+  msg.header.version = 1;
+  msg.header.payloadSize = sizeof(T);
+  msg.header.sequenceNumber = ++seq;
+  msg.header.timestamp = 0;
+  msg.data.messageType = T::MESSAGE_TYPE;
+}
+
+/**
+ * @brief Block until a whole version 1 message of type R arrived.
+ * @param fd - the connected socket
+ * @return the message in host byte order
+ */
+template <Sendable R> Message<R> receive(int fd) {
+  Message<R> rsp;
+  size_t got = 0;
+  while (got != sizeof(rsp)) {
+    ssize_t n = recv(fd, reinterpret_cast<char *>(&rsp) + got,
+                     sizeof(rsp) - got, 0);
+    if (n <= 0) {
+      std::perror("bench recv: ");
+      exit(1);
+    }
+    got += n;
+  }
+  deserialize(rsp);
+  return rsp;
+}
+
+/**
+ * @brief Send a request and block until the response of type R arrived.
+ * @param fd - the connected socket
+ * @param msg - the request in host byte order
+ * @return the response in host byte order
+ */
+template <Sendable R, Sendable T> Message<R> round_trip(int fd, Message<T> msg) {
+  serialize(msg);
+  if (send(fd, &msg, sizeof(msg), 0) != sizeof(msg)) {
+    std::perror("bench send: ");
+    exit(1);
+  }
+  return receive<R>(fd);
+}
+
+/**
+ * @brief Place a new order and return the status reported by the server.
+ */
+inline OrderResponse::Status place_order(int fd, uint64_t listingId,
+                                         uint64_t orderId, uint64_t quantity,
+                                         uint64_t price, char side) {
+  Message<NewOrder> msg;
+  std::memset(&msg, 0, sizeof(msg));
+  prepare_header(msg);
+  msg.data.listingId = listingId;
+  msg.data.orderId = orderId;
+  msg.data.orderQuantity = quantity;
+  msg.data.orderPrice = price;
+  msg.data.side = side;
+  return round_trip<OrderResponse>(fd, msg).data.status;
+}
+
+/**
+ * @brief Nanoseconds elapsed since the given time point.
+ */
+inline double elapsed_ns(Clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+      .count();
+}
+
+} // namespace bench
+
+#endif
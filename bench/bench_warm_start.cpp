@@ -0,0 +1,136 @@
+#include "bench/bench_util.h"
+#include "include/connection.h"
+#include "include/hot_memory.h"
+#include "include/transport.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/**
+ * Replay the opening of a trading day: a few traders place orders that all
+ * keep resting, spread over many listings, so the product map and the order
+ * tables grow from empty. Every serve call of a session is timed. Without
+ * reserved capacity the tables rehash and the heap takes first-touch page
+ * faults while they grow, with reserved and pre-faulted hot memory they do
+ * not. No sockets are involved.
+ *
+ *   ./bench_warm_start [traders] [orders per trader] [listings] [thp|explicit]
+ */
+struct Percentiles {
+  double P50;
+  double P99;
+  double P999;
+  double Max;
+};
+
+static Percentiles percentiles(std::vector<double> &samples) {
+  std::sort(samples.begin(), samples.end());
+  auto at = [&samples](double q) {
+    return samples[static_cast<size_t>(q * (samples.size() - 1))];
+  };
+  return Percentiles{at(0.5), at(0.99), at(0.999), samples.back()};
+}
+
+static std::string encode_orders(uint32_t trader, uint64_t orders,
+                                 uint64_t listings) {
+  std::string input;
+  char frame[64];
+  for (uint64_t i = 0; i < orders; ++i) {
+    Message<NewOrder> order;
+    std::memset(&order, 0, sizeof(order));
+    bench::prepare_header(order);
+    order.data.listingId = (i * 7919 + trader) % listings + 1;
+    order.data.orderId = i + 1;
+    order.data.orderQuantity = 1;
+    order.data.orderPrice = 10000;
+    order.data.side = i % 2 == 0 ? 'B' : 'S';
+    size_t size = WIRE_CODECS<NewOrder>[PROTOCOL_V1].Encode(order, frame);
+    input.append(frame, size);
+  }
+  return input;
+}
+
+static Percentiles serve_times(uint32_t traders, uint64_t orders,
+                               uint64_t listings, bool reserve,
+                               HugePageMode pages) {
+  ServerInfo info;
+  info.BuyLimit = std::numeric_limits<uint64_t>::max();
+  info.SellLimit = std::numeric_limits<uint64_t>::max();
+  if (reserve) {
+    info.ExpectedListings = static_cast<uint32_t>(listings);
+    info.ExpectedTraders = traders;
+    info.OrdersPerTrader = static_cast<uint32_t>(orders);
+  }
+  HotMemory memory{reserve ? hot_memory_bytes(listings, traders, orders) : 0,
+                   pages};
+  ProductTable products{memory.resource()};
+  LimitTree groups; // no groups, every listing stands alone
+  std::vector<uint64_t> dirtyProducts;
+  products.reserve(info.ExpectedListings);
+  dirtyProducts.reserve(info.ExpectedListings);
+  PositionView positions;  // never mapped, publishing is a no-op
+  ExchangeGateway gateway; // never started, nothing is forwarded
+  OrderJournal journal;    // never opened, nothing is recorded
+  DropCopy copies;         // never started, nothing is copied
+  RiskContext context{info,      products, groups,  dirtyProducts,
+                      positions, gateway,  journal, copies,
+                      memory.resource()};
+
+  std::vector<std::string> inputs;
+  std::vector<MemoryTransport *> transports;
+  std::vector<std::unique_ptr<Connection>> conns;
+  for (uint32_t trader = 0; trader < traders; ++trader) {
+    inputs.push_back(encode_orders(trader, orders, listings));
+  }
+  for (uint32_t trader = 0; trader < traders; ++trader) {
+    auto transport = std::make_unique<MemoryTransport>(inputs[trader], 1024);
+    transports.push_back(transport.get());
+    conns.push_back(
+        std::make_unique<Connection>(std::move(transport), trader, &context));
+  }
+
+  AdmissionState admission;
+  std::vector<double> samples;
+  samples.reserve(traders * orders / 8);
+  bool active = true;
+  while (active) { // one event per session and sweep, like the server
+    active = false;
+    for (uint32_t trader = 0; trader < traders; ++trader) {
+      MemoryTransport &memory = *transports[trader];
+      Connection &conn = *conns[trader];
+      if (!memory.has_input() && !conn.has_pending_request()) {
+        continue;
+      }
+      active = true;
+      auto start = bench::Clock::now();
+      conn.handle_client_request(memory.has_input(), admission);
+      samples.push_back(bench::elapsed_ns(start));
+    }
+  }
+  return percentiles(samples);
+}
+
+int main(int argc, char **argv) {
+  uint32_t traders = argc > 1 ? std::stoul(argv[1]) : 16;
+  uint64_t orders = argc > 2 ? std::stoull(argv[2]) : 20000;
+  uint64_t listings = argc > 3 ? std::stoull(argv[3]) : 4096;
+  std::string mode = argc > 4 ? argv[4] : "off";
+  HugePageMode pages = mode == "thp"        ? HugePageMode::Transparent
+                       : mode == "explicit" ? HugePageMode::Explicit
+                                            : HugePageMode::Off;
+  std::cout.rdbuf(nullptr); // drop the per request logging
+  std::cerr.rdbuf(nullptr);
+  FastClock::calibrate();
+
+  // the reserved run goes first so it cannot reuse pages of the cold one
+  Percentiles warm = serve_times(traders, orders, listings, true, pages);
+  Percentiles cold = serve_times(traders, orders, listings, false, pages);
+  std::printf("%u traders x %lu resting orders over %lu listings\n", traders,
+              orders, listings);
+  std::printf("serve call ns    p50      p99    p99.9        max\n");
+  std::printf("cold       %8.0f %8.0f %8.0f %10.0f\n", cold.P50, cold.P99,
+              cold.P999, cold.Max);
+  std::printf("reserved   %8.0f %8.0f %8.0f %10.0f\n", warm.P50, warm.P99,
+              warm.P999, warm.Max);
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include "bench/bench_util.h"
+#include "include/protocol.h"
+
+/**
+ * Compare the cost of decoding a NewOrder frame and encoding its
+ * OrderResponse in protocol version 1 (big endian, packed) against
+ * version 2 (little endian, aligned). Frames are dispatched through the
+ * WIRE_CODECS table exactly like the server does.
+ *
+ *   ./bench_wire_codec [iterations]
+ */
+template <uint16_t Version> double codec_ns(uint64_t iterations) {
+  Message<NewOrder> order;
+  std::memset(&order, 0, sizeof(order));
+  bench::prepare_header(order);
+  order.header.version = Version;
+  order.data.listingId = 7;
+  order.data.orderQuantity = 10;
+  order.data.orderPrice = 1000000;
+  order.data.side = 'B';
+
+  alignas(8) std::array<char, 64> frame{};
+  alignas(8) std::array<char, 64> out{};
+  Message<OrderResponse> rsp;
+  std::memset(&rsp, 0, sizeof(rsp));
+  rsp.data.messageType = OrderResponse::MESSAGE_TYPE;
+
+  uint64_t check = 0;
+  auto start = bench::Clock::now();
+  for (uint64_t i = 0; i < iterations; ++i) {
+    order.data.orderId = i;
+    WIRE_CODECS<NewOrder>[Version].Encode(order, frame.data());
+    asm volatile("" : : "r"(frame.data()) : "memory"); // as if received
+
+    Message<NewOrder> msg;
+    WIRE_CODECS<NewOrder>[Version].Decode(frame.data(), msg);
+    rsp.data.orderId = msg.data.orderId;
+    check += WIRE_CODECS<OrderResponse>[Version].Encode(rsp, out.data());
+    asm volatile("" : : "r"(out.data()) : "memory"); // as if sent
+  }
+  double ns = bench::elapsed_ns(start);
+  if (check == 0) {
+    std::printf("unexpected\n");
+  }
+  return ns / iterations;
+}
+
+int main(int argc, char **argv) {
+  uint64_t iterations = argc > 1 ? std::stoull(argv[1]) : 20000000;
+
+  // warm up both paths once before measuring
+  codec_ns<PROTOCOL_V1>(iterations / 10);
+  codec_ns<PROTOCOL_V2>(iterations / 10);
+  double v1 = codec_ns<PROTOCOL_V1>(iterations);
+  double v2 = codec_ns<PROTOCOL_V2>(iterations);
+
+  std::printf("iterations: %lu, encode + decode NewOrder, encode response\n",
+              iterations);
+  std::printf("v1 big endian, packed     %8.2f ns/message\n", v1);
+  std::printf("v2 little endian, aligned %8.2f ns/message\n", v2);
+  return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef ADMISSION_INCLUDED_H
+#define ADMISSION_INCLUDED_H
+
+#include <algorithm>
+#include <cstdint>
+
+static constexpr uint64_t NS_PER_SEC = 1000000000;
+
+/**
+ * @brief Per session token bucket. Tokens are kept scaled by NS_PER_SEC so
+ * the refill is a single integer multiply of the elapsed nanoseconds by the
+ * configured rate. A rate of 0 disables the bucket.
+ */
+struct TokenBucket {
+  uint64_t Tokens{0}; // scaled by NS_PER_SEC
+  uint64_t LastNs{0};
+
+  /**
+   * @brief Refill the bucket up to now and take one token if available.
+   * @param nowNs - current time in nanoseconds
+   * @param rate - allowed messages per second, 0 for unlimited
+   * @param burst - maximum number of messages that can be saved up
+   * @return true if the message is admitted
+   */
+  [[nodiscard]] constexpr bool try_consume(uint64_t nowNs, uint32_t rate,
+                                           uint32_t burst) noexcept {
+    if (rate == 0) {
+      return true;
+    }
+
+    uint64_t capacity =
+        static_cast<uint64_t>(std::max(burst, 1u)) * NS_PER_SEC;
+    uint64_t elapsed = nowNs > LastNs ? nowNs - LastNs : 0; // clock steps
+    LastNs = nowNs;
+    if (elapsed >= capacity / rate) { // also guards elapsed * rate overflow
+      Tokens = capacity;
+    } else {
+      Tokens = std::min(capacity, Tokens + elapsed * rate);
+    }
+
+    if (Tokens < NS_PER_SEC) {
+      return false;
+    }
+    Tokens -= NS_PER_SEC;
+    return true;
+  }
+};
+
+/**
+ * @brief State of the event loop handed to the connections on every sweep.
+ * It is computed once per loop iteration so admission decisions do not read
+ * the clock or any shared state per message.
+ */
+struct AdmissionState {
+  uint64_t NowNs{0};      // time of the current loop iteration
+  bool Overloaded{false}; // shed new risk before touching product state
+};
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef ASYNC_CLIENT_INCLUDED_H
+#define ASYNC_CLIENT_INCLUDED_H
+
+#include "orders.h"
+#include "protocol.h"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Non-blocking pipelined client of the risk server. Requests are
+ * queued and written in batches with sendmsg, responses are parsed from a
+ * stream buffer however the kernel coalesced them and handed to the callback
+ * of their order id. Up to a window of requests can wait for a response, so
+ * a strategy is bound by the bandwidth instead of the round trip.
+ *
+ * The client does not own a thread: callbacks run inside poll(), which must
+ * be called until the responses of interest arrived.
+ */
+class AsyncClient {
+public:
+  using ResponseCallback = std::function<void(OrderResponse const &)>;
+  using MassCancelCallback = std::function<void(MassCancelResponse const &)>;
+  using FillCallback = std::function<void(Trade const &)>;
+
+private:
+  enum { max_frame = 64, recv_size = 64 * 1024 };
+
+  /// An encoded request waiting for the socket
+  struct OutFrame {
+    std::array<char, max_frame> Bytes;
+    uint16_t Size;
+  };
+
+  int m_sockfd;
+  uint16_t m_version;                 // protocol version of the session
+  uint32_t m_window;                  // most requests awaiting a response
+  uint32_t m_inFlight;                // requests awaiting a response
+  uint32_t m_sequence;                // sequence number of the next request
+  std::deque<OutFrame> m_outbox;      // encoded, not yet fully written
+  size_t m_outOffset;                 // bytes of the first frame written
+  std::vector<char> m_inBuf;          // received, not yet parsed
+  size_t m_rdPos;                     // start of the unparsed bytes
+  size_t m_wrPos;                     // end of the received bytes
+  std::unordered_map<uint64_t, std::deque<ResponseCallback>> m_pending;
+  std::deque<MassCancelCallback> m_massCancels; // answered in order
+  FillCallback m_onFill;              // executions of the exchange
+  uint64_t m_batches;                 // sendmsg calls that sent data
+  uint64_t m_framesSent;
+
+public:
+  /**
+   * @param window - most requests that may wait for a response at once
+   */
+  explicit AsyncClient(uint32_t window);
+  ~AsyncClient();
+  AsyncClient(AsyncClient const &) = delete;
+  AsyncClient &operator=(AsyncClient const &) = delete;
+
+  /**
+   * @brief Connect to the server and negotiate the protocol version. The
+   * socket is non-blocking once this returns.
+   * @param host - the name of the server
+   * @param port - the port of the server
+   * @param version - highest protocol version to ask for
+   * @return false if the connection or the negotiation failed
+   */
+  bool connect(std::string const &host, std::string const &port,
+               uint16_t version = PROTOCOL_MAX);
+
+  /**
+   * @brief Queue a NewOrder.
+   * @param callback - receives the OrderResponse of the order
+   * @return false if the window is full, nothing is queued
+   */
+  bool new_order(uint64_t listingId, uint64_t orderId, uint64_t quantity,
+                 uint64_t price, char side, ResponseCallback callback);
+
+  /**
+   * @brief Queue a DeleteOrder.
+   * @return false if the window is full, nothing is queued
+   */
+  bool delete_order(uint64_t orderId, ResponseCallback callback);
+
+  /**
+   * @brief Queue a ModifyOrderQuantity.
+   * @return false if the window is full, nothing is queued
+   */
+  bool modify_order(uint64_t orderId, uint64_t newQuantity,
+                    ResponseCallback callback);
+
+  /**
+   * @brief Queue a CancelAll.
+   * @return false if the window is full, nothing is queued
+   */
+  bool cancel_all(MassCancelCallback callback);
+
+  /**
+   * @brief Queue a CancelByListing.
+   * @return false if the window is full, nothing is queued
+   */
+  bool cancel_listing(uint64_t listingId, MassCancelCallback callback);
+
+  /// Receive the executions the server reports for the orders
+  inline void on_fill(FillCallback callback) {
+    m_onFill = std::move(callback);
+  }
+
+  /**
+   * @brief Write the queued requests and dispatch the responses that
+   * arrived.
+   * @param timeoutMs - how long to wait for the socket, 0 to only check it
+   * @return false if the server hung up or the socket failed
+   */
+  bool poll(int timeoutMs);
+
+  /// Requests waiting for their response
+  [[nodiscard]] inline uint32_t in_flight() const noexcept {
+    return m_inFlight;
+  }
+
+  /// True if another request fits the window
+  [[nodiscard]] inline bool has_window() const noexcept {
+    return m_inFlight < m_window;
+  }
+
+  /// Protocol version negotiated with the server
+  [[nodiscard]] inline uint16_t version() const noexcept { return m_version; }
+
+  /// Average number of requests written per sendmsg
+  [[nodiscard]] inline double frames_per_batch() const noexcept {
+    return m_batches == 0 ? 0.0
+                          : static_cast<double>(m_framesSent) / m_batches;
+  }
+
+private:
+  /**
+   * @brief Encode a request in the session version and queue it.
+   */
+  template <Sendable T> void enqueue(Message<T> &msg);
+
+  /**
+   * @brief Write as many queued frames as the socket takes, in one sendmsg
+   * per IOV_MAX frames.
+   * @return false on a socket error
+   */
+  bool flush();
+
+  /**
+   * @brief Read what the socket has and dispatch every complete frame.
+   * @return false if the server hung up or the socket failed
+   */
+  bool receive();
+
+  /**
+   * @brief Dispatch one complete response frame.
+   */
+  void dispatch(char const *frame, size_t size);
+
+  template <Sendable T>
+  [[nodiscard]] bool decode(char const *frame, size_t size,
+                            Message<T> &msg) const;
+};
+
+/**
+ * @brief Callback that fulfils a future, for callers that prefer futures
+ * over callbacks. The future is ready after the poll() that received the
+ * response.
+ * @param future - receives the future of the response
+ */
+inline AsyncClient::ResponseCallback
+future_callback(std::future<OrderResponse> &future) {
+  auto promise = std::make_shared<std::promise<OrderResponse>>();
+  future = promise->get_future();
+  return [promise](OrderResponse const &resp) { promise->set_value(resp); };
+}
+
+#endif
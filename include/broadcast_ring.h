@@ -0,0 +1,90 @@
+#ifndef BROADCAST_RING_INCLUDED_H
+#define BROADCAST_RING_INCLUDED_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Bounded lock-free ring written by one producer thread and read
+ * through any number of cursors. Records are not popped: every reader keeps
+ * its own position and reads the slots in place, and the reader side hands a
+ * slot back with release() once the slowest cursor has moved past it. The
+ * producer never blocks, a ring whose oldest slot is still held is reported
+ * full.
+ *
+ * The cursors are plain positions owned by the reader side, the readers only
+ * have to agree on the release point, for example by being driven from a
+ * single thread.
+ * @tparam T - trivially copyable record
+ * @tparam Capacity - number of slots, a power of two
+ */
+template <typename T, size_t Capacity> class BroadcastRing {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "The capacity must be a power of two!");
+  static constexpr uint64_t MASK = Capacity - 1;
+
+  alignas(64) std::atomic<uint64_t> m_tail;     // next slot written
+  uint64_t m_releasedCache;                     // producer copy of m_released
+  alignas(64) std::atomic<uint64_t> m_released; // slots no cursor needs
+  alignas(64) std::array<T, Capacity> m_slots;
+
+public:
+  static constexpr size_t CAPACITY = Capacity;
+
+  BroadcastRing()
+      : m_tail(0), m_releasedCache(0), m_released(0), m_slots() {}
+  BroadcastRing(BroadcastRing const &) = delete;
+  BroadcastRing &operator=(BroadcastRing const &) = delete;
+
+  /**
+   * @brief Append a record, producer side only.
+   * @return false if the ring is full
+   */
+  bool try_push(T const &value) noexcept {
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_releasedCache == Capacity) {
+      m_releasedCache = m_released.load(std::memory_order_acquire);
+      if (tail - m_releasedCache == Capacity) {
+        return false;
+      }
+    }
+    m_slots[tail & MASK] = value;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Position after the last record pushed, reader side
+  [[nodiscard]] inline uint64_t published() const noexcept {
+    return m_tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Record at a position, reader side. Valid while the position is
+   * published and not released.
+   */
+  [[nodiscard]] inline T const &at(uint64_t position) const noexcept {
+    return m_slots[position & MASK];
+  }
+
+  /**
+   * @brief Number of records readable in one piece from a position before
+   * the ring wraps, at most count.
+   */
+  [[nodiscard]] static constexpr uint64_t
+  contiguous(uint64_t position, uint64_t count) noexcept {
+    uint64_t toEnd = Capacity - (position & MASK);
+    return count < toEnd ? count : toEnd;
+  }
+
+  /**
+   * @brief Hand the slots before a position back to the producer, reader
+   * side. The position must be the slowest cursor and never go back.
+   */
+  inline void release(uint64_t position) noexcept {
+    m_released.store(position, std::memory_order_release);
+  }
+};
+
+#endif
@@ -42,6 +42,12 @@ public:
    * and a payload packet of some sort.
    */
   template <Sendable T> void sendData(Message<T> &message);
+
+  /**
+   * @brief Receive a single response message of the given payload type from
+   * the server and print it.
+   */
+  template <Sendable T> void receiveData();
 };
 
 #endif
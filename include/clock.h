@@ -0,0 +1,102 @@
+#ifndef CLOCK_INCLUDED_H
+#define CLOCK_INCLUDED_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Cheap wall clock in nanoseconds from the Unix epoch. After
+ * calibrate() the time is derived from the invariant TSC with a fixed point
+ * multiply, which costs a few nanoseconds and never enters the kernel. Until
+ * then, or on machines without an invariant TSC, it falls back to the vDSO
+ * clock_gettime(CLOCK_REALTIME) which does not make a syscall either.
+ *
+ * The conversion parameters are guarded by a seqlock so recalibrate() can
+ * refine them from the event loop while other threads keep reading the
+ * clock: a reader retries until it read all of them under one even version.
+ */
+class FastClock {
+  static constexpr unsigned s_shift = 32;
+
+  struct Params {
+    std::atomic<uint64_t> BaseTsc{0}; // TSC at the last anchor point
+    std::atomic<uint64_t> BaseNs{0};  // epoch ns at the last anchor point
+    std::atomic<uint64_t> Mult{0};    // ns per tick scaled by 2^s_shift
+  };
+
+  static bool s_useTsc;
+  static Params s_params;
+  static std::atomic<uint64_t> s_version; // odd while s_params is written
+  static uint64_t s_firstTsc; // first calibration sample
+  static uint64_t s_firstNs;
+
+public:
+  /**
+   * @brief Measure the TSC frequency against CLOCK_REALTIME. Blocks for a few
+   * milliseconds and should be called once at startup before any thread
+   * reads the clock.
+   * @return true if the TSC is used, false if the fallback stays in place
+   */
+  static bool calibrate();
+
+  /**
+   * @brief Refine the TSC frequency over the whole time since calibrate() and
+   * re-anchor the clock to CLOCK_REALTIME. Meant to be called about once a
+   * second from a single thread; the clock may step by the drift accumulated
+   * since the previous anchor.
+   */
+  static void recalibrate();
+
+  /**
+   * @brief Current time in nanoseconds from the Unix epoch.
+   */
+  [[nodiscard]] static inline uint64_t now_ns() noexcept {
+#if defined(__x86_64__)
+    if (s_useTsc) {
+      uint64_t version, baseTsc, baseNs, mult;
+      do {
+        version = s_version.load(std::memory_order_acquire);
+        baseTsc = s_params.BaseTsc.load(std::memory_order_relaxed);
+        baseNs = s_params.BaseNs.load(std::memory_order_relaxed);
+        mult = s_params.Mult.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+      } while ((version & 1) != 0 ||
+               version != s_version.load(std::memory_order_relaxed));
+      unsigned __int128 ticks = __rdtsc() - baseTsc;
+      return baseNs + static_cast<uint64_t>((ticks * mult) >> s_shift);
+    }
+#endif
+    return realtime_ns();
+  }
+
+  /**
+   * @brief Current CLOCK_REALTIME in nanoseconds through the vDSO.
+   */
+  [[nodiscard]] static inline uint64_t realtime_ns() noexcept {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull +
+           static_cast<uint64_t>(ts.tv_nsec);
+  }
+};
+
+/**
+ * @brief Ingress and egress time of the last request of a session, in epoch
+ * nanoseconds. Ingress is taken when the bytes were read from the socket and
+ * egress when the response was handed to the kernel.
+ */
+struct LatencyStamps {
+  uint64_t IngressNs{0};
+  uint64_t EgressNs{0};
+
+  /// Time the request spent inside the server
+  [[nodiscard]] constexpr uint64_t residency_ns() const noexcept {
+    return EgressNs > IngressNs ? EgressNs - IngressNs : 0;
+  }
+};
+
+#endif
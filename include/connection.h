@@ -1,70 +1,440 @@
 #ifndef CONNECTION_INCLUDED_H
 #define CONNECTION_INCLUDED_H
 
+#include "admission.h"
+#include "clock.h"
+#include "gateway.h"
 #include "orders.h"
+#include "precheck.h"
+#include "protocol.h"
+#include "risk_context.h"
 #include "server_util.h"
+#include "session_task.h"
+#include "transport.h"
 #include <array>
+#include <coroutine>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <poll.h>
+#include <span>
 #include <unordered_map>
+#include <vector>
 
-class Server;
+/**
+ * @brief A trader session. Connections live inside the slots of the server
+ * ConnectionTable, the fields touched on every event are laid out first so
+ * dispatching a request touches as few cache lines as possible.
+ *
+ * A session is driven either by the hand-written handle_client_request, or,
+ * with coroutine sessions, by a coroutine that awaits read_frame() and
+ * write() and suspends whenever the non-blocking socket would block.
+ */
+class alignas(64) Connection {
+  /**
+   * @brief How to handle one message type, the dispatch table is indexed by
+   * the message type. Unused entries have a frame size of 0 in every version
+   * so they never match a frame.
+   */
+  struct DispatchEntry {
+    std::array<size_t, PROTOCOL_MAX + 1> FrameSize{}; // 0 if not carried
+    bool Admitted{false}; // passes admission control before it is handled
+    bool AddsRisk{false}; // also needs room in the queue to the exchange
+    void (Connection::*Handle)(){nullptr}; // decode, handle and respond
+    void (Connection::*Reject)(OrderResponse::Status){nullptr};
+  };
+  using DispatchTable = std::array<DispatchEntry, MAX_REQUEST_TYPE + 1>;
+
+  /// What a suspended session coroutine waits for
+  enum class SessionWait : uint8_t {
+    None,  // running, or not started yet
+    Read,  // the socket had no more bytes
+    Sweep, // the fair budget of the sweep is used up
+    Write  // the socket does not take the responses
+  };
+  enum class ReadStatus : uint8_t { Data, Again, Closed };
+  /// Outcome of looking for the next frame of a coroutine session
+  enum class FrameStatus : uint8_t {
+    Ready,  // a complete frame is buffered and the budget allows it
+    Closed, // the client hung up or the frame can never be framed
+    Read,   // wait for the socket to be readable
+    Sweep   // wait for the next sweep
+  };
 
-class Connection : public std::enable_shared_from_this<Connection> {
   static uint32_t s_sequenceNumber;
-  enum { buf_size = 256 };
-  std::array<char, buf_size> m_reqBuf;
-  std::unordered_map<uint64_t, Order> m_orders;
+  static const DispatchTable s_dispatch; // generated from RequestTypes
+  enum { buf_size = 1024 };
+  using RequestBuffer = std::array<char, buf_size>;
+  /// Request buffers of drained sessions, per thread driving sessions
+  static thread_local std::vector<std::unique_ptr<RequestBuffer>>
+      s_spareBuffers;
+
+  // hot: read on every event
+  std::unique_ptr<Transport> m_transport; // socket, or memory in benchmarks
+  uint32_t m_traderId;
+  uint32_t m_rdPos;   // start of the first unprocessed frame in m_reqBuf
+  uint32_t m_wrPos;   // receive cursor, end of the received bytes
+  uint16_t m_version; // protocol version negotiated for the session
+  size_t m_nbytes;    // size of the frame being handled
+  RiskContext *m_context; // limits and product state shared by sessions
+  TokenBucket m_bucket;   // message rate limit of the session
+  LatencyStamps m_stamps; // ingress / egress time of the last request
+  // only held while bytes are buffered, an idle session keeps none
+  std::unique_ptr<RequestBuffer> m_reqBuf;
+
+  // warm: touched by the order handlers, allocated from the hot memory
+  std::pmr::unordered_map<uint64_t, Order> m_orders;
+  std::pmr::unordered_map<uint64_t, std::pmr::vector<uint64_t>>
+      m_listingOrders; // listing id -> ids of the resting orders on it
+  PositionTable m_listingPositions; // open positions of the trader
+  NotionalExposure m_exposure; // notional exposure of the trader
+  uint32_t m_viewSlot;         // slot of the trader in the position view
+  uint16_t m_generation;       // generation of the next accepted order
   Message<OrderResponse> m_resBuf;
-  ssize_t m_nbytes;
-  int m_traderSock;
-  Server *m_server;
+  Message<MassCancelResponse> m_massCancelBuf;
+  Message<HelloResponse> m_helloBuf;
+  Message<PreCheckResponse> m_preCheckBuf;
+  alignas(8) std::array<char, 64> m_sendBuf; // response encoded for the wire
+
+  // coroutine sessions only, the pool is declared first so it outlives the
+  // frames of the session
+  std::unique_ptr<FramePool> m_framePool; // frames of the session coroutines
+  Task<> m_session;                       // the session coroutine
+  std::coroutine_handle<> m_resumePoint;  // innermost suspended coroutine
+  SessionWait m_wait;
+  uint32_t m_budget;                      // frames left in this sweep
+  AdmissionState const *m_admission;      // of the current sweep
+  std::vector<char> m_outBuf;             // responses not written yet
+  size_t m_outPos;                        // bytes of m_outBuf written
 
 public:
-  Connection(int sockfd, Server *owner);
-  ~Connection();
+  /**
+   * @brief Create a trader session.
+   * @param transport - the stream the requests arrive on, owned from now on
+   * @param traderId - the id the server assigned to the trader
+   * @param context - the engine state the session applies its risk to, the
+   * order tables are reserved for OrdersPerTrader orders from its memory
+   * @param coroutine - drive the session with a coroutine, the transport
+   * must then be non-blocking
+   */
+  Connection(std::unique_ptr<Transport> transport, uint32_t traderId,
+             RiskContext *context, bool coroutine = false);
+  ~Connection() = default;
   Connection(Connection const &) = delete;
   Connection &operator=(Connection const &) = delete;
 
   /**
-   * @brief Handle a client request and send back an appropriate response.
-   * The method can handle any Sendable type of client request.
+   * @brief Read the client requests from the socket and handle at most the
+   * fair budget of them, sending back an appropriate response for each. The
+   * method can handle any Sendable type of client request. Frames beyond the
+   * budget stay buffered for the next sweep of the event loop.
+   * @param readable - true if the socket has data to read
+   * @param admission - the admission state of the current loop iteration
+   * @param writable - true if the socket takes data again, coroutine
+   * sessions only
+   * @return false if the client hung up or sent a frame that can never be
+   * framed and the connection should be deregistered, true otherwise
+   */
+  bool handle_client_request(bool readable, AdmissionState const &admission,
+                             bool writable = false);
+
+  /**
+   * @brief Check if a complete request is waiting in the buffer.
+   * @return true if the next frame has been fully received
+   */
+  [[nodiscard]] bool has_pending_request() const noexcept;
+
+  /**
+   * @brief Check if the session has requests to serve without waiting for
+   * the socket. A coroutine session waiting to write does not, even if
+   * requests are buffered.
+   */
+  [[nodiscard]] inline bool has_runnable_request() const noexcept {
+    return m_framePool == nullptr ? has_pending_request()
+                                  : m_wait == SessionWait::Sweep;
+  }
+
+  /**
+   * @brief The poll events the session waits for. A coroutine session stops
+   * reading while its responses do not fit the socket.
+   */
+  [[nodiscard]] inline short poll_events() const noexcept {
+    if (m_framePool == nullptr) {
+      return POLLIN;
+    }
+    short events = m_wait == SessionWait::Write ? 0 : POLLIN;
+    return m_outPos != m_outBuf.size() ? events | POLLOUT : events;
+  }
+
+  /// The pool the session coroutines allocate their frames from
+  [[nodiscard]] inline FramePool &frame_pool() noexcept {
+    return *m_framePool;
+  }
+
+  /**
+   * @brief Ingress and egress timestamps of the last handled request, for
+   * latency accounting.
+   */
+  [[nodiscard]] inline LatencyStamps const &get_stamps() const noexcept {
+    return m_stamps;
+  }
+
+  /// Number of received bytes that have not been handled yet
+  [[nodiscard]] inline size_t buffered_bytes() const noexcept {
+    return m_wrPos - m_rdPos;
+  }
+
+  /**
+   * @brief Evaluate hypothetical new orders of the trader against the current
+   * risk state, see precheck_orders. Nothing is changed.
+   * @param orders - the candidate orders
+   * @param passed - bit i is set if order i would be accepted, must hold
+   * precheck_words(orders.size()) words
+   */
+  inline void precheck(std::span<WhatIfOrder const> orders,
+                       std::span<uint64_t> passed) const {
+    precheck_orders(m_context->Info, m_context->Products, m_context->Groups,
+                    m_exposure, orders, passed);
+  }
+
+  /**
+   * @brief Apply a fill the exchange reported for one of the trader's orders
+   * and forward it to the trader as a Trade in the session's protocol version.
+   * The fill already happened, it is booked even if the order was cancelled
+   * or reduced meanwhile and only the quantity still resting is released.
+   * @param fill - the fill routed back by the exchange gateway
+   */
+  void handle_fill(GatewayFill const &fill);
+
+  /**
+   * @brief Cancel every resting order of the trader and release them from the
+   * product state. Called when the trader disconnects.
+   * @return the number of cancelled orders
    */
-  void handle_client_request();
+  size_t discard_trader_state();
+
+  /**
+   * @brief Take the transport out of the session, so it can be closed on
+   * another thread. The session must not be served afterwards.
+   */
+  [[nodiscard]] inline std::unique_ptr<Transport> release_transport() noexcept {
+    return std::move(m_transport);
+  }
+
+  /**
+   * @brief Take the open positions of the trader out of the session, fills
+   * racing the cancels of a disconnect still move them.
+   */
+  [[nodiscard]] inline PositionTable release_positions() noexcept {
+    return std::move(m_listingPositions);
+  }
 
   /**
    * @brief Get the underlying socket for communication.
-   * @return the socket for communication
+   * @return the socket for communication, INVALID_FD without a socket
+   */
+  inline int get_socket() const noexcept { return m_transport->fd(); }
+
+  /**
+   * @brief Get the id the server assigned to the trader of this session.
+   * @return the trader id
+   */
+  inline uint32_t get_trader_id() const noexcept { return m_traderId; }
+
+  /**
+   * @brief Get the slot of the trader in the shared position view.
+   * @return the slot, NO_VIEW_SLOT if the trader has not been published
    */
-  inline int get_socket() const noexcept { return m_traderSock; }
+  inline uint32_t get_view_slot() const noexcept { return m_viewSlot; }
 
 private:
   /**
-   * @brief Helper method to extract the client request from the network stream
+   * @brief Helper method to extract the client request from the transport
    * into a local connection buffer.
+   * @return false if the client hung up or the read failed
    */
-  void fill_request_buffer();
+  bool fill_request_buffer();
 
   /**
-   * @brief Shutdown the communication with the client. It will shutdown the
-   * socket and then close it.
+   * @brief Read what the transport has into the request buffer, after
+   * moving the partial frame to its front.
+   * @return Again if a non-blocking transport has nothing, Closed if the
+   * client hung up or the read failed
    */
-  void shutdown_connection();
+  ReadStatus read_some();
 
   /**
-   * @brief Generate response message to be sent to the client.
+   * @brief Hand the request buffer back to the spare buffers of the thread,
+   * once every received byte has been handled.
    */
-  void generate_response_msg();
+  void release_request_buffer() noexcept;
 
   /**
-   * @brief Send the response message to the client
+   * @brief The session coroutine: handle the buffered frames, write their
+   * responses with one write, read more, until the client hangs up. It is
+   * the only coroutine frame of the session, serving a frame that is already
+   * buffered resumes nothing.
    */
-  void send_message();
+  Task<> run_session();
 
   /**
-   * @brief Handle arbitrary order of some Sendable type. The method will
-   * deserialize the local buffer into a message print it out and then handle
-   * the request.
+   * @brief Look for the next frame of the session, reading from the socket
+   * while only a part of it is buffered.
+   * @return Ready with the budget charged, Closed, or what to wait for
+   */
+  FrameStatus next_frame();
+
+  /// Suspends the session until a frame can be handled, see read_frame()
+  struct FrameAwaiter {
+    Connection &Conn;
+    FrameStatus Status{FrameStatus::Ready};
+
+    bool await_ready() {
+      Status = Conn.next_frame();
+      return Status == FrameStatus::Ready || Status == FrameStatus::Closed;
+    }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+      Conn.suspend(handle, Status == FrameStatus::Read ? SessionWait::Read
+                                                       : SessionWait::Sweep);
+    }
+    FrameStatus await_resume() const noexcept { return Status; }
+  };
+
+  /**
+   * @brief Wait until a complete frame is buffered and the fair budget of
+   * the sweep allows to handle it. Completes without suspending when one is.
+   * @return Ready, Closed, or after a suspension the wait that ended, then
+   * the caller looks again
+   */
+  FrameAwaiter read_frame() noexcept { return FrameAwaiter{*this}; }
+
+  /// Writes the buffered responses, suspends until the socket took them all
+  struct WriteAwaiter {
+    Connection &Conn;
+    bool Ok{true};
+
+    bool await_ready() {
+      Ok = Conn.flush_output();
+      return !Ok || Conn.m_outPos == Conn.m_outBuf.size();
+    }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+      Conn.suspend(handle, SessionWait::Write);
+    }
+    bool await_resume() const noexcept { return Ok; }
+  };
+
+  /// Write the buffered responses of a coroutine session
+  WriteAwaiter write() noexcept { return WriteAwaiter{*this}; }
+
+  /// Remember where the session suspended and what it waits for
+  inline void suspend(std::coroutine_handle<> handle,
+                      SessionWait wait) noexcept {
+    m_resumePoint = handle;
+    m_wait = wait;
+  }
+
+  /**
+   * @brief Serve a coroutine session: write what is buffered, then resume
+   * the coroutine if what it waits for happened.
+   * @return false if the session ended
+   */
+  bool resume_session(bool readable, bool writable,
+                      AdmissionState const &admission);
+
+  /**
+   * @brief Write as much of the buffered responses as the socket takes.
+   * @return false if the write failed
+   */
+  bool flush_output();
+
+  /**
+   * @brief Size of the frame at the read position as declared by its header.
+   * At least a full header must be buffered.
+   */
+  [[nodiscard]] size_t frame_size() const noexcept;
+
+  /**
+   * @brief Handle the complete frame at the read position and advance past it.
+   * @param admission - the admission state of the current loop iteration
+   * @return false if the connection should be deregistered
+   */
+  bool handle_frame(AdmissionState const &admission);
+
+  /**
+   * @brief Admission control for requests that add risk or evaluate it. The
+   * global overload mode and, for requests adding risk, the room left
+   * towards the exchange are checked first, then the token bucket of the
+   * session.
+   * @param admission - the admission state of the current loop iteration
+   * @param addsRisk - true if the request would be forwarded to the exchange
+   * @return ACCEPTED if the request may be handled, otherwise the status it
+   * should be rejected with
+   */
+  OrderResponse::Status admit(AdmissionState const &admission, bool addsRisk);
+
+  /**
+   * @brief Reject the T frame at the read position without touching the
+   * product state. Only the order id, if T has one, is used for the response.
+   * @param status - the rejection status
+   */
+  template <Sendable T> void reject_frame(OrderResponse::Status status);
+
+  /**
+   * @brief Send an order response rejecting a request.
+   * @param orderId - the order id of the request, 0 if it has none
+   * @param status - the rejection status
+   */
+  void send_rejection(uint64_t orderId, OrderResponse::Status status);
+
+  /**
+   * @brief Report the decision on a request to the instrumentation and copy
+   * it to the drop copy feed, a single ring write. Nothing is copied if the
+   * feed is not running.
+   * @param timestampNs - when the request was read
+   * @param request - the decided request, a frame that could not be decoded
+   * is copied as its message type alone
+   * @param status - the status the request was answered with
+   * @param count - orders cancelled by a mass cancel
+   */
+  template <typename T>
+  void drop_copy(uint64_t timestampNs, T const &request,
+                 OrderResponse::Status status, uint64_t count = 0);
+
+  /**
+   * @brief Generate the dispatch table entries of a list of request types at
+   * compile time. Two types sharing a message type fail the build.
+   */
+  template <typename... Ts>
+  static constexpr DispatchTable make_dispatch_table(TypeList<Ts...>);
+
+  /// Fill in the dispatch table entry of a single request type
+  template <Sendable T> static constexpr void add_entry(DispatchTable &table);
+
+  /**
+   * @brief Generate the header of a response message to be sent to the client.
+   * The timestamp is the egress time in nanoseconds from the Unix epoch.
+   * @param msg - the response message whose header should be filled
+   */
+  template <Sendable T> void generate_response_msg(Message<T> &msg);
+
+  /**
+   * @brief Encode the response message in the protocol version of the session
+   * and send it to the client
+   * @param msg - the response message in host byte order
+   */
+  template <Sendable T> void send_message(Message<T> const &msg);
+
+  /**
+   * @brief Decode the frame at the read position, which must fit T, through
+   * the codec of its protocol version.
+   */
+  template <Sendable T> [[nodiscard]] Message<T> decode_frame() const;
+
+  /**
+   * @brief Handle the request of type T at the read position. The entry of
+   * T in the dispatch table points here: the frame is decoded with
+   * decode_frame, handed to the handle_order overload of T, and the result is
+   * copied, framed and sent from the response buffer of its type.
    */
   template <Sendable T> void handle_order();
 
@@ -102,6 +472,99 @@ private:
    */
   OrderResponse handle_order(Message<Trade> const &msg);
 
+  /**
+   * @brief Handle cancel all request from the client. Every resting order of
+   * the trader is cancelled in one pass and the product state is released.
+   * @param msg - the cancel all message from the client
+   * @return MassCancelResponse - message to be sent back to the client
+   */
+  MassCancelResponse handle_order(Message<CancelAll> const &msg);
+
+  /**
+   * @brief Handle cancel by listing request from the client. Every resting
+   * order of the trader on the given listing is cancelled in one pass using
+   * the listing index.
+   * @param msg - the cancel by listing message from the client
+   * @return MassCancelResponse - message to be sent back to the client
+   */
+  MassCancelResponse handle_order(Message<CancelByListing> const &msg);
+
+  /**
+   * @brief Handle hello request from the client. The highest protocol version
+   * both sides speak is chosen, the session switches to it once the response
+   * has been sent.
+   * @param msg - the hello message from the client
+   * @return HelloResponse - message to be sent back to the client
+   */
+  HelloResponse handle_order(Message<Hello> const &msg);
+
+  /**
+   * @brief Handle pre-check request from the client. The candidate orders are
+   * evaluated against the current risk state in one batch, no order is placed
+   * and no state is changed.
+   * @param msg - the pre-check message from the client
+   * @return PreCheckResponse - message to be sent back to the client
+   */
+  PreCheckResponse handle_order(Message<PreCheck> const &msg);
+
+  /**
+   * @brief Release the quantity of the given resting orders of one listing
+   * from the product state with a single product update. The orders are not
+   * erased, the caller is responsible for that.
+   * @param listingId - the listing the orders rest on
+   * @param orderIds - the ids of the orders being cancelled
+   */
+  void release_listing(uint64_t listingId,
+                       std::pmr::vector<uint64_t> const &orderIds);
+
+  /**
+   * @brief Apply a risk delta to the product and to the exposure of the trader.
+   * The worst positions and the product and trader notional limits are checked
+   * in the same pass, nothing is updated if a limit would be exceeded.
+   * @param productId - the listing the delta applies to
+   * @param delta - the change caused by the event
+   * @param enforce - false for risk reducing events that are always applied
+   * @return false if the delta was rejected
+   */
+  bool apply_risk(uint64_t productId, RiskDelta const &delta, bool enforce);
+
+  /**
+   * @brief Book a fill into the position of the trader and the product. The
+   * caller takes the rested quantity off the order.
+   * @param listingId - the listing of the order
+   * @param side - the side of the order
+   * @param quantity - the traded quantity
+   * @param rested - the part of the quantity that was still resting
+   * @param orderPrice - the price the resting quantity was held at
+   * @param tradePrice - the price of the fill
+   */
+  void book_fill(uint64_t listingId, char side, uint64_t quantity,
+                 uint64_t rested, Price orderPrice, Price tradePrice);
+
+  /**
+   * @brief Queue an accepted request for the exchange when a gateway is
+   * running. Never blocks, an order that does not fit the queue is held back
+   * by the gateway and forwarded once there is room.
+   * @param kind - new order, quantity change or cancel
+   * @param orderId - the id of the order
+   * @param ord - the order, with its new quantity for a change
+   */
+  void forward_to_exchange(GatewayOrder::Kind kind, uint64_t orderId,
+                           Order const &ord);
+
+  /**
+   * @brief Store an accepted order and add it to the listing index.
+   * @param orderId - the id of the accepted order
+   * @param ord - the accepted order
+   */
+  void insert_order(uint64_t orderId, Order ord);
+
+  /**
+   * @brief Remove an order from the trader orders and from the listing index.
+   * @param orderId - the id of the order to remove
+   */
+  void erase_order(uint64_t orderId);
+
   /**
    * @brief Find an order with a specific ID for the trader. If the order does
    * not exist simply return a nullopt.
@@ -109,7 +572,7 @@ private:
    * @return nullopt if the order does not exist otherwise an optional with the
    * order value inside.
    */
-  std::optional<Order> find_order_by_id(int orderId);
+  std::optional<Order> find_order_by_id(uint64_t orderId);
 };
 
 #endif
@@ -0,0 +1,120 @@
+#ifndef CONNECTION_TABLE_INCLUDED_H
+#define CONNECTION_TABLE_INCLUDED_H
+
+#include "connection.h"
+#include "server_util.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief Reference to a connection stored in the ConnectionTable. The
+ * generation of the slot is bumped every time a connection is removed so a
+ * handle that outlived its connection (the fd got reused) is detected.
+ */
+struct ConnectionHandle {
+  int Fd{INVALID_FD};
+  uint32_t Generation{0};
+};
+
+/**
+ * @brief Dense table of the live connections indexed directly by their fd.
+ * Connections are constructed in place inside fixed size chunks of slots, so
+ * their addresses are stable and finding the connection of an event is a
+ * shift and a mask instead of a hash lookup.
+ */
+class ConnectionTable {
+  enum { chunk_bits = 6, chunk_size = 1 << chunk_bits };
+
+  struct Slot {
+    uint32_t Generation{0};
+    std::optional<Connection> Conn{};
+  };
+  using Chunk = std::array<Slot, chunk_size>;
+
+  std::vector<std::unique_ptr<Chunk>> m_chunks;
+  size_t m_size;
+
+public:
+  ConnectionTable();
+  ConnectionTable(ConnectionTable const &) = delete;
+  ConnectionTable &operator=(ConnectionTable const &) = delete;
+
+  /**
+   * @brief Construct a connection over the socket in the slot of its fd. An
+   * existing connection on the same fd is replaced.
+   * @param coroutine - drive the session with a coroutine, the socket must be
+   * non-blocking
+   * @return the handle of the new connection
+   */
+  ConnectionHandle emplace(int fd, uint32_t traderId, RiskContext *context,
+                           bool coroutine = false);
+
+  /**
+   * @brief Create the slots of the fds below the given one up front, so
+   * accepting a connection does not allocate a chunk.
+   */
+  void reserve(size_t fds);
+
+  /**
+   * @brief Remove the connection referenced by the handle.
+   * @return false if the handle was stale and nothing was removed
+   */
+  bool erase(ConnectionHandle handle);
+
+  /**
+   * @brief Get the live connection on the given fd.
+   * @return the connection or nullptr if the fd has no connection
+   */
+  [[nodiscard]] inline Connection *get(int fd) noexcept {
+    Slot *slot = find_slot(fd);
+    return slot != nullptr && slot->Conn ? &*slot->Conn : nullptr;
+  }
+
+  /**
+   * @brief Get the connection referenced by the handle.
+   * @return the connection or nullptr if the handle is stale
+   */
+  [[nodiscard]] inline Connection *get(ConnectionHandle handle) noexcept {
+    Slot *slot = find_slot(handle.Fd);
+    return slot != nullptr && slot->Conn &&
+                   slot->Generation == handle.Generation
+               ? &*slot->Conn
+               : nullptr;
+  }
+
+  /**
+   * @brief Get the handle of the live connection on the given fd.
+   * @return the handle or nullopt if the fd has no connection
+   */
+  [[nodiscard]] std::optional<ConnectionHandle> handle(int fd) noexcept;
+
+  /// Number of live connections
+  [[nodiscard]] inline size_t size() const noexcept { return m_size; }
+
+  /**
+   * @brief Call the function for every live connection.
+   */
+  template <typename F> void for_each(F &&func) {
+    for (auto &chunk : m_chunks) {
+      for (Slot &slot : *chunk) {
+        if (slot.Conn) {
+          func(*slot.Conn);
+        }
+      }
+    }
+  }
+
+private:
+  [[nodiscard]] inline Slot *find_slot(int fd) noexcept {
+    size_t idx = static_cast<size_t>(fd);
+    if (fd < 0 || (idx >> chunk_bits) >= m_chunks.size()) {
+      return nullptr;
+    }
+    return &(*m_chunks[idx >> chunk_bits])[idx & (chunk_size - 1)];
+  }
+};
+
+#endif
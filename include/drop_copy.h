@@ -0,0 +1,153 @@
+#ifndef DROP_COPY_INCLUDED_H
+#define DROP_COPY_INCLUDED_H
+
+#include "broadcast_ring.h"
+#include "metrics.h"
+#include "server_util.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr uint64_t DROP_COPY_MAGIC = 0x59504F434B534952; // "RISKCOPY"
+static constexpr uint32_t DROP_COPY_VERSION = 1;
+
+/**
+ * @brief Sent once to every subscriber when it connects. The feed is written
+ * in host byte order.
+ */
+struct DropCopyHeader {
+  uint64_t Magic{DROP_COPY_MAGIC};
+  uint32_t Version{DROP_COPY_VERSION};
+  uint32_t Reserved{0};
+};
+static_assert(sizeof(DropCopyHeader) == 16,
+              "The DropCopyHeader size is not correct!");
+
+/**
+ * @brief One risk decision of the server: the request of a trader, or a fill
+ * of the gateway, and the status it was answered with.
+ */
+struct DropCopyEvent {
+  uint64_t Sequence{0};    // position in the feed, a gap means lost events
+  uint64_t TimestampNs{0}; // when the request was read
+  uint32_t TraderId{0};
+  uint16_t MessageType{0}; // type of the request
+  uint16_t Status{0};      // OrderResponse::Status of the answer
+  uint64_t OrderId{0};     // order id, trade id of a fill
+  uint64_t ListingId{0};
+  uint64_t Quantity{0};    // of the order or fill, count of a mass cancel
+  uint64_t Price{0};
+  char Side{0};
+  char Reserved[7]{};
+};
+static_assert(sizeof(DropCopyEvent) == 64,
+              "The DropCopyEvent size is not correct!");
+
+static constexpr size_t DROP_COPY_RING_SIZE = 1 << 16;
+/// A subscriber this many events behind the feed is detached
+static constexpr uint64_t DROP_COPY_MAX_LAG = DROP_COPY_RING_SIZE / 2;
+
+/**
+ * @brief Copies every risk decision to local subscribers, for compliance and
+ * downstream systems. The risk loop pushes a fixed size record into a
+ * lock-free ring and never waits on a subscriber. A fan-out thread keeps a
+ * cursor per subscriber into the ring and writes every subscriber all the
+ * records it has not seen yet, straight from the ring and in as few sends as
+ * the ring allows. A subscriber that falls too far behind is detached before
+ * it could hold up the ring.
+ *
+ * Subscribers connect to a TCP port on the loopback interface or to a UNIX
+ * socket and receive the DropCopyHeader followed by the DropCopyEvents
+ * decided from then on.
+ */
+class DropCopy {
+  using EventRing = BroadcastRing<DropCopyEvent, DROP_COPY_RING_SIZE>;
+
+  /// A connected subscriber and how far it has been written
+  struct Subscriber {
+    int Fd{INVALID_FD};
+    uint64_t Cursor{0}; // next byte to write, as ring position * record size
+  };
+
+  // the ring is megabytes, it is only allocated by start()
+  std::unique_ptr<EventRing> m_ring;
+  bool m_enabled;
+  bool m_published; // events pushed since the fan-out thread was last woken
+  uint64_t m_sequence;
+  int m_event;      // eventfd waking the fan-out thread
+  int m_listenerFd;
+
+  // owned by the fan-out thread
+  std::vector<Subscriber> m_subscribers;
+  std::jthread m_thread;
+
+public:
+  DropCopy();
+  ~DropCopy();
+  DropCopy(DropCopy const &) = delete;
+  DropCopy &operator=(DropCopy const &) = delete;
+
+  /**
+   * @brief Listen for subscribers and start the fan-out thread.
+   * @param endpoint - a port on the loopback interface, or the path of a
+   * UNIX socket
+   * @return false if the endpoint could not be opened
+   */
+  bool start(std::string const &endpoint);
+
+  /// True once the feed is running
+  [[nodiscard]] inline bool enabled() const noexcept { return m_enabled; }
+
+  /**
+   * @brief Copy a decision to the feed, risk loop only. Never blocks, the
+   * fan-out thread is woken by flush(). The sequence number is assigned
+   * here, an event that does not fit the ring is lost and leaves a gap.
+   * @param event - the decision, its Sequence is ignored
+   */
+  inline void publish(DropCopyEvent event) noexcept {
+    if (!m_enabled) {
+      return;
+    }
+    event.Sequence = m_sequence++;
+    if (!m_ring->try_push(event)) {
+      Metrics::add(Metric::DropCopyLost);
+      return;
+    }
+    m_published = true;
+  }
+
+  /**
+   * @brief Wake the fan-out thread if events were published since the last
+   * call. Called once per sweep of the risk loop so a burst costs one write.
+   */
+  void flush() noexcept;
+
+private:
+  /**
+   * @brief Body of the fan-out thread.
+   */
+  void run(std::stop_token stop);
+
+  /**
+   * @brief Accept the subscribers waiting on the listener, they start at
+   * the next event published.
+   */
+  void accept_subscribers(uint64_t published);
+
+  /**
+   * @brief Write a subscriber the events it has not seen, one send per
+   * piece of the ring, until its socket is full.
+   * @return false if the subscriber went away or fell too far behind
+   */
+  bool send_events(Subscriber &sub, uint64_t published);
+
+  /**
+   * @brief Open the listener for the endpoint.
+   * @return the listening socket or INVALID_FD
+   */
+  static int open_listener(std::string const &endpoint);
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef EXECUTOR_INCLUDED_H
+#define EXECUTOR_INCLUDED_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Small work-stealing thread pool for the slow path of the server:
+ * work that must not run on the event loop thread but does not need the
+ * risk state either, like closing the sockets of disconnected traders or
+ * reading a changed limits file. Every worker owns a deque, takes its own
+ * tasks from the front and steals from the back of the others when it runs
+ * dry. A task that needs the engine posts a completion, which the event loop
+ * runs between two sweeps after the completion fd became readable.
+ *
+ * Without worker threads every task runs on the thread that posts it and
+ * every completion right away, so the server behaves the same with the pool
+ * disabled.
+ */
+class Executor {
+public:
+  using Work = std::function<void()>;
+
+private:
+  struct Task {
+    Work Run{};
+    uint64_t PostedNs{0};
+  };
+
+  /// Deque of one worker, padded so workers do not share its lock
+  struct alignas(64) WorkerQueue {
+    std::mutex Mutex{};
+    std::deque<Task> Tasks{};
+  };
+
+  static thread_local int t_worker; // index of the calling worker, or -1
+
+  std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+  std::mutex m_idleMutex;
+  std::condition_variable_any m_idle;
+  std::atomic<size_t> m_queued;  // tasks posted and not started yet
+  std::atomic<uint32_t> m_next;  // queue of the next task posted from outside
+  std::mutex m_doneMutex;
+  std::vector<Work> m_done;      // completions the event loop has not run
+  std::vector<Work> m_doneBatch; // completions being run, event loop only
+  int m_doneEvent;               // readable while completions are queued
+  std::vector<std::jthread> m_threads; // last, joined before the queues die
+
+public:
+  Executor();
+  ~Executor();
+  Executor(Executor const &) = delete;
+  Executor &operator=(Executor const &) = delete;
+
+  /**
+   * @brief Start the workers and create the completion fd.
+   * @param threads - number of workers, 0 to run every task inline
+   * @return false if the completion fd could not be created
+   */
+  bool start(unsigned threads);
+
+  /**
+   * @brief Queue a task. A worker queues onto its own deque, any other
+   * thread spreads its tasks round robin.
+   * @param work - run once on a worker
+   */
+  void post(Work work);
+
+  /**
+   * @brief Hand a result back to the event loop. Called from a task.
+   * @param done - run once on the event loop thread
+   */
+  void complete(Work done);
+
+  /**
+   * @brief Run the completions posted so far. Event loop thread only.
+   * @return the number of completions run
+   */
+  size_t run_completions();
+
+  /// Readable while completions are waiting, INVALID_FD without workers
+  [[nodiscard]] inline int completion_fd() const noexcept {
+    return m_doneEvent;
+  }
+
+  /// Number of workers, 0 if tasks run inline
+  [[nodiscard]] inline size_t threads() const noexcept {
+    return m_threads.size();
+  }
+
+  /// Tasks posted and not started yet
+  [[nodiscard]] inline size_t queued() const noexcept {
+    return m_queued.load(std::memory_order_relaxed);
+  }
+
+private:
+  /**
+   * @brief Body of a worker: run its own tasks, then steal, then sleep
+   * until a task is posted.
+   */
+  void run(std::stop_token stop, unsigned self);
+
+  /**
+   * @brief Run a task from the front of the own deque, or else from the back
+   * of another one.
+   * @return false if every deque was empty
+   */
+  bool run_one(unsigned self);
+
+  /// Run a task and account for its wait and run time
+  static void execute(Task &task, bool stolen);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef FIXED_POINT_INCLUDED_H
+#define FIXED_POINT_INCLUDED_H
+
+#include <cstdint>
+#include <limits>
+
+static constexpr uint64_t IMPLICIT_DEC = 10000;
+
+/// Price with 4 implicit decimals, kept exactly as it arrives on the wire
+using Price = uint64_t;
+
+/// Signed amount of money (price x quantity) with 4 implicit decimals
+using Notional = int64_t;
+
+static constexpr Notional NOTIONAL_MAX = std::numeric_limits<Notional>::max();
+static constexpr Notional NOTIONAL_MIN = std::numeric_limits<Notional>::min();
+
+/**
+ * @brief Notional value of a quantity traded at a price. The product is formed
+ * in a 128-bit intermediate so it cannot wrap and is then saturated into the
+ * Notional range. The result keeps the 4 implicit decimals of the price.
+ * @param price - the price with 4 implicit decimals
+ * @param quantity - the quantity
+ * @return price * quantity clamped to NOTIONAL_MAX
+ */
+[[nodiscard]] constexpr Notional notional(Price price,
+                                          uint64_t quantity) noexcept {
+  unsigned __int128 value = static_cast<unsigned __int128>(price) * quantity;
+  return value > static_cast<unsigned __int128>(NOTIONAL_MAX)
+             ? NOTIONAL_MAX
+             : static_cast<Notional>(value);
+}
+
+/**
+ * @brief Add two notionals, saturating instead of wrapping on overflow. A
+ * saturated result is not reversible, so running totals only ever take values
+ * the limit checks found exact (see NotionalExposure::exact), a request that
+ * would overflow one is rejected.
+ */
+[[nodiscard]] constexpr Notional notional_add(Notional lhs,
+                                              Notional rhs) noexcept {
+  Notional out = 0;
+  if (__builtin_add_overflow(lhs, rhs, &out)) {
+    return rhs > 0 ? NOTIONAL_MAX : NOTIONAL_MIN;
+  }
+  return out;
+}
+
+/**
+ * @brief Subtract two notionals, saturating instead of wrapping on overflow.
+ * Running totals follow the rules of notional_add.
+ */
+[[nodiscard]] constexpr Notional notional_sub(Notional lhs,
+                                              Notional rhs) noexcept {
+  Notional out = 0;
+  if (__builtin_sub_overflow(lhs, rhs, &out)) {
+    return rhs < 0 ? NOTIONAL_MAX : NOTIONAL_MIN;
+  }
+  return out;
+}
+
+/**
+ * @brief Convert a fixed point value to a double. Only meant for printing, no
+ * risk decision should ever be taken on the result.
+ */
+[[nodiscard]] constexpr double fixed_to_double(int64_t value) noexcept {
+  return static_cast<double>(value) / IMPLICIT_DEC;
+}
+
+[[nodiscard]] constexpr double fixed_to_double(uint64_t value) noexcept {
+  return static_cast<double>(value) / IMPLICIT_DEC;
+}
+
+static_assert(notional(12345, 10) == 123450, "notional keeps 4 decimals");
+static_assert(notional(std::numeric_limits<Price>::max(), 2) == NOTIONAL_MAX,
+              "notional must saturate");
+static_assert(notional_add(NOTIONAL_MAX, 1) == NOTIONAL_MAX,
+              "notional_add must saturate");
+static_assert(notional_sub(NOTIONAL_MIN, 1) == NOTIONAL_MIN,
+              "notional_sub must saturate");
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef GATEWAY_INCLUDED_H
+#define GATEWAY_INCLUDED_H
+
+#include "metrics.h"
+#include "order_journal.h"
+#include "orders.h"
+#include "server_util.h"
+#include "spsc_queue.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief An accepted request on its way from the risk loop to the exchange.
+ * The trader fd and id route the fills of the order back to its session.
+ */
+struct GatewayOrder {
+  enum class Kind : uint8_t { New, Modify, Delete };
+
+  Kind Type{Kind::New};
+  char Side{'B'};
+  int TraderFd{INVALID_FD};
+  uint32_t TraderId{0};
+  uint64_t OrderId{0};   // order id of the trader
+  uint64_t ListingId{0};
+  uint64_t Quantity{0};  // total quantity for New, new quantity for Modify
+  uint64_t Price{0};
+  uint16_t Generation{0}; // of the order, see Order::m_generation
+};
+
+/**
+ * @brief A fill reported by the exchange, routed back to the trader session
+ * which applies it as a Trade. The fill already happened, so it is booked even
+ * if the order was cancelled or reduced in the meantime.
+ */
+struct GatewayFill {
+  int TraderFd{INVALID_FD};
+  uint32_t TraderId{0};
+  uint64_t OrderId{0};
+  uint64_t ListingId{0};
+  uint64_t Quantity{0};
+  uint64_t Price{0};
+  char Side{'B'};
+  uint16_t Generation{0}; // of the filled order, see Order::m_generation
+
+  /// The fill as the Trade the trader is sent
+  [[nodiscard]] inline Trade trade() const noexcept {
+    Trade trade;
+    trade.messageType = Trade::MESSAGE_TYPE;
+    trade.listingId = ListingId;
+    trade.tradeId = OrderId;
+    trade.tradeQuantity = Quantity;
+    trade.tradePrice = Price;
+    return trade;
+  }
+
+  /// The fill as it is journaled, before any resting quantity is released
+  [[nodiscard]] inline ExchangeFillRecord record() const noexcept {
+    return ExchangeFillRecord{.ListingId = ListingId,
+                              .OrderId = OrderId,
+                              .Quantity = Quantity,
+                              .Price = Price,
+                              .Rested = 0,
+                              .Side = Side};
+  }
+};
+
+static constexpr size_t GATEWAY_QUEUE_SIZE = 1 << 16;
+/// Outbound slots only cancels may use, new risk is shed before they run out
+static constexpr size_t GATEWAY_CANCEL_RESERVE = 4096;
+static constexpr size_t GATEWAY_BUF_SIZE = 64 * 1024;
+
+/**
+ * @brief Exchange simulator for tests and benchmarks. It speaks protocol
+ * version 2 on one end of a socket pair: every NewOrder,
+ * ModifyOrderQuantity and DeleteOrder is acknowledged with an OrderResponse,
+ * and a new order is immediately filled for a fixed share of its quantity at
+ * its own price. The fill is reported as a Trade whose tradeId is the order
+ * id the gateway assigned.
+ */
+class MockExchange {
+  struct Resting {
+    uint64_t ListingId{0};
+    uint64_t Quantity{0};
+  };
+
+  int m_fd;
+  uint32_t m_fillPct;
+  std::unordered_map<uint64_t, Resting> m_book; // order id -> open order
+  std::jthread m_thread;
+
+public:
+  MockExchange() : m_fd(INVALID_FD), m_fillPct(100), m_book(), m_thread() {}
+  ~MockExchange();
+  MockExchange(MockExchange const &) = delete;
+  MockExchange &operator=(MockExchange const &) = delete;
+
+  /**
+   * @brief Start serving the gateway on the given socket.
+   * @param fd - the exchange end of the socket pair, owned from now on
+   * @param fillPct - share of every new order filled on arrival, 0 to 100
+   */
+  void start(int fd, uint32_t fillPct);
+
+private:
+  /**
+   * @brief Body of the exchange thread.
+   */
+  void run(std::stop_token stop);
+
+  /**
+   * @brief Handle one order frame and append the reports to the output.
+   * @return number of bytes appended
+   */
+  size_t handle_frame(char const *frame, uint16_t msgType, char *out);
+};
+
+/**
+ * @brief Outbound stage between the risk loop and a downstream exchange. The
+ * risk loop pushes accepted orders into a lock-free queue and never waits on
+ * the exchange. The gateway thread drains the queue, encodes the orders in
+ * protocol version 2 and writes each batch with a single send. Fills read
+ * from the exchange travel back through a second queue, and an eventfd in the
+ * poll set of the risk loop signals that fills are waiting.
+ */
+class ExchangeGateway {
+  /// Where the fills of an order sent to the exchange belong. A cancelled
+  /// route is kept until the exchange acknowledged every request of the
+  /// order, fills racing the cancel still reach the trader.
+  struct Route {
+    int TraderFd{INVALID_FD};
+    uint32_t TraderId{0};
+    uint64_t OrderId{0};
+    uint64_t ListingId{0};
+    uint64_t Remaining{0}; // open quantity, the route ends when it is filled
+    uint32_t Unacked{0};   // requests the exchange has not acknowledged yet
+    uint16_t Generation{0};
+    char Side{'B'};
+    bool Cancelled{false};
+  };
+
+  using RouteMap = std::unordered_map<uint64_t, Route>;
+  using OrderQueue = SpscQueue<GatewayOrder, GATEWAY_QUEUE_SIZE>;
+  using FillQueue = SpscQueue<GatewayFill, GATEWAY_QUEUE_SIZE>;
+
+  // the queues are megabytes, they are only allocated by start()
+  std::unique_ptr<OrderQueue> m_outbound; // risk loop -> gateway
+  std::unique_ptr<FillQueue> m_fills;     // gateway -> risk loop
+  std::deque<GatewayOrder> m_backlog;     // did not fit the queue yet
+  bool m_enabled;
+  bool m_pushed;      // orders pushed since the gateway was last woken
+  int m_orderEvent;   // eventfd waking the gateway thread
+  int m_fillEvent;    // eventfd in the poll set of the risk loop
+  int m_exchangeFd;   // downstream exchange connection
+  uint32_t m_sequenceNumber;
+
+  // owned by the gateway thread
+  uint64_t m_nextExchangeId;
+  RouteMap m_routes; // exchange order id -> route
+  std::unordered_map<uint32_t, std::unordered_map<uint64_t, uint64_t>>
+      m_exchangeIds; // trader id -> order id -> exchange order id
+  uint32_t m_rxPos;
+  std::vector<char> m_rxBuf;
+  std::vector<char> m_txBuf;
+
+  MockExchange m_mock;
+  std::jthread m_thread;
+
+public:
+  ExchangeGateway();
+  ~ExchangeGateway();
+  ExchangeGateway(ExchangeGateway const &) = delete;
+  ExchangeGateway &operator=(ExchangeGateway const &) = delete;
+
+  /**
+   * @brief Connect to the exchange and start the gateway thread.
+   * @param exchange - "mock" for the in-process MockExchange, or HOST:PORT
+   * of an exchange speaking protocol version 2
+   * @param mockFillPct - share of every order the mock exchange fills
+   * @return false if the exchange could not be reached
+   */
+  bool start(std::string const &exchange, uint32_t mockFillPct);
+
+  /// True once the gateway is running
+  [[nodiscard]] inline bool enabled() const noexcept { return m_enabled; }
+
+  /// The eventfd the risk loop polls for fills, INVALID_FD if disabled
+  [[nodiscard]] inline int fill_fd() const noexcept {
+    return m_enabled ? m_fillEvent : INVALID_FD;
+  }
+
+  /**
+   * @brief Check whether an order adding risk can still be forwarded. The
+   * last GATEWAY_CANCEL_RESERVE slots are kept for cancels, and no new risk
+   * is taken while orders are held back.
+   */
+  [[nodiscard]] inline bool has_capacity() const noexcept {
+    return !m_enabled || (m_backlog.empty() && m_outbound->free_slots() >
+                                                   GATEWAY_CANCEL_RESERVE);
+  }
+
+  /// True while orders wait for room in the queue, risk loop only
+  [[nodiscard]] inline bool backlogged() const noexcept {
+    return !m_backlog.empty();
+  }
+
+  /**
+   * @brief Queue an accepted order for the exchange, risk loop only. Never
+   * blocks and never drops the order: one that does not fit the queue is
+   * held back, in order, until flush() finds room for it. The gateway thread
+   * is woken by flush().
+   */
+  void forward(GatewayOrder const &order);
+
+  /**
+   * @brief Move the held back orders into the queue as far as they fit and
+   * wake the gateway thread if orders were forwarded since the last call.
+   * Called once per iteration of the risk loop so a burst costs one write.
+   */
+  void flush() noexcept;
+
+  /**
+   * @brief Hand every waiting fill to the callback, risk loop only.
+   * @return number of fills handled
+   */
+  template <typename F> size_t drain_fills(F &&onFill);
+
+private:
+  /**
+   * @brief Body of the gateway thread.
+   */
+  void run(std::stop_token stop);
+
+  /**
+   * @brief Encode the queued orders and write them to the exchange, as many
+   * per send as fit the transmit buffer.
+   * @return false if the exchange connection failed
+   */
+  bool send_orders();
+
+  /**
+   * @brief Write a batch to the exchange. While the socket is full the
+   * reports of the exchange are read, so neither side can stall the other.
+   * @return false if the exchange connection failed
+   */
+  bool write_exchange(char const *data, size_t size);
+
+  /**
+   * @brief Encode a single order into the transmit buffer.
+   * @return number of bytes written, 0 if the order has no exchange id
+   */
+  size_t encode_order(GatewayOrder const &order, char *out);
+
+  /**
+   * @brief Read the reports of the exchange, queue the fills and end the
+   * cancelled routes the exchange has acknowledged.
+   * @return false if the exchange connection failed
+   */
+  bool read_reports();
+
+  /**
+   * @brief Count an acknowledgement of the exchange. A cancelled route ends
+   * with the acknowledgement of its last request, the exchange reports
+   * nothing for the order after it.
+   */
+  void acknowledge(uint64_t exchangeId);
+
+  /**
+   * @brief End a route once the exchange will report nothing more for it.
+   */
+  void end_route(RouteMap::iterator route_it);
+
+  /**
+   * @brief Route a fill reported by the exchange back to its trader. Fills
+   * are never dropped for lack of space, the gateway thread waits for the
+   * risk loop instead. A filled route ends once its requests are
+   * acknowledged.
+   */
+  void route_fill(uint64_t exchangeId, uint64_t quantity, uint64_t price);
+
+  /**
+   * @brief Connect to HOST:PORT.
+   * @return the connected socket or INVALID_FD
+   */
+  static int connect_exchange(std::string const &exchange);
+};
+
+#include "gateway.inl"
+
+#endif
@@ -0,0 +1,41 @@
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+inline void ExchangeGateway::forward(GatewayOrder const &order) {
+  if (m_backlog.empty() && m_outbound->try_push(order)) {
+    m_pushed = true;
+    return;
+  }
+  m_backlog.push_back(order); // behind the held back ones, keeps the order
+  Metrics::add(Metric::GatewayBacklog);
+}
+
+inline void ExchangeGateway::flush() noexcept {
+  size_t moved = 0;
+  while (moved != m_backlog.size() &&
+         m_outbound->try_push(m_backlog[moved])) {
+    ++moved;
+  }
+  if (moved != 0) {
+    m_backlog.erase(m_backlog.begin(), m_backlog.begin() + moved);
+    Metrics::sub(Metric::GatewayBacklog, moved);
+    m_pushed = true;
+  }
+  if (m_pushed) {
+    eventfd_write(m_orderEvent, 1);
+    m_pushed = false;
+  }
+}
+
+template <typename F> size_t ExchangeGateway::drain_fills(F &&onFill) {
+  eventfd_t pending = 0;
+  eventfd_read(m_fillEvent, &pending); // non-blocking, resets the counter
+
+  size_t handled = 0;
+  GatewayFill fill;
+  while (m_fills->try_pop(fill)) {
+    onFill(fill);
+    ++handled;
+  }
+  return handled;
+}
@@ -0,0 +1,64 @@
+#ifndef HOT_MEMORY_INCLUDED_H
+#define HOT_MEMORY_INCLUDED_H
+
+#include "server_util.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+
+/**
+ * @brief Generous estimate of the memory the hot tables need for the expected
+ * load: the product map nodes per listing, the order map and listing index
+ * entries per resting order, and the bucket arrays of both.
+ * @return the size in bytes, 0 if no capacity was configured
+ */
+constexpr size_t hot_memory_bytes(uint64_t listings, uint64_t traders,
+                                  uint64_t ordersPerTrader) noexcept {
+  return listings * 256 + traders * (ordersPerTrader * 192 + 4096);
+}
+
+/**
+ * @brief Memory the event loop allocates its hot tables from: the product map
+ * and the order tables of the sessions. A region sized for the expected load
+ * is mapped once, optionally backed by huge pages, and faulted in up front so
+ * the first orders of the day neither take page faults nor wait for the
+ * allocator to grow the heap. Blocks freed by the tables are recycled through
+ * a pool, a region that runs out falls back to the heap.
+ *
+ * The pool is not synchronized, only the event loop thread may allocate from
+ * it. Without a region the default resource is handed out.
+ */
+class HotMemory {
+  void *m_mapping;      // start of the mapping, not aligned
+  size_t m_mappingSize; // size of the mapping
+  size_t m_size;        // usable bytes of the region
+  bool m_hugeTlb;       // backed by explicit huge pages
+  std::optional<std::pmr::monotonic_buffer_resource> m_arena; // the region
+  std::optional<std::pmr::unsynchronized_pool_resource> m_pool;
+
+public:
+  /**
+   * @brief Map and pre-fault the region. A failure is reported and the
+   * tables fall back to the heap, like the other tuning knobs.
+   * @param bytes - size of the region, 0 to allocate from the heap
+   * @param pages - the huge pages backing the region
+   */
+  HotMemory(size_t bytes, HugePageMode pages);
+  ~HotMemory();
+  HotMemory(HotMemory const &) = delete;
+  HotMemory &operator=(HotMemory const &) = delete;
+
+  /// The resource the hot tables allocate from
+  [[nodiscard]] inline std::pmr::memory_resource *resource() noexcept {
+    return m_pool ? &*m_pool : std::pmr::get_default_resource();
+  }
+
+  /// Usable bytes of the pre-faulted region, 0 if none is mapped
+  [[nodiscard]] inline size_t size() const noexcept { return m_size; }
+
+  /// True if the region is backed by explicit huge pages
+  [[nodiscard]] inline bool huge_tlb() const noexcept { return m_hugeTlb; }
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef INSTRUMENTATION_INCLUDED_H
+#define INSTRUMENTATION_INCLUDED_H
+
+#include "metrics.h"
+#include <cstdint>
+
+/**
+ * USDT (user-level statically defined tracing) probes in the format of
+ * systemtap's <sys/sdt.h>, which perf and bpftrace read from the
+ * .note.stapsdt section of the binary. A probe is a single nop until a tracer
+ * attaches to it, the arguments are described by their locations so nothing
+ * is copied. Every argument is passed as a 64 bit unsigned integer.
+ *
+ *   bpftrace -e 'usdt:./server:risk:decision { @[arg2] = count(); }'
+ */
+#if defined(__linux__) && defined(__GNUC__)
+#define RISK_PROBE_ASM(name, args)                                             \
+  "990: nop\n"                                                                 \
+  ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                \
+  ".balign 4\n"                                                                \
+  ".4byte 992f-991f, 994f-993f, 3\n"                                           \
+  "991: .asciz \"stapsdt\"\n"                                                  \
+  "992: .balign 4\n"                                                           \
+  "993: .8byte 990b\n"                                                         \
+  ".8byte _.stapsdt.base\n"                                                    \
+  ".8byte 0\n" /* no semaphore, the probe is always armed */                   \
+  ".asciz \"risk\"\n"                                                          \
+  ".asciz \"" name "\"\n"                                                      \
+  ".asciz \"" args "\"\n"                                                      \
+  "994: .balign 4\n"                                                           \
+  ".popsection\n"                                                              \
+  ".ifndef _.stapsdt.base\n"                                                   \
+  ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"      \
+  ".weak _.stapsdt.base\n"                                                     \
+  ".hidden _.stapsdt.base\n"                                                   \
+  "_.stapsdt.base: .space 1\n"                                                 \
+  ".size _.stapsdt.base, 1\n"                                                  \
+  ".popsection\n"                                                              \
+  ".endif\n"
+#define RISK_PROBE2(name, a, b)                                                \
+  __asm__ __volatile__(RISK_PROBE_ASM(name, "8@%0 8@%1")                       \
+                       :                                                       \
+                       : "nor"(static_cast<uint64_t>(a)),                      \
+                         "nor"(static_cast<uint64_t>(b)))
+#define RISK_PROBE3(name, a, b, c)                                             \
+  __asm__ __volatile__(RISK_PROBE_ASM(name, "8@%0 8@%1 8@%2")                  \
+                       :                                                       \
+                       : "nor"(static_cast<uint64_t>(a)),                      \
+                         "nor"(static_cast<uint64_t>(b)),                      \
+                         "nor"(static_cast<uint64_t>(c)))
+#else
+#define RISK_PROBE2(name, a, b) ((void)(a), (void)(b))
+#define RISK_PROBE3(name, a, b, c) ((void)(a), (void)(b), (void)(c))
+#endif
+
+/**
+ * @brief Instrumentation that compiles away, the hooks are empty so the
+ * pipeline is the same code as without them.
+ */
+struct NullInstrumentation {
+  static constexpr char const *NAME = "null";
+
+  static inline void on_recv(uint32_t, uint64_t) noexcept {}
+  static inline void on_decode(uint32_t, uint16_t) noexcept {}
+  static inline void on_decision(uint32_t, uint16_t, uint16_t) noexcept {}
+  static inline void on_send(uint32_t, uint64_t) noexcept {}
+  static inline void on_sweep(uint64_t, uint64_t) noexcept {}
+};
+
+/**
+ * @brief Counts every stage of the pipeline in the thread blocks of the
+ * metrics, a relaxed add per hook.
+ */
+struct CounterInstrumentation {
+  static constexpr char const *NAME = "counters";
+
+  static inline void on_recv(uint32_t, uint64_t) noexcept {
+    Metrics::add(Metric::PipelineRecv);
+  }
+  static inline void on_decode(uint32_t, uint16_t) noexcept {
+    Metrics::add(Metric::PipelineDecode);
+  }
+  static inline void on_decision(uint32_t, uint16_t, uint16_t) noexcept {
+    Metrics::add(Metric::PipelineDecision);
+  }
+  static inline void on_send(uint32_t, uint64_t) noexcept {
+    Metrics::add(Metric::PipelineSend);
+  }
+  static inline void on_sweep(uint64_t, uint64_t) noexcept {}
+};
+
+/**
+ * @brief The counters, plus a USDT probe at every hook for perf and bpftrace
+ * to attach to at runtime:
+ *   risk:recv     trader id, bytes read
+ *   risk:decode   trader id, message type
+ *   risk:decision trader id, message type, OrderResponse::Status
+ *   risk:send     trader id, bytes written
+ *   risk:sweep    fds with events, duration of the sweep in ns
+ */
+struct TraceInstrumentation {
+  static constexpr char const *NAME = "trace";
+
+  static inline void on_recv(uint32_t traderId, uint64_t bytes) noexcept {
+    CounterInstrumentation::on_recv(traderId, bytes);
+    RISK_PROBE2("recv", traderId, bytes);
+  }
+  static inline void on_decode(uint32_t traderId, uint16_t type) noexcept {
+    CounterInstrumentation::on_decode(traderId, type);
+    RISK_PROBE2("decode", traderId, type);
+  }
+  static inline void on_decision(uint32_t traderId, uint16_t type,
+                                 uint16_t status) noexcept {
+    CounterInstrumentation::on_decision(traderId, type, status);
+    RISK_PROBE3("decision", traderId, type, status);
+  }
+  static inline void on_send(uint32_t traderId, uint64_t bytes) noexcept {
+    CounterInstrumentation::on_send(traderId, bytes);
+    RISK_PROBE2("send", traderId, bytes);
+  }
+  static inline void on_sweep(uint64_t events, uint64_t sweepNs) noexcept {
+    RISK_PROBE2("sweep", events, sweepNs);
+  }
+};
+
+/**
+ * @brief The policy the server and the sessions are built with, chosen by
+ * the RISK_INSTRUMENTATION CMake option. Production builds default to null.
+ */
+#if defined(RISK_INSTRUMENTATION_TRACE)
+using Instrumentation = TraceInstrumentation;
+#elif defined(RISK_INSTRUMENTATION_COUNTERS)
+using Instrumentation = CounterInstrumentation;
+#else
+using Instrumentation = NullInstrumentation;
+#endif
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef LIMIT_TREE_INCLUDED_H
+#define LIMIT_TREE_INCLUDED_H
+
+#include "fixed_point.h"
+#include "server_util.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static constexpr uint32_t MAX_GROUP_DEPTH = 8; // groups above a listing
+
+/**
+ * @brief A product group (an underlying, a sector, the whole book) with its
+ * notional limits and the aggregate of its constituents. Gross sums the gross
+ * notional of the constituents, Exposure nets their resting and position
+ * notional, so the net limit lets a group hedge across its listings.
+ */
+struct GroupNode {
+  uint32_t Parent{NO_GROUP};
+  Notional GrossLimit{NOTIONAL_MAX}; // 4 implicit decimals
+  Notional NetLimit{NOTIONAL_MAX};   // 4 implicit decimals
+  Notional Gross{0};                 // sum of the constituent gross notional
+  NotionalExposure Exposure{};       // sum of the constituent exposure
+};
+
+/**
+ * @brief Hierarchy of group limits above the listings. Every listing belongs
+ * to at most one group and every group to at most one parent, so a change of
+ * a listing touches the chain of groups above it and nothing else. The
+ * aggregates are maintained incrementally from the deltas the sessions
+ * commit, a check never re-sums the constituents of a group and costs
+ * O(depth). Parents are defined before their children, which rules out
+ * cycles, and chains are at most MAX_GROUP_DEPTH long.
+ *
+ * Only the event loop thread reads and updates the aggregates.
+ */
+class LimitTree {
+  std::vector<GroupNode> m_nodes; // parents come before their children
+  std::vector<std::string> m_names;
+  std::unordered_map<std::string, uint32_t> m_byName;
+  std::unordered_map<uint64_t, uint32_t> m_listingGroup; // listing -> group
+
+public:
+  LimitTree() : m_nodes(), m_names(), m_byName(), m_listingGroup() {}
+
+  /**
+   * @brief Load the groups and the listings in them from a text file. Every
+   * line is one of
+   *   group <name> <parent|-> <gross notional|-> <net notional|->
+   *   listing <id> <group>
+   * with notionals in 4 implicit decimals and - for none. Empty lines and
+   * lines starting with # are skipped.
+   * @param path - the file to load
+   * @return false if the file cannot be read or a line is invalid
+   */
+  bool load(std::string const &path);
+
+  /**
+   * @brief Add a group below an existing one.
+   * @param name - unique name of the group
+   * @param parent - the parent group, NO_GROUP for a root
+   * @param grossLimit - limit of the summed gross notional
+   * @param netLimit - limit of the netted notional
+   * @return the index of the group, NO_GROUP if the name is taken, the
+   * parent does not exist or the chain would be too deep
+   */
+  uint32_t add_group(std::string const &name, uint32_t parent,
+                     Notional grossLimit, Notional netLimit);
+
+  /**
+   * @brief Take over the limits of a freshly loaded tree, keeping the
+   * aggregates. Products resolved their group once, so only a tree with the
+   * same groups, parents and listings is accepted.
+   * @param loaded - the tree loaded from the edited file
+   * @return false if the structure differs, nothing is changed then
+   */
+  bool update_limits(LimitTree const &loaded);
+
+  /**
+   * @brief Put a listing into a group. Only listings that have no product
+   * state yet can be assigned, the group of a product is resolved once.
+   * @return false if the group does not exist
+   */
+  bool assign_listing(uint64_t listingId, uint32_t group);
+
+  /// The group a listing belongs to, NO_GROUP if none
+  [[nodiscard]] uint32_t group_of(uint64_t listingId) const noexcept {
+    auto it = m_listingGroup.find(listingId);
+    return it == m_listingGroup.end() ? NO_GROUP : it->second;
+  }
+
+  /**
+   * @brief Check the chain of groups above a listing against a change of the
+   * listing, in a single walk up the chain.
+   * @param group - the group of the listing
+   * @param delta - the change of the listing exposure
+   * @param grossDelta - the change of the listing gross notional
+   * @return true if any group limit would be exceeded
+   */
+  [[nodiscard]] bool exceeds_limits(uint32_t group,
+                                    NotionalExposure const &delta,
+                                    Notional grossDelta) const noexcept {
+    for (; group != NO_GROUP; group = m_nodes[group].Parent) {
+      GroupNode const &node = m_nodes[group];
+      NotionalExposure exposure = node.Exposure;
+      apply_delta(exposure, delta);
+      // a saturated total would not be reversible, it exceeds any limit
+      Notional gross = notional_add(node.Gross, grossDelta);
+      if (!exposure.exact() || gross == NOTIONAL_MAX ||
+          gross > node.GrossLimit || exposure.net() > node.NetLimit) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Commit a change of a listing to the chain of groups above it.
+   * @param group - the group of the listing
+   * @param delta - the change of the listing exposure
+   * @param grossDelta - the change of the listing gross notional
+   */
+  void apply(uint32_t group, NotionalExposure const &delta,
+             Notional grossDelta) noexcept {
+    for (; group != NO_GROUP; group = m_nodes[group].Parent) {
+      GroupNode &node = m_nodes[group];
+      node.Gross = notional_add(node.Gross, grossDelta);
+      apply_delta(node.Exposure, delta);
+    }
+  }
+
+  /// Number of groups
+  [[nodiscard]] inline size_t size() const noexcept { return m_nodes.size(); }
+
+  [[nodiscard]] inline GroupNode const &node(uint32_t group) const noexcept {
+    return m_nodes[group];
+  }
+
+  [[nodiscard]] inline std::string const &name(uint32_t group) const noexcept {
+    return m_names[group];
+  }
+};
+
+#endif
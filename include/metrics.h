@@ -0,0 +1,161 @@
+#ifndef METRICS_INCLUDED_H
+#define METRICS_INCLUDED_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Every counter and gauge exported by the server. Counters only grow,
+ * gauges are kept as signed deltas so increments and decrements from any
+ * thread sum up to the current value.
+ */
+enum class Metric : uint32_t {
+  // messages received, by type
+  MessagesNewOrder,
+  MessagesDeleteOrder,
+  MessagesModifyOrderQuantity,
+  MessagesTrade,
+  MessagesCancelAll,
+  MessagesCancelByListing,
+  MessagesHello,
+  MessagesPreCheck,
+  MessagesUnknown,
+  // order responses, by status
+  ResponsesAccepted,
+  ResponsesRejected,
+  ResponsesThrottled,
+  ResponsesOverloaded,
+  // traffic and sessions
+  BytesIn,
+  BytesOut,
+  SessionsAccepted,
+  SessionsClosed,
+  SessionsEvicted,
+  LoopIterations,
+  LoopTimeNsTotal,
+  // exchange gateway
+  GatewayOrders,
+  GatewayFills,
+  GatewayDropped,
+  // slow path executor
+  ExecutorTasks,
+  ExecutorTasksStolen,
+  ExecutorWaitNsTotal,
+  ExecutorRunNsTotal,
+  ExecutorCompletions,
+  // drop copy feed
+  DropCopyEvents,
+  DropCopyLost,
+  DropCopyDetached,
+  // gauges
+  ActiveSessions,
+  RestingOrders,
+  LoopTimeNsLast,
+  ExecutorQueued,
+  DropCopySubscribers,
+  GatewayBacklog,
+  // pipeline stages, only counted by the counters and trace instrumentation,
+  // kept last so the slots above do not move between the builds
+  PipelineRecv,
+  PipelineDecode,
+  PipelineDecision,
+  PipelineSend,
+  Count
+};
+
+/**
+ * @brief Counters of a single thread. Only the owning thread writes them, so
+ * an update is a relaxed load and store without a locked instruction, and the
+ * block is padded to whole cache lines so no two threads share one. Blocks
+ * are never freed, a thread that exits keeps its totals.
+ */
+struct alignas(64) MetricsBlock {
+  std::array<std::atomic<uint64_t>, static_cast<size_t>(Metric::Count)>
+      Values{};
+};
+
+/**
+ * @brief Entry point of the hot path. Values are aggregated over all the
+ * thread blocks only when the metrics are scraped.
+ */
+class Metrics {
+  static thread_local MetricsBlock *t_block;
+
+public:
+  /**
+   * @brief Add to a counter or gauge of the calling thread.
+   */
+  static inline void add(Metric metric, uint64_t value = 1) noexcept {
+    std::atomic<uint64_t> &slot =
+        local().Values[static_cast<size_t>(metric)];
+    slot.store(slot.load(std::memory_order_relaxed) + value,
+               std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Subtract from a gauge of the calling thread.
+   */
+  static inline void sub(Metric metric, uint64_t value = 1) noexcept {
+    add(metric, -value); // wraps, gauges are summed as two's complement
+  }
+
+  /**
+   * @brief Overwrite a gauge of the calling thread.
+   */
+  static inline void set(Metric metric, uint64_t value) noexcept {
+    local().Values[static_cast<size_t>(metric)].store(
+        value, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Counter of the received messages of the given wire type.
+   */
+  static Metric message_metric(uint16_t messageType) noexcept;
+
+  /**
+   * @brief Counter of the order responses with the given status.
+   */
+  static Metric response_metric(uint16_t status) noexcept;
+
+  /**
+   * @brief Sum all thread blocks and render them in the Prometheus text
+   * exposition format.
+   */
+  static std::string render();
+
+private:
+  static inline MetricsBlock &local() noexcept {
+    if (t_block == nullptr) [[unlikely]] {
+      t_block = register_thread();
+    }
+    return *t_block;
+  }
+
+  static MetricsBlock *register_thread();
+};
+
+/**
+ * @brief Minimal HTTP endpoint serving Metrics::render() on the loopback
+ * interface from its own thread. Every request gets the full text, the
+ * request itself is not parsed.
+ */
+class MetricsEndpoint {
+  std::jthread m_thread;
+
+public:
+  MetricsEndpoint() : m_thread() {}
+  MetricsEndpoint(MetricsEndpoint const &) = delete;
+  MetricsEndpoint &operator=(MetricsEndpoint const &) = delete;
+
+  /**
+   * @brief Bind the port on 127.0.0.1 and start serving scrapes.
+   * @param port - the port to listen on
+   * @return false if the port could not be bound
+   */
+  bool start(std::string const &port);
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef ORDER_JOURNAL_INCLUDED_H
+#define ORDER_JOURNAL_INCLUDED_H
+
+#include "orders.h"
+#include "server_util.h"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr uint64_t ORDER_LOG_MAGIC = 0x4C4E524A4B534952; // "RISKJRNL"
+static constexpr uint32_t ORDER_LOG_VERSION = 2;
+/// Record version of the end of a session, the record carries no frame
+static constexpr uint16_t ORDER_LOG_SESSION_END = 0;
+/// Record version of a fill of the exchange, the frame is an
+/// ExchangeFillRecord. Unlike a Trade of the trader it is booked even if its
+/// order is gone.
+static constexpr uint16_t ORDER_LOG_EXCHANGE_FILL = 0xFFFF;
+
+/**
+ * @brief Start of an order log. The log is written in host byte order, the
+ * frames keep the byte order of their protocol version.
+ */
+struct OrderLogHeader {
+  uint64_t Magic{ORDER_LOG_MAGIC};
+  uint32_t Version{ORDER_LOG_VERSION};
+  uint32_t Reserved{0};
+};
+static_assert(sizeof(OrderLogHeader) == 16,
+              "The OrderLogHeader size is not correct!");
+
+/**
+ * @brief Header of every record, followed by FrameSize bytes of the request
+ * frame exactly as it was received.
+ */
+struct OrderLogRecord {
+  uint64_t TimestampNs{0}; // when the frame was handled
+  uint32_t TraderId{0};
+  uint16_t Version{0};     // protocol version of the frame, or a record kind
+  uint16_t FrameSize{0};
+};
+static_assert(sizeof(OrderLogRecord) == 16,
+              "The OrderLogRecord size is not correct!");
+
+/**
+ * @brief Frame of an EXCHANGE_FILL record, in host byte order like the record
+ * header. Rested is the resting quantity the server released with the fill,
+ * 0 if the filled order had left the book, so a replay never has to guess
+ * which order a reused order id named.
+ */
+struct ExchangeFillRecord {
+  uint64_t ListingId{0};
+  uint64_t OrderId{0}; // order id of the trader
+  uint64_t Quantity{0};
+  uint64_t Price{0};   // trade price, 4 implicit decimals
+  uint64_t Rested{0};
+  char Side{'B'};
+  std::array<char, 7> Reserved{};
+};
+static_assert(sizeof(ExchangeFillRecord) == 48,
+              "The ExchangeFillRecord size is not correct!");
+
+/**
+ * @brief Journal of every request frame that reached the risk checks, and of
+ * every fill of the gateway, in the order the server handled them, for
+ * offline replay. The event loop only appends to a memory
+ * buffer and hands it to a background writer thread once per sweep, so the
+ * order path never waits on the disk.
+ */
+class OrderJournal {
+  std::vector<char> m_buffer;  // records of the current sweep
+  std::mutex m_mutex;
+  std::condition_variable_any m_cv;
+  std::vector<char> m_pending; // records handed to the writer
+  int m_fd;
+  std::jthread m_thread;
+
+public:
+  OrderJournal();
+  ~OrderJournal();
+  OrderJournal(OrderJournal const &) = delete;
+  OrderJournal &operator=(OrderJournal const &) = delete;
+
+  /**
+   * @brief Create the log file, write its header and start the writer thread.
+   * @param path - the log file, truncated if it exists
+   * @return false if the file could not be created
+   */
+  bool open(std::string const &path);
+
+  /// True once the journal has been opened
+  [[nodiscard]] inline bool enabled() const noexcept {
+    return m_fd != INVALID_FD;
+  }
+
+  /**
+   * @brief Append a record to the buffer of the current sweep. Does nothing
+   * if the journal is not open.
+   * @param timestampNs - when the frame was handled
+   * @param traderId - the trader that sent the frame
+   * @param version - protocol version of the frame, SESSION_END or
+   * EXCHANGE_FILL
+   * @param frame - the frame as received
+   * @param size - size of the frame
+   */
+  inline void append(uint64_t timestampNs, uint32_t traderId,
+                     uint16_t version, char const *frame, size_t size) {
+    if (m_fd == INVALID_FD) {
+      return;
+    }
+    OrderLogRecord record{.TimestampNs = timestampNs,
+                          .TraderId = traderId,
+                          .Version = version,
+                          .FrameSize = static_cast<uint16_t>(size)};
+    char const *head = reinterpret_cast<char const *>(&record);
+    m_buffer.insert(m_buffer.end(), head, head + sizeof(record));
+    m_buffer.insert(m_buffer.end(), frame, frame + size);
+  }
+
+  /**
+   * @brief Append a fill of the exchange as an EXCHANGE_FILL record. Does
+   * nothing if the journal is not open.
+   * @param timestampNs - when the fill was booked
+   * @param traderId - the trader of the filled order
+   * @param fill - the fill and the resting quantity it released
+   */
+  void append_fill(uint64_t timestampNs, uint32_t traderId,
+                   ExchangeFillRecord const &fill);
+
+  /**
+   * @brief Hand the records of the sweep to the writer thread.
+   */
+  void flush();
+
+private:
+  /**
+   * @brief Body of the writer thread.
+   */
+  void run(std::stop_token stop);
+
+  /**
+   * @brief Write a whole buffer to the log file.
+   */
+  void write_out(std::vector<char> const &records);
+};
+
+#endif
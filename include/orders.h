@@ -11,7 +11,7 @@
 #define SERIALIZE_64(prop) (prop = htobe64(prop))
 
 #define DESERIALIZE_16(prop) (prop = ntohs(prop))
-#define DESERIALIZE_32(prop) (prop = ntohs(prop))
+#define DESERIALIZE_32(prop) (prop = ntohl(prop))
 #define DESERIALIZE_64(prop) (prop = be64toh(prop))
 
 /**
@@ -90,7 +90,12 @@ static_assert(sizeof(Trade) == 34, "The Trade size is not correct!");
  */
 struct OrderResponse {
   static constexpr uint16_t MESSAGE_TYPE = 5;
-  enum class Status : uint16_t { ACCEPTED = 0, REJECTED = 1 };
+  enum class Status : uint16_t {
+    ACCEPTED = 0,
+    REJECTED = 1,
+    THROTTLED = 2, // the session exceeded its message rate
+    OVERLOADED = 3 // the server is shedding load
+  };
 
   uint16_t messageType; // the type of the message
   uint64_t orderId;     // the id of the order that we will send status to
@@ -99,6 +104,112 @@ struct OrderResponse {
 static_assert(sizeof(OrderResponse) == 12,
               "The OrderResponse size is not correct!");
 
+/**
+ * @brief Payload packet for the CancelAll type of request. This request aims to
+ * cancel every resting order of the trader in a single round trip.
+ */
+struct CancelAll {
+  static constexpr uint16_t MESSAGE_TYPE = 6;
+  uint16_t messageType; // type of message
+} __attribute__((__packed__));
+static_assert(sizeof(CancelAll) == 2, "The CancelAll size is not correct!");
+
+/**
+ * @brief Payload packet for the CancelByListing type of request. This request
+ * aims to cancel every resting order of the trader for a single financial
+ * instrument in a single round trip.
+ */
+struct CancelByListing {
+  static constexpr uint16_t MESSAGE_TYPE = 7;
+  uint16_t messageType; // type of message
+  uint64_t listingId;   // instrument id whose orders should be cancelled
+} __attribute__((__packed__));
+static_assert(sizeof(CancelByListing) == 10,
+              "The CancelByListing size is not correct!");
+
+/**
+ * @brief Payload packet for the MassCancelResponse type of message. This
+ * message will be sent to the client in response to a CancelAll or
+ * CancelByListing request and reports how many orders were cancelled.
+ */
+struct MassCancelResponse {
+  static constexpr uint16_t MESSAGE_TYPE = 8;
+  uint16_t messageType;    // the type of the message
+  uint64_t listingId;      // the cancelled listing, 0 for CancelAll
+  uint64_t cancelledCount; // number of orders that were cancelled
+} __attribute__((__packed__));
+static_assert(sizeof(MassCancelResponse) == 18,
+              "The MassCancelResponse size is not correct!");
+
+/**
+ * @brief Payload packet for the Hello type of request. A client sends it in
+ * protocol version 1 to ask for a newer version of the wire format and must
+ * wait for the HelloResponse before switching.
+ */
+struct Hello {
+  static constexpr uint16_t MESSAGE_TYPE = 9;
+  uint16_t messageType; // type of message
+  uint16_t maxVersion;  // highest protocol version the client speaks
+} __attribute__((__packed__));
+static_assert(sizeof(Hello) == 4, "The Hello size is not correct!");
+
+/**
+ * @brief Payload packet for the HelloResponse type of message. It is sent in
+ * protocol version 1 and carries the version both sides use from now on.
+ */
+struct HelloResponse {
+  static constexpr uint16_t MESSAGE_TYPE = 10;
+  uint16_t messageType; // the type of the message
+  uint16_t version;     // the negotiated protocol version
+} __attribute__((__packed__));
+static_assert(sizeof(HelloResponse) == 4,
+              "The HelloResponse size is not correct!");
+
+static constexpr uint16_t PRECHECK_MAX_ORDERS = 16; // orders of a PreCheck
+
+/**
+ * @brief A hypothetical order of a PreCheck request. It carries the fields of
+ * a NewOrder that the risk checks look at.
+ */
+struct PreCheckOrder {
+  uint64_t listingId;     // instrument id
+  uint64_t orderQuantity; // quantity of the order
+  uint64_t orderPrice;    // price of the order with 4 implicit decimals
+  char side;              // 'B' for BUY, 'S' for SELL
+} __attribute__((__packed__));
+static_assert(sizeof(PreCheckOrder) == 25,
+              "The PreCheckOrder size is not correct!");
+
+/**
+ * @brief Payload packet for the PreCheck type of request. It asks which of up
+ * to PRECHECK_MAX_ORDERS candidate orders would pass the risk checks right
+ * now, without placing any of them. The frame always carries every slot,
+ * only the first count are evaluated.
+ */
+struct PreCheck {
+  static constexpr uint16_t MESSAGE_TYPE = 11;
+  uint16_t messageType; // type of message
+  uint16_t count;       // number of candidate orders used
+  uint64_t requestId;   // echoed in the response
+  PreCheckOrder orders[PRECHECK_MAX_ORDERS];
+} __attribute__((__packed__));
+static_assert(sizeof(PreCheck) == 412, "The PreCheck size is not correct!");
+
+/**
+ * @brief Payload packet for the PreCheckResponse type of message. Bit i of
+ * passed is set if candidate i of the PreCheck would have been accepted.
+ */
+struct PreCheckResponse {
+  static constexpr uint16_t MESSAGE_TYPE = 12;
+  uint16_t messageType; // the type of the message
+  uint16_t count;       // number of candidate orders evaluated
+  uint64_t requestId;   // the id of the PreCheck
+  uint16_t passed;      // bitmap of the candidates that pass
+} __attribute__((__packed__));
+static_assert(sizeof(PreCheckResponse) == 14,
+              "The PreCheckResponse size is not correct!");
+static_assert(PRECHECK_MAX_ORDERS <= 16, "The passed bitmap is too small!");
+
 template <typename T>
 using remove_cv_ref_ptr = typename std::remove_cv<typename std::remove_pointer<
     typename std::remove_reference<T>::type>::type>::type;
@@ -115,9 +226,40 @@ concept Sendable = requires {
       std::is_same_v<remove_cv_ref_ptr<T>, DeleteOrder> ||
       std::is_same_v<remove_cv_ref_ptr<T>, ModifyOrderQuantity> ||
       std::is_same_v<remove_cv_ref_ptr<T>, Trade> ||
-      std::is_same_v<remove_cv_ref_ptr<T>, OrderResponse>;
+      std::is_same_v<remove_cv_ref_ptr<T>, OrderResponse> ||
+      std::is_same_v<remove_cv_ref_ptr<T>, CancelAll> ||
+      std::is_same_v<remove_cv_ref_ptr<T>, CancelByListing> ||
+      std::is_same_v<remove_cv_ref_ptr<T>, MassCancelResponse> ||
+      std::is_same_v<remove_cv_ref_ptr<T>, Hello> ||
+      std::is_same_v<remove_cv_ref_ptr<T>, HelloResponse> ||
+      std::is_same_v<remove_cv_ref_ptr<T>, PreCheck> ||
+      std::is_same_v<remove_cv_ref_ptr<T>, PreCheckResponse>;
 };
 
+/**
+ * @brief A list of types, used to generate tables at compile time.
+ */
+template <typename... Ts> struct TypeList {};
+
+/**
+ * @brief Every request a client can send. The server generates its dispatch
+ * table from this list, so a new request type only has to be added here and
+ * given a handler.
+ */
+using RequestTypes = TypeList<NewOrder, DeleteOrder, ModifyOrderQuantity,
+                              Trade, CancelAll, CancelByListing, Hello,
+                              PreCheck>;
+
+/// Highest message type of a list of payload types
+template <typename... Ts>
+constexpr uint16_t max_message_type(TypeList<Ts...>) noexcept {
+  uint16_t max = 0;
+  ((max = Ts::MESSAGE_TYPE > max ? Ts::MESSAGE_TYPE : max), ...);
+  return max;
+}
+
+static constexpr uint16_t MAX_REQUEST_TYPE = max_message_type(RequestTypes{});
+
 template <Sendable T> struct Message {
   Header header;
   T data;
@@ -131,6 +273,13 @@ template <> void serialize<DeleteOrder>(DeleteOrder &order);
 template <> void serialize<ModifyOrderQuantity>(ModifyOrderQuantity &order);
 template <> void serialize<Trade>(Trade &trade);
 template <> void serialize<OrderResponse>(OrderResponse &response);
+template <> void serialize<CancelAll>(CancelAll &cancel);
+template <> void serialize<CancelByListing>(CancelByListing &cancel);
+template <> void serialize<MassCancelResponse>(MassCancelResponse &response);
+template <> void serialize<Hello>(Hello &hello);
+template <> void serialize<HelloResponse>(HelloResponse &response);
+template <> void serialize<PreCheck>(PreCheck &check);
+template <> void serialize<PreCheckResponse>(PreCheckResponse &response);
 template <Sendable T> void serialize(Message<T> &);
 
 // Deserialization of orders
@@ -141,6 +290,13 @@ template <> void deserialize<DeleteOrder>(DeleteOrder &order);
 template <> void deserialize<ModifyOrderQuantity>(ModifyOrderQuantity &order);
 template <> void deserialize<Trade>(Trade &trade);
 template <> void deserialize<OrderResponse>(OrderResponse &response);
+template <> void deserialize<CancelAll>(CancelAll &cancel);
+template <> void deserialize<CancelByListing>(CancelByListing &cancel);
+template <> void deserialize<MassCancelResponse>(MassCancelResponse &response);
+template <> void deserialize<Hello>(Hello &hello);
+template <> void deserialize<HelloResponse>(HelloResponse &response);
+template <> void deserialize<PreCheck>(PreCheck &check);
+template <> void deserialize<PreCheckResponse>(PreCheckResponse &response);
 template <Sendable T> void deserialize(Message<T> &);
 
 std::ostream &operator<<(std::ostream &out, Header const &h);
@@ -149,9 +305,17 @@ std::ostream &operator<<(std::ostream &out, DeleteOrder const &h);
 std::ostream &operator<<(std::ostream &out, ModifyOrderQuantity const &h);
 std::ostream &operator<<(std::ostream &out, Trade const &h);
 std::ostream &operator<<(std::ostream &out, OrderResponse const &h);
+std::ostream &operator<<(std::ostream &out, CancelAll const &h);
+std::ostream &operator<<(std::ostream &out, CancelByListing const &h);
+std::ostream &operator<<(std::ostream &out, MassCancelResponse const &h);
+std::ostream &operator<<(std::ostream &out, Hello const &h);
+std::ostream &operator<<(std::ostream &out, HelloResponse const &h);
+std::ostream &operator<<(std::ostream &out, PreCheck const &h);
+std::ostream &operator<<(std::ostream &out, PreCheckResponse const &h);
 
 template <Sendable T, size_t N>
-Message<T> create_msg_from_type(std::array<char, N> const &buf, size_t nbytes);
+Message<T> create_msg_from_type(std::array<char, N> const &buf, size_t nbytes,
+                                size_t offset = 0);
 
 template <Sendable T>
 std::ostream &operator<<(std::ostream &out, Message<T> const &msg);
@@ -162,6 +326,13 @@ static constexpr size_t MODO_MSG_SIZE =
     sizeof(Header) + sizeof(ModifyOrderQuantity);
 static constexpr size_t TRO_MSG_SIZE = sizeof(Header) + sizeof(Trade);
 static constexpr size_t ORDR_MSG_SIZE = sizeof(Header) + sizeof(OrderResponse);
+static constexpr size_t CALL_MSG_SIZE = sizeof(Header) + sizeof(CancelAll);
+static constexpr size_t CLST_MSG_SIZE =
+    sizeof(Header) + sizeof(CancelByListing);
+static constexpr size_t MCRS_MSG_SIZE =
+    sizeof(Header) + sizeof(MassCancelResponse);
+static constexpr size_t HELO_MSG_SIZE = sizeof(Header) + sizeof(Hello);
+static constexpr size_t HLRS_MSG_SIZE = sizeof(Header) + sizeof(HelloResponse);
 
 #include "orders.inl"
 
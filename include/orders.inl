@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 
 template <Sendable T> inline void serialize(T &) {}
@@ -46,6 +47,51 @@ template <> inline void serialize<OrderResponse>(OrderResponse &response) {
   response.status = static_cast<OrderResponse::Status>(casted);
 }
 
+template <> inline void serialize<CancelAll>(CancelAll &cancel) {
+  SERIALIZE_16(cancel.messageType);
+}
+
+template <> inline void serialize<CancelByListing>(CancelByListing &cancel) {
+  SERIALIZE_16(cancel.messageType);
+  SERIALIZE_64(cancel.listingId);
+}
+
+template <>
+inline void serialize<MassCancelResponse>(MassCancelResponse &response) {
+  SERIALIZE_16(response.messageType);
+  SERIALIZE_64(response.listingId);
+  SERIALIZE_64(response.cancelledCount);
+}
+
+template <> inline void serialize<Hello>(Hello &hello) {
+  SERIALIZE_16(hello.messageType);
+  SERIALIZE_16(hello.maxVersion);
+}
+
+template <> inline void serialize<HelloResponse>(HelloResponse &response) {
+  SERIALIZE_16(response.messageType);
+  SERIALIZE_16(response.version);
+}
+
+template <> inline void serialize<PreCheck>(PreCheck &check) {
+  SERIALIZE_16(check.messageType);
+  SERIALIZE_16(check.count);
+  SERIALIZE_64(check.requestId);
+  for (PreCheckOrder &order : check.orders) {
+    SERIALIZE_64(order.listingId);
+    SERIALIZE_64(order.orderQuantity);
+    SERIALIZE_64(order.orderPrice);
+  }
+}
+
+template <>
+inline void serialize<PreCheckResponse>(PreCheckResponse &response) {
+  SERIALIZE_16(response.messageType);
+  SERIALIZE_16(response.count);
+  SERIALIZE_64(response.requestId);
+  SERIALIZE_16(response.passed);
+}
+
 template <Sendable T> inline void serialize(Message<T> &msg) {
   serialize(msg.header);
   serialize(msg.data);
@@ -96,6 +142,51 @@ template <> inline void deserialize<OrderResponse>(OrderResponse &response) {
   response.status = static_cast<OrderResponse::Status>(status);
 }
 
+template <> inline void deserialize<CancelAll>(CancelAll &cancel) {
+  DESERIALIZE_16(cancel.messageType);
+}
+
+template <> inline void deserialize<CancelByListing>(CancelByListing &cancel) {
+  DESERIALIZE_16(cancel.messageType);
+  DESERIALIZE_64(cancel.listingId);
+}
+
+template <>
+inline void deserialize<MassCancelResponse>(MassCancelResponse &response) {
+  DESERIALIZE_16(response.messageType);
+  DESERIALIZE_64(response.listingId);
+  DESERIALIZE_64(response.cancelledCount);
+}
+
+template <> inline void deserialize<Hello>(Hello &hello) {
+  DESERIALIZE_16(hello.messageType);
+  DESERIALIZE_16(hello.maxVersion);
+}
+
+template <> inline void deserialize<HelloResponse>(HelloResponse &response) {
+  DESERIALIZE_16(response.messageType);
+  DESERIALIZE_16(response.version);
+}
+
+template <> inline void deserialize<PreCheck>(PreCheck &check) {
+  DESERIALIZE_16(check.messageType);
+  DESERIALIZE_16(check.count);
+  DESERIALIZE_64(check.requestId);
+  for (PreCheckOrder &order : check.orders) {
+    DESERIALIZE_64(order.listingId);
+    DESERIALIZE_64(order.orderQuantity);
+    DESERIALIZE_64(order.orderPrice);
+  }
+}
+
+template <>
+inline void deserialize<PreCheckResponse>(PreCheckResponse &response) {
+  DESERIALIZE_16(response.messageType);
+  DESERIALIZE_16(response.count);
+  DESERIALIZE_64(response.requestId);
+  DESERIALIZE_16(response.passed);
+}
+
 template <Sendable T> inline void deserialize(Message<T> &msg) {
   deserialize(msg.header);
   deserialize(msg.data);
@@ -108,9 +199,11 @@ std::ostream &operator<<(std::ostream &out, Message<T> const &msg) {
 }
 
 template <Sendable T, size_t N>
-Message<T> create_msg_from_type(std::array<char, N> const &buf, size_t nbytes) {
+Message<T> create_msg_from_type(std::array<char, N> const &buf, size_t nbytes,
+                                size_t offset) {
   Message<T> msg;
   std::memset(&msg, 0, sizeof(Message<T>));
-  std::memcpy(&msg, buf.data(), nbytes);
+  std::memcpy(&msg, buf.data() + offset,
+              std::min(nbytes, sizeof(Message<T>)));
   return msg;
 }
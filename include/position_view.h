@@ -0,0 +1,231 @@
+#ifndef POSITION_VIEW_INCLUDED_H
+#define POSITION_VIEW_INCLUDED_H
+
+#include "server_util.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// "RISKVIEW" in little endian, identifies the file
+static constexpr uint64_t POSITION_VIEW_MAGIC = 0x574549564B534952;
+static constexpr uint32_t POSITION_VIEW_VERSION = 1;
+
+/**
+ * @brief Position of a product, or exposure of a trader, as published in the
+ * shared view. Trader records leave the quantities at 0.
+ */
+struct PositionRecord {
+  uint64_t Id{0};      // product id or trader id, 0 marks a free trader slot
+  int64_t NetPos{0};   // filled net position of the product
+  uint64_t BuyQty{0};  // resting buy quantity of the product
+  uint64_t SellQty{0}; // resting sell quantity of the product
+  NotionalExposure Exposure{};
+};
+
+/**
+ * @brief A seqlock protected record on its own cache line. The single writer
+ * makes the sequence odd while it copies the record in, readers retry until
+ * they see the same even sequence before and after copying it out. Every
+ * field is accessed atomically so neither side ever blocks or races.
+ */
+struct alignas(64) PositionSlot {
+  std::atomic<uint64_t> Seq{0};
+  PositionRecord Record{};
+
+  /// Publish a new record, must only be called by the writer
+  void store(PositionRecord const &record) noexcept {
+    uint64_t seq = Seq.load(std::memory_order_relaxed);
+    Seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    copy_relaxed(record, Record);
+    Seq.store(seq + 2, std::memory_order_release);
+  }
+
+  /**
+   * @brief Try to copy out a consistent record.
+   * @return false if the writer was updating the slot, the copy is torn
+   */
+  bool try_load(PositionRecord &record) const noexcept {
+    uint64_t seq = Seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+      return false;
+    }
+    copy_relaxed(Record, record);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return Seq.load(std::memory_order_relaxed) == seq;
+  }
+
+private:
+  template <typename T>
+  static void relaxed(T const &from, T &to) noexcept {
+    __atomic_store_n(&to, __atomic_load_n(&from, __ATOMIC_RELAXED),
+                     __ATOMIC_RELAXED);
+  }
+
+  static void copy_relaxed(PositionRecord const &from,
+                           PositionRecord &to) noexcept {
+    relaxed(from.Id, to.Id);
+    relaxed(from.NetPos, to.NetPos);
+    relaxed(from.BuyQty, to.BuyQty);
+    relaxed(from.SellQty, to.SellQty);
+    relaxed(from.Exposure.Buy, to.Exposure.Buy);
+    relaxed(from.Exposure.Sell, to.Exposure.Sell);
+    relaxed(from.Exposure.Pos, to.Exposure.Pos);
+  }
+};
+static_assert(sizeof(PositionSlot) == 64, "A slot must fill one cache line!");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Shared memory atomics must be lock free!");
+
+/**
+ * @brief Start of the mapped file, followed by the product slots and then the
+ * trader slots. Slots are handed out in order, readers only scan the first
+ * ProductCount and TraderCount of them.
+ */
+struct alignas(64) PositionViewHeader {
+  std::atomic<uint64_t> Magic{0}; // set last, once the layout is initialized
+  uint32_t Version{POSITION_VIEW_VERSION};
+  uint32_t ProductSlots{0};
+  uint32_t TraderSlots{0};
+  std::atomic<uint32_t> ProductCount{0}; // product slots in use
+  std::atomic<uint32_t> TraderCount{0};  // trader slots ever used
+  std::atomic<uint32_t> Dropped{0};      // updates that found no free slot
+};
+
+/**
+ * @brief Writer side of the shared position view. The event loop mirrors
+ * every committed product and trader change into a memory mapped file, which
+ * costs one seqlock store and no syscall. Without create() the view stays
+ * disabled and every call returns immediately.
+ */
+class PositionView {
+  PositionViewHeader *m_header;
+  PositionSlot *m_products;
+  PositionSlot *m_traders;
+  size_t m_mapSize;
+  std::vector<uint32_t> m_freeTraders; // released trader slots
+
+public:
+  PositionView();
+  ~PositionView();
+  PositionView(PositionView const &) = delete;
+  PositionView &operator=(PositionView const &) = delete;
+
+  /**
+   * @brief Create the file, size it for the given number of slots and map it.
+   * An existing file is replaced.
+   * @return false if the file could not be created or mapped
+   */
+  bool create(std::string const &path, uint32_t productSlots,
+              uint32_t traderSlots);
+
+  /**
+   * @brief Mirror the state of a product. A slot is assigned on first use and
+   * remembered in the product.
+   * @param productId - the id of the product
+   * @param prod - the product, as stored in the product map
+   */
+  inline void publish_product(uint64_t productId, ProductInfo &prod) noexcept {
+    if (m_header == nullptr) {
+      return;
+    }
+    if (prod.ViewSlot == NO_VIEW_SLOT) {
+      add_product(productId, prod);
+      return;
+    }
+    m_products[prod.ViewSlot].store(product_record(productId, prod));
+  }
+
+  /**
+   * @brief Mirror the exposure of a trader. A slot is assigned on first use.
+   * @param slot - the slot of the trader, NO_VIEW_SLOT before the first call
+   * @param traderId - the id of the trader
+   * @param exposure - the notional exposure of the trader
+   */
+  inline void publish_trader(uint32_t &slot, uint32_t traderId,
+                             NotionalExposure const &exposure) noexcept {
+    if (m_header == nullptr) {
+      return;
+    }
+    if (slot == NO_VIEW_SLOT && !assign_trader(slot)) {
+      return;
+    }
+    m_traders[slot].store(PositionRecord{traderId, 0, 0, 0, exposure});
+  }
+
+  /**
+   * @brief Clear the slot of a disconnected trader so it can be reused.
+   * @param slot - the slot of the trader, NO_VIEW_SLOT is ignored
+   */
+  void release_trader(uint32_t slot) noexcept;
+
+private:
+  /// Assign the next free slot to a product and publish its first record
+  void add_product(uint64_t productId, ProductInfo &prod) noexcept;
+
+  /// Assign a released or the next free slot to a trader
+  bool assign_trader(uint32_t &slot) noexcept;
+
+  static inline PositionRecord product_record(uint64_t productId,
+                                              ProductInfo const &prod) noexcept {
+    return PositionRecord{productId, prod.NetPos, prod.BuyQty, prod.SellQty,
+                          prod.Exposure};
+  }
+};
+
+/**
+ * @brief Read only mapping of a position view published by a running server.
+ * Reads never make a syscall and never block the server.
+ */
+class PositionViewReader {
+  void *m_base;
+  size_t m_mapSize;
+  PositionViewHeader const *m_header;
+  PositionSlot const *m_products;
+  PositionSlot const *m_traders;
+
+public:
+  PositionViewReader();
+  ~PositionViewReader();
+  PositionViewReader(PositionViewReader const &) = delete;
+  PositionViewReader &operator=(PositionViewReader const &) = delete;
+
+  /**
+   * @brief Map the file published by the server.
+   * @return false if the file is missing or not a position view
+   */
+  bool open(std::string const &path);
+
+  /// Number of products published so far
+  [[nodiscard]] uint32_t product_count() const noexcept;
+
+  /// Number of trader slots to scan, free slots have a trader id of 0
+  [[nodiscard]] uint32_t trader_count() const noexcept;
+
+  /// Number of updates the server dropped because the view was full
+  [[nodiscard]] uint32_t dropped() const noexcept;
+
+  /**
+   * @brief Consistent copy of a product record.
+   * @param index - index below product_count()
+   * @return the record, or empty if the writer kept the slot busy
+   */
+  [[nodiscard]] std::optional<PositionRecord>
+  product(uint32_t index) const noexcept;
+
+  /**
+   * @brief Consistent copy of a trader record.
+   * @param index - index below trader_count()
+   * @return the record, or empty if the writer kept the slot busy
+   */
+  [[nodiscard]] std::optional<PositionRecord>
+  trader(uint32_t index) const noexcept;
+
+private:
+  static std::optional<PositionRecord> load(PositionSlot const &slot) noexcept;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PRECHECK_INCLUDED_H
+#define PRECHECK_INCLUDED_H
+
+#include "fixed_point.h"
+#include "limit_tree.h"
+#include "risk_context.h"
+#include "server_util.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief A hypothetical new order, the fields of a NewOrder the risk checks
+ * look at.
+ */
+struct WhatIfOrder {
+  uint64_t ListingId{0};
+  uint64_t Quantity{0};
+  Price OrderPrice{0}; // 4 implicit decimals
+  char Side{'B'};      // 'B' for BUY, 'S' for SELL
+};
+
+/// Words of the pass bitmap needed for a batch of orders
+constexpr size_t precheck_words(size_t orders) noexcept {
+  return (orders + 63) / 64;
+}
+
+/**
+ * @brief Evaluate a batch of hypothetical new orders against the current
+ * headroom of the products, of their groups and of the trader, without
+ * changing any state.
+ * Every order is checked on its own, as if it were the only one sent next,
+ * with exactly the checks a NewOrder goes through. The batch is processed in
+ * blocks of 64: the product state and the group of each order of a block are
+ * gathered first, then all of its orders are evaluated in one pass without
+ * hash lookups. A listing that is not in the product table has no state yet
+ * and is not added to it.
+ * @param info - the limits
+ * @param products - the current product state
+ * @param groups - the group limits and their current aggregates
+ * @param trader - the current notional exposure of the trader
+ * @param orders - the candidate orders
+ * @param passed - bit i is set if order i would be accepted, must hold
+ * precheck_words(orders.size()) words
+ */
+void precheck_orders(ServerInfo const &info, ProductTable const &products,
+                     LimitTree const &groups, NotionalExposure const &trader,
+                     std::span<WhatIfOrder const> orders,
+                     std::span<uint64_t> passed);
+
+#endif
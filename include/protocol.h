@@ -0,0 +1,244 @@
+#ifndef PROTOCOL_INCLUDED_H
+#define PROTOCOL_INCLUDED_H
+
+#include "orders.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+static constexpr uint16_t PROTOCOL_V1 = 1; // big endian, packed payloads
+static constexpr uint16_t PROTOCOL_V2 = 2; // little endian, aligned payloads
+static constexpr uint16_t PROTOCOL_MAX = PROTOCOL_V2;
+
+/**
+ * @brief Version 2 layout of a payload. Fields are little endian, so on our
+ * x86 hosts they are used as they are, and naturally aligned. Every payload
+ * is a multiple of 8 bytes so back to back frames stay aligned as well. The
+ * header keeps its version 1 layout, which is already aligned, but is little
+ * endian too. Payloads without a version 2 layout, like Hello, can only be
+ * sent in version 1.
+ */
+template <Sendable T> struct NativeWire;
+
+template <> struct NativeWire<NewOrder> {
+  uint16_t messageType;
+  char side;
+  uint8_t reserved[5];
+  uint64_t listingId;
+  uint64_t orderId;
+  uint64_t orderQuantity;
+  uint64_t orderPrice;
+};
+static_assert(sizeof(NativeWire<NewOrder>) == 40,
+              "The v2 NewOrder size is not correct!");
+
+template <> struct NativeWire<DeleteOrder> {
+  uint16_t messageType;
+  uint8_t reserved[6];
+  uint64_t orderId;
+};
+static_assert(sizeof(NativeWire<DeleteOrder>) == 16,
+              "The v2 DeleteOrder size is not correct!");
+
+template <> struct NativeWire<ModifyOrderQuantity> {
+  uint16_t messageType;
+  uint8_t reserved[6];
+  uint64_t orderId;
+  uint64_t newQuantity;
+};
+static_assert(sizeof(NativeWire<ModifyOrderQuantity>) == 24,
+              "The v2 ModifyOrderQuantity size is not correct!");
+
+template <> struct NativeWire<Trade> {
+  uint16_t messageType;
+  uint8_t reserved[6];
+  uint64_t listingId;
+  uint64_t tradeId;
+  uint64_t tradeQuantity;
+  uint64_t tradePrice;
+};
+static_assert(sizeof(NativeWire<Trade>) == 40,
+              "The v2 Trade size is not correct!");
+
+template <> struct NativeWire<OrderResponse> {
+  uint16_t messageType;
+  uint16_t status;
+  uint8_t reserved[4];
+  uint64_t orderId;
+};
+static_assert(sizeof(NativeWire<OrderResponse>) == 16,
+              "The v2 OrderResponse size is not correct!");
+
+template <> struct NativeWire<CancelAll> {
+  uint16_t messageType;
+  uint8_t reserved[6];
+};
+static_assert(sizeof(NativeWire<CancelAll>) == 8,
+              "The v2 CancelAll size is not correct!");
+
+template <> struct NativeWire<CancelByListing> {
+  uint16_t messageType;
+  uint8_t reserved[6];
+  uint64_t listingId;
+};
+static_assert(sizeof(NativeWire<CancelByListing>) == 16,
+              "The v2 CancelByListing size is not correct!");
+
+template <> struct NativeWire<MassCancelResponse> {
+  uint16_t messageType;
+  uint8_t reserved[6];
+  uint64_t listingId;
+  uint64_t cancelledCount;
+};
+static_assert(sizeof(NativeWire<MassCancelResponse>) == 24,
+              "The v2 MassCancelResponse size is not correct!");
+
+template <> struct NativeWire<PreCheck> {
+  struct Entry {
+    uint64_t listingId;
+    uint64_t orderQuantity;
+    uint64_t orderPrice;
+    char side;
+    uint8_t reserved[7];
+  };
+
+  uint16_t messageType;
+  uint16_t count;
+  uint8_t reserved[4];
+  uint64_t requestId;
+  Entry orders[PRECHECK_MAX_ORDERS];
+};
+static_assert(sizeof(NativeWire<PreCheck>) == 16 + 32 * PRECHECK_MAX_ORDERS,
+              "The v2 PreCheck size is not correct!");
+
+template <> struct NativeWire<PreCheckResponse> {
+  uint16_t messageType;
+  uint16_t count;
+  uint16_t passed;
+  uint8_t reserved[2];
+  uint64_t requestId;
+};
+static_assert(sizeof(NativeWire<PreCheckResponse>) == 16,
+              "The v2 PreCheckResponse size is not correct!");
+
+/// True if the payload can be sent in protocol version 2
+template <typename T>
+concept HasNativeWire = requires { sizeof(NativeWire<T>); };
+
+// Conversion between the version 2 layouts and the host structs. The le*toh
+// and htole* calls compile to nothing on little endian hosts.
+void from_native(NativeWire<NewOrder> const &in, NewOrder &out);
+void from_native(NativeWire<DeleteOrder> const &in, DeleteOrder &out);
+void from_native(NativeWire<ModifyOrderQuantity> const &in,
+                 ModifyOrderQuantity &out);
+void from_native(NativeWire<Trade> const &in, Trade &out);
+void from_native(NativeWire<OrderResponse> const &in, OrderResponse &out);
+void from_native(NativeWire<CancelAll> const &in, CancelAll &out);
+void from_native(NativeWire<CancelByListing> const &in, CancelByListing &out);
+void from_native(NativeWire<MassCancelResponse> const &in,
+                 MassCancelResponse &out);
+void from_native(NativeWire<PreCheck> const &in, PreCheck &out);
+void from_native(NativeWire<PreCheckResponse> const &in,
+                 PreCheckResponse &out);
+
+void to_native(NewOrder const &in, NativeWire<NewOrder> &out);
+void to_native(DeleteOrder const &in, NativeWire<DeleteOrder> &out);
+void to_native(ModifyOrderQuantity const &in,
+               NativeWire<ModifyOrderQuantity> &out);
+void to_native(Trade const &in, NativeWire<Trade> &out);
+void to_native(OrderResponse const &in, NativeWire<OrderResponse> &out);
+void to_native(CancelAll const &in, NativeWire<CancelAll> &out);
+void to_native(CancelByListing const &in, NativeWire<CancelByListing> &out);
+void to_native(MassCancelResponse const &in,
+               NativeWire<MassCancelResponse> &out);
+void to_native(PreCheck const &in, NativeWire<PreCheck> &out);
+void to_native(PreCheckResponse const &in,
+               NativeWire<PreCheckResponse> &out);
+
+/**
+ * @brief How a payload type travels in one protocol version. Frames are
+ * decoded into, and encoded from, the host Message<T> the handlers use.
+ */
+template <Sendable T> struct WireCodec {
+  size_t FrameSize{0}; // header plus payload, 0 if the version cannot carry T
+  void (*Decode)(char const *frame, Message<T> &msg){nullptr};
+  size_t (*Encode)(Message<T> const &msg, char *frame){nullptr};
+};
+
+/**
+ * @brief Read a 16 bit field of a frame header or payload.
+ * @param version - the protocol version of the frame
+ * @param field - start of the field in the received bytes
+ */
+[[nodiscard]] inline uint16_t load_u16(uint16_t version,
+                                       char const *field) noexcept {
+  uint16_t value = 0;
+  std::memcpy(&value, field, sizeof(value));
+  return version == PROTOCOL_V1 ? ntohs(value) : le16toh(value);
+}
+
+template <Sendable T> void decode_v1(char const *frame, Message<T> &msg) {
+  std::memcpy(&msg, frame, sizeof(Message<T>));
+  deserialize(msg);
+}
+
+template <Sendable T> size_t encode_v1(Message<T> const &msg, char *frame) {
+  Message<T> wire = msg;
+  serialize(wire);
+  std::memcpy(frame, &wire, sizeof(Message<T>));
+  return sizeof(Message<T>);
+}
+
+template <HasNativeWire T> void decode_v2(char const *frame, Message<T> &msg) {
+  Header header;
+  NativeWire<T> payload;
+  std::memcpy(&header, frame, sizeof(Header));
+  std::memcpy(&payload, frame + sizeof(Header), sizeof(payload));
+  msg.header.version = le16toh(header.version);
+  msg.header.payloadSize = le16toh(header.payloadSize);
+  msg.header.sequenceNumber = le32toh(header.sequenceNumber);
+  msg.header.timestamp = le64toh(header.timestamp);
+  from_native(payload, msg.data);
+}
+
+template <HasNativeWire T>
+size_t encode_v2(Message<T> const &msg, char *frame) {
+  Header header{.version = htole16(msg.header.version),
+                .payloadSize = htole16(msg.header.payloadSize),
+                .sequenceNumber = htole32(msg.header.sequenceNumber),
+                .timestamp = htole64(msg.header.timestamp)};
+  NativeWire<T> payload;
+  to_native(msg.data, payload);
+  std::memcpy(frame, &header, sizeof(Header));
+  std::memcpy(frame + sizeof(Header), &payload, sizeof(payload));
+  return sizeof(Header) + sizeof(payload);
+}
+
+/**
+ * @brief Codecs of T indexed by Header.version, built at compile time. Index
+ * 0 and the versions that cannot carry T have an empty entry.
+ */
+template <Sendable T>
+inline constexpr std::array<WireCodec<T>, PROTOCOL_MAX + 1> WIRE_CODECS = [] {
+  std::array<WireCodec<T>, PROTOCOL_MAX + 1> codecs{};
+  codecs[PROTOCOL_V1] = {sizeof(Message<T>), &decode_v1<T>, &encode_v1<T>};
+  if constexpr (HasNativeWire<T>) {
+    codecs[PROTOCOL_V2] = {sizeof(Header) + sizeof(NativeWire<T>),
+                           &decode_v2<T>, &encode_v2<T>};
+  }
+  return codecs;
+}();
+
+/// Largest frame of T in any version
+template <Sendable T> constexpr size_t max_frame_size() {
+  size_t size = 0;
+  for (WireCodec<T> const &codec : WIRE_CODECS<T>) {
+    size = std::max(size, codec.FrameSize);
+  }
+  return size;
+}
+
+#include "protocol.inl"
+
+#endif
@@ -0,0 +1,155 @@
+inline void from_native(NativeWire<NewOrder> const &in, NewOrder &out) {
+  out.messageType = le16toh(in.messageType);
+  out.listingId = le64toh(in.listingId);
+  out.orderId = le64toh(in.orderId);
+  out.orderQuantity = le64toh(in.orderQuantity);
+  out.orderPrice = le64toh(in.orderPrice);
+  out.side = in.side;
+}
+
+inline void from_native(NativeWire<DeleteOrder> const &in, DeleteOrder &out) {
+  out.messageType = le16toh(in.messageType);
+  out.orderId = le64toh(in.orderId);
+}
+
+inline void from_native(NativeWire<ModifyOrderQuantity> const &in,
+                        ModifyOrderQuantity &out) {
+  out.messageType = le16toh(in.messageType);
+  out.orderId = le64toh(in.orderId);
+  out.newQuantity = le64toh(in.newQuantity);
+}
+
+inline void from_native(NativeWire<Trade> const &in, Trade &out) {
+  out.messageType = le16toh(in.messageType);
+  out.listingId = le64toh(in.listingId);
+  out.tradeId = le64toh(in.tradeId);
+  out.tradeQuantity = le64toh(in.tradeQuantity);
+  out.tradePrice = le64toh(in.tradePrice);
+}
+
+inline void from_native(NativeWire<OrderResponse> const &in,
+                        OrderResponse &out) {
+  out.messageType = le16toh(in.messageType);
+  out.orderId = le64toh(in.orderId);
+  out.status = static_cast<OrderResponse::Status>(le16toh(in.status));
+}
+
+inline void from_native(NativeWire<CancelAll> const &in, CancelAll &out) {
+  out.messageType = le16toh(in.messageType);
+}
+
+inline void from_native(NativeWire<CancelByListing> const &in,
+                        CancelByListing &out) {
+  out.messageType = le16toh(in.messageType);
+  out.listingId = le64toh(in.listingId);
+}
+
+inline void from_native(NativeWire<MassCancelResponse> const &in,
+                        MassCancelResponse &out) {
+  out.messageType = le16toh(in.messageType);
+  out.listingId = le64toh(in.listingId);
+  out.cancelledCount = le64toh(in.cancelledCount);
+}
+
+inline void from_native(NativeWire<PreCheck> const &in, PreCheck &out) {
+  out.messageType = le16toh(in.messageType);
+  out.count = le16toh(in.count);
+  out.requestId = le64toh(in.requestId);
+  for (uint16_t i = 0; i < PRECHECK_MAX_ORDERS; ++i) {
+    out.orders[i].listingId = le64toh(in.orders[i].listingId);
+    out.orders[i].orderQuantity = le64toh(in.orders[i].orderQuantity);
+    out.orders[i].orderPrice = le64toh(in.orders[i].orderPrice);
+    out.orders[i].side = in.orders[i].side;
+  }
+}
+
+inline void from_native(NativeWire<PreCheckResponse> const &in,
+                        PreCheckResponse &out) {
+  out.messageType = le16toh(in.messageType);
+  out.count = le16toh(in.count);
+  out.requestId = le64toh(in.requestId);
+  out.passed = le16toh(in.passed);
+}
+
+inline void to_native(NewOrder const &in, NativeWire<NewOrder> &out) {
+  out = NativeWire<NewOrder>{};
+  out.messageType = htole16(in.messageType);
+  out.side = in.side;
+  out.listingId = htole64(in.listingId);
+  out.orderId = htole64(in.orderId);
+  out.orderQuantity = htole64(in.orderQuantity);
+  out.orderPrice = htole64(in.orderPrice);
+}
+
+inline void to_native(DeleteOrder const &in, NativeWire<DeleteOrder> &out) {
+  out = NativeWire<DeleteOrder>{};
+  out.messageType = htole16(in.messageType);
+  out.orderId = htole64(in.orderId);
+}
+
+inline void to_native(ModifyOrderQuantity const &in,
+                      NativeWire<ModifyOrderQuantity> &out) {
+  out = NativeWire<ModifyOrderQuantity>{};
+  out.messageType = htole16(in.messageType);
+  out.orderId = htole64(in.orderId);
+  out.newQuantity = htole64(in.newQuantity);
+}
+
+inline void to_native(Trade const &in, NativeWire<Trade> &out) {
+  out = NativeWire<Trade>{};
+  out.messageType = htole16(in.messageType);
+  out.listingId = htole64(in.listingId);
+  out.tradeId = htole64(in.tradeId);
+  out.tradeQuantity = htole64(in.tradeQuantity);
+  out.tradePrice = htole64(in.tradePrice);
+}
+
+inline void to_native(OrderResponse const &in,
+                      NativeWire<OrderResponse> &out) {
+  out = NativeWire<OrderResponse>{};
+  out.messageType = htole16(in.messageType);
+  out.status = htole16(static_cast<uint16_t>(in.status));
+  out.orderId = htole64(in.orderId);
+}
+
+inline void to_native(CancelAll const &in, NativeWire<CancelAll> &out) {
+  out = NativeWire<CancelAll>{};
+  out.messageType = htole16(in.messageType);
+}
+
+inline void to_native(CancelByListing const &in,
+                      NativeWire<CancelByListing> &out) {
+  out = NativeWire<CancelByListing>{};
+  out.messageType = htole16(in.messageType);
+  out.listingId = htole64(in.listingId);
+}
+
+inline void to_native(MassCancelResponse const &in,
+                      NativeWire<MassCancelResponse> &out) {
+  out = NativeWire<MassCancelResponse>{};
+  out.messageType = htole16(in.messageType);
+  out.listingId = htole64(in.listingId);
+  out.cancelledCount = htole64(in.cancelledCount);
+}
+
+inline void to_native(PreCheck const &in, NativeWire<PreCheck> &out) {
+  out = NativeWire<PreCheck>{};
+  out.messageType = htole16(in.messageType);
+  out.count = htole16(in.count);
+  out.requestId = htole64(in.requestId);
+  for (uint16_t i = 0; i < PRECHECK_MAX_ORDERS; ++i) {
+    out.orders[i].listingId = htole64(in.orders[i].listingId);
+    out.orders[i].orderQuantity = htole64(in.orders[i].orderQuantity);
+    out.orders[i].orderPrice = htole64(in.orders[i].orderPrice);
+    out.orders[i].side = in.orders[i].side;
+  }
+}
+
+inline void to_native(PreCheckResponse const &in,
+                      NativeWire<PreCheckResponse> &out) {
+  out = NativeWire<PreCheckResponse>{};
+  out.messageType = htole16(in.messageType);
+  out.count = htole16(in.count);
+  out.passed = htole16(in.passed);
+  out.requestId = htole64(in.requestId);
+}
@@ -0,0 +1,118 @@
+#ifndef REPLAY_INCLUDED_H
+#define REPLAY_INCLUDED_H
+
+#include "order_journal.h"
+#include "server_util.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Per listing limits a replay evaluates, the alternatives of the
+ * --buy-limit and --sell-limit options of the server.
+ */
+struct ReplayLimits {
+  uint64_t BuyLimit{0};
+  uint64_t SellLimit{0};
+
+  /// True if the worst positions of the product break the limits, or its
+  /// notional overflowed like the server would reject
+  [[nodiscard]] constexpr bool
+  exceeds_limits(ProductInfo const &prod) const noexcept {
+    return !prod.Exposure.exact() || prod.MBuy > BuyLimit ||
+           prod.MSell > SellLimit;
+  }
+};
+
+/**
+ * @brief What a trader would have seen under one set of limits.
+ */
+struct TraderReplayStats {
+  uint64_t NewOrders{0};
+  uint64_t NewRejected{0};
+  uint64_t Modifies{0};
+  uint64_t ModifyRejected{0};
+  uint64_t Fills{0};
+  uint64_t FillsDropped{0}; // fills of orders that would not have rested
+
+  constexpr void merge(TraderReplayStats const &other) noexcept {
+    NewOrders += other.NewOrders;
+    NewRejected += other.NewRejected;
+    Modifies += other.Modifies;
+    ModifyRejected += other.ModifyRejected;
+    Fills += other.Fills;
+    FillsDropped += other.FillsDropped;
+  }
+};
+
+/**
+ * @brief Outcome of a whole log under one set of limits.
+ */
+struct ReplayResult {
+  ReplayLimits Limits{};
+  TraderReplayStats Total{};
+  std::map<uint32_t, TraderReplayStats> Traders{}; // ordered by trader id
+};
+
+/**
+ * @brief A request of the log reduced to what the risk checks of a single
+ * listing need. The listing is implied by the partition it was put in.
+ */
+struct ReplayEvent {
+  enum class Kind : uint8_t {
+    New,
+    Modify,
+    Delete,
+    Fill,         // a Trade of the trader, only for a resting order
+    ExchangeFill, // booked even if the order left the book meanwhile
+    CancelTrader  // every order of the trader on the listing goes away
+  };
+
+  Kind Type{Kind::New};
+  char Side{0};
+  uint32_t TraderId{0};
+  uint64_t OrderId{0};
+  uint64_t Quantity{0}; // order, new or traded quantity
+  uint64_t Price{0};    // order or trade price
+  uint64_t Rested{0};   // resting quantity an exchange fill released
+};
+
+/**
+ * @brief An order log split into one partition of events per listing, each
+ * in the order the server handled them.
+ */
+struct ReplayLog {
+  std::vector<uint64_t> Listings{};                  // listing of a partition
+  std::vector<std::vector<ReplayEvent>> Partitions{};
+  uint64_t Records{0}; // records read from the log
+  uint64_t Skipped{0}; // records that carry no risk or could not be decoded
+};
+
+/**
+ * @brief Read an order log written with --order-log and split it by listing.
+ * Deletes, modifies and fills are routed to the listing of the NewOrder that
+ * used their order id, mass cancels and session ends to every listing the
+ * trader had orders on.
+ * @param path - the order log
+ * @param log - receives the partitions
+ * @return false if the file cannot be read or is not an order log
+ */
+bool load_order_log(std::string const &path, ReplayLog &log);
+
+/**
+ * @brief Replay the log under every set of limits in one pass over the
+ * events. The listings are spread over the worker threads, which steal
+ * partitions from each other once their own are done. The per trader results
+ * are merged in partition order, so they do not depend on the threads.
+ * @param log - the partitioned log
+ * @param limits - the alternative limits to evaluate
+ * @param threads - number of worker threads
+ * @return one result per set of limits, in the same order
+ */
+std::vector<ReplayResult> replay_order_log(ReplayLog const &log,
+                                           std::vector<ReplayLimits> const
+                                               &limits,
+                                           unsigned threads);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef RISK_CONTEXT_INCLUDED_H
+#define RISK_CONTEXT_INCLUDED_H
+
+#include "drop_copy.h"
+#include "gateway.h"
+#include "limit_tree.h"
+#include "order_journal.h"
+#include "position_view.h"
+#include "server_util.h"
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+/// Product id -> aggregated state of the product
+using ProductTable = std::pmr::unordered_map<uint64_t, ProductInfo>;
+/// Listing id -> open position of one trader
+using PositionTable = std::pmr::unordered_map<uint64_t, ListingPosition>;
+
+/**
+ * @brief Everything a trader session needs from the engine: the limits, the
+ * product state shared by all traders, the group limit hierarchy, the sinks
+ * of committed changes and decisions, and the memory the sessions allocate
+ * their order tables from. The server builds one over its own resources.
+ * Tests and benchmarks can build one over plain containers, with an unmapped
+ * position view and a gateway, journal and drop copy that were never started.
+ */
+struct RiskContext {
+  ServerInfo &Info;
+  ProductTable &Products;
+  LimitTree &Groups;                    // group limits above the listings
+  std::vector<uint64_t> &DirtyProducts; // changed since the last snapshot
+  PositionView &Positions;              // live positions shared with monitors
+  ExchangeGateway &Gateway;             // forwards accepted orders
+  OrderJournal &Journal;                // records the handled frames
+  DropCopy &Copies;                     // copies every risk decision
+  std::pmr::memory_resource *Memory;    // backs the order tables
+
+  /**
+   * @brief Record that a product changed so the next snapshot tick publishes
+   * it. Constant time.
+   * @param productId - the id of the product
+   * @param prod - the product, as stored in the product map
+   */
+  inline void mark_dirty(uint64_t productId, ProductInfo &prod) {
+    if (!prod.Dirty) {
+      prod.Dirty = true;
+      DirtyProducts.push_back(productId);
+    }
+  }
+
+  /**
+   * @brief The state of a product, created on first use. The group of a
+   * listing is resolved once, when its product is created.
+   * @param productId - the id of the product
+   */
+  inline ProductInfo &product(uint64_t productId) {
+    auto [product_it, inserted] = Products.try_emplace(productId);
+    if (inserted) {
+      product_it->second.Group = Groups.group_of(productId);
+    }
+    return product_it->second;
+  }
+
+  /**
+   * @brief Commit the new state of a product after its limits were checked:
+   * store it, add its change to its groups and publish it.
+   * @param productId - the id of the product
+   * @param current - the product, as stored in the product map
+   * @param next - the new state of the product
+   * @param delta - the notional change of the product
+   * @param grossDelta - the change of the gross notional of the product
+   */
+  inline void commit(uint64_t productId, ProductInfo &current,
+                     ProductInfo const &next, NotionalExposure const &delta,
+                     Notional grossDelta) {
+    current = next;
+    Groups.apply(current.Group, delta, grossDelta);
+    mark_dirty(productId, current); // published on the next tick
+    Positions.publish_product(productId, current);
+  }
+};
+
+#endif
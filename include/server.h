@@ -1,10 +1,18 @@
 #ifndef SERVER_INCLUDED_H
 #define SERVER_INCLUDED_H
 
+#include "connection_table.h"
+#include "executor.h"
+#include "gateway.h"
+#include "hot_memory.h"
+#include "metrics.h"
+#include "position_view.h"
+#include "risk_context.h"
 #include "server_util.h"
+#include "snapshot.h"
+#include "timer_wheel.h"
 #include <arpa/inet.h>
 #include <array>
-#include <memory>
 #include <optional>
 #include <poll.h>
 #include <string>
@@ -13,22 +21,33 @@
 #include <unordered_map>
 #include <vector>
 
-class Connection;
-
 /**
  * @brief Holds the main server resources. These resources should be shared by
  * connections. Connections should perform operation on the product map when the
  * recieve a valid order.
  */
 struct ServerResources {
-  ServerResources()
-      : ListenerFd(INVALID_FD), Fds(), Connections(), ProductMap() {}
+  explicit ServerResources(std::pmr::memory_resource *memory)
+      : ListenerFd(INVALID_FD), NextTraderId(1), Fds(), Connections(),
+        ProductMap(memory), Groups(), DirtyProducts() {}
   int ListenerFd{INVALID_FD};
-  std::vector<pollfd> Fds; /// Vector of the active file descriptors
-  std::unordered_map<int, std::shared_ptr<Connection>>
-      Connections; /// Map of the connections
-  std::unordered_map<uint64_t, ProductInfo>
-      ProductMap; // Map of the products and their total positions
+  uint32_t NextTraderId{1};    /// Id handed to the next trader session
+  std::vector<pollfd> Fds;     /// Vector of the active file descriptors
+  ConnectionTable Connections; /// Connections indexed by their fd
+  ProductTable ProductMap; // Map of the products and their total positions
+  LimitTree Groups;        // Group limits and aggregates above the products
+  std::vector<uint64_t>
+      DirtyProducts; // Products changed since the last snapshot tick
+};
+
+/**
+ * @brief Payload of the timers of the event loop: the heartbeat deadline of a
+ * session or one of the periodic tasks.
+ */
+struct ServerTimer {
+  enum class Kind : uint8_t { Heartbeat, Snapshot, Recalibrate, ReloadLimits };
+  Kind Type{Kind::Heartbeat};
+  ConnectionHandle Session{}; // the session of a heartbeat
 };
 
 /**
@@ -38,14 +57,32 @@ struct ServerResources {
  */
 class Server final {
   using NameBuf = std::array<char, INET6_ADDRSTRLEN>;
+  static constexpr uint64_t TIMER_TICK_NS = 1000000; // resolution of timers
 
-  NameBuf m_clientName; // stores the hostname of the client
+  HotMemory m_hotMemory; // backs the hot tables, outlives them
+  NameBuf m_clientName;  // stores the hostname of the client
   ServerResources m_resources;
   ServerInfo m_info;
   struct sockaddr_storage
       m_clientAddr;    // stores the sockaddr_in or sockaddr_in6 of the client
   socklen_t m_sinSize; // stores the size of the sockaddr struct
 
+  MetricsEndpoint m_metrics;     // serves the metrics from its own thread
+  SnapshotPublisher m_snapshots; // writes the changed products periodically
+  PositionView m_positions;      // live positions shared with monitors
+  ExchangeGateway m_gateway;     // forwards accepted orders to the exchange
+  OrderJournal m_journal;        // handled frames for offline replay
+  DropCopy m_dropCopy;           // risk decisions for local subscribers
+  RiskContext m_context;         // what the sessions see of the server
+  TimerWheel<ServerTimer> m_timers; // heartbeats and periodic tasks
+  std::vector<ProductSnapshot> m_snapshotBatch; // reused between ticks
+  // trader id -> open positions of a trader that left, its fills may still
+  // be on their way from the exchange
+  std::unordered_map<uint32_t, PositionTable> m_departed;
+  int64_t m_limitsMtimeNs; // modification time of the loaded group limits
+  bool m_reloadPending;    // a reload of the group limits is in flight
+  Executor m_executor;     // slow path work, declared last so it stops first
+
 public:
   /**
    * @brief The function will create a TCP server on a given host and port. The
@@ -69,44 +106,122 @@ public:
    * there is an error the method will log it and exit the application.
    * Otherwise it will print that the server has started listening for
    * connections on port <port> and add the listener_fd to the set of fds.
+   * If a metrics port is configured the metrics endpoint is started as well,
+   * the snapshot publisher is always started and the position view is created
+   * when a file is configured. With an exchange configured the gateway is
+   * started and its fill eventfd joins the poll set. The completion eventfd
+   * of the slow path executor joins it too.
    */
   void listen();
 
   /**
    * @brief Starts running the server and polling for connections and reads from
    * the clients. The server will handle new clients by adding their fds to the
-   * vector or server existing ones when calling the poll method.
+   * vector or server existing ones when calling the poll method. Every
+   * connection is served at most FairBudget requests per iteration, requests
+   * adding risk go through the session token bucket and are shed while the
+   * server is overloaded (slow loop or too many buffered bytes). The due
+   * timers fire after every sweep and bound how long poll may block, the
+   * outputs are flushed after them on every iteration.
    */
   void run();
 
   /**
-   * @brief Deregister a connection from the server. The connection should be
-   * removed from the map of connections and we should also remove the pollfd
-   * associated with the connection.
+   * @brief Deregister a connection from the server. The state of the trader is
+   * discarded, the connection is removed from the connection table and the
+   * pollfd associated with the connection is disabled. Disabled pollfds are
+   * compacted at the end of the poll sweep. The socket is closed by the slow
+   * path executor.
+   * @param handle - the connection to deregister, stale handles are ignored
    */
-  void deregister_connection(std::shared_ptr<Connection> conn);
-
-  /// Reutrn a reference to the server products should be used only by
-  /// connections
-  [[nodiscard]] inline std::unordered_map<uint64_t, ProductInfo> &
-  get_products() noexcept {
-    return m_resources.ProductMap;
-  }
-
-  /// Return a reference to the server information should be used only by
-  /// connections
-  [[nodiscard]] inline ServerInfo &get_info() noexcept { return m_info; }
+  void deregister_connection(ConnectionHandle handle);
 
   /**
    * @brief Print the state of the risk server. This involves printing how many
    * assets we have and what are the current limits and positions for them.
+   * Costs O(number of products), the request path publishes the changed
+   * products through the snapshot publisher instead.
    */
   void print_system_state();
 
 private:
+  /**
+   * @brief Size the tables for the expected listings, traders and resting
+   * orders of the config and fault them in, so the first minutes of trading
+   * neither rehash nor take page faults. The order tables of the sessions
+   * are reserved when a trader connects, from the pre-faulted hot memory.
+   */
+  void reserve_capacity();
+
+  /**
+   * @brief Hand the products changed since the previous tick to the snapshot
+   * publisher and clear their dirty flags.
+   * @param nowNs - time of the tick
+   */
+  void publish_snapshot(uint64_t nowNs);
+
+  /**
+   * @brief Timeout of the next poll. Spin mode and requests left over by the
+   * fair budget make it non-blocking, otherwise it is bound by the next
+   * timer, and by a millisecond while the gateway holds orders back.
+   * @param pending - true if requests are still buffered
+   * @return the timeout in milliseconds, -1 to block
+   */
+  int poll_timeout_ms(bool pending) const;
+
+  /**
+   * @brief Fire the timers that are due: evict the sessions that missed
+   * their heartbeat and run the periodic tasks, which re-arm themselves.
+   * @param nowNs - current time
+   */
+  void fire_timers(uint64_t nowNs);
+
+  /**
+   * @brief Hand what the iteration queued to the gateway, journal and drop
+   * copy threads. Runs at the end of every loop iteration, after the timers,
+   * so the cancels and records of an eviction are not held back until the
+   * next request arrives.
+   */
+  void flush_outputs();
+
+  /**
+   * @brief Check the heartbeat of a session. A session that received
+   * nothing for HeartbeatMs is evicted and its trader state released,
+   * otherwise the timer is re-armed from its last request, so the wheel is
+   * not touched per message.
+   */
+  void check_heartbeat(ConnectionHandle handle, uint64_t nowNs);
+
+  /**
+   * @brief Check the group limits file on the slow path executor and load it
+   * if it changed. The new limits are installed by a completion on the event
+   * loop, only if the groups and their listings stayed the same.
+   */
+  void reload_group_limits();
+
+  /**
+   * @brief Hand the fills reported by the exchange to the sessions of their
+   * traders. Fills of traders that disconnected are booked by the server.
+   */
+  void apply_fills();
+
+  /**
+   * @brief Book a fill of a trader that disconnected into its position and
+   * the product, and journal and drop copy it like a session would. Its
+   * orders were cancelled with the session, so nothing rests any more.
+   */
+  void book_departed_fill(GatewayFill const &fill);
+
+  /**
+   * @brief Apply the low latency settings of the config to the thread that
+   * runs the event loop: core pinning, SCHED_FIFO and a pre-faulted stack.
+   */
+  void tune_event_loop_thread();
+
   /**
    * @brief Accept an incoming connection and return the new file descriptor.
-   * If an error occurs print it and return invalid FD.
+   * If an error occurs print it and return invalid FD, the listener is
+   * non-blocking so an empty accept queue returns invalid FD silently.
    * @return new fd for the connection or INVALID_FD
    */
   int accept_connection();
@@ -118,8 +233,8 @@ private:
   void print_new_connection();
 
   /**
-   * @brief Handle new incoming connection. The new connection will be included
-   * in the set of fds.
+   * @brief Handle new incoming connections, up to ACCEPT_BURST of them. The
+   * new connections will be included in the set of fds.
    */
   void handle_new_connection();
 
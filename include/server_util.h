@@ -1,47 +1,375 @@
 #ifndef SERVER_UTIL_INCLUDED_H
 #define SERVER_UTIL_INCLUDED_H
 
+#include "fixed_point.h"
+#include <algorithm>
 #include <cstdint>
+#include <limits>
 #include <ostream>
+#include <string>
 
 static constexpr size_t BACK_LOG = 20;
+/// Trader connections waiting to be accepted, capped by somaxconn
+static constexpr size_t SESSION_BACK_LOG = 4096;
+static constexpr int ACCEPT_BURST = 64; // connections accepted per wake up
 static constexpr int INVALID_FD = -1000;
-static constexpr int IMPLICIT_DEC = 10000;
+static constexpr uint32_t NO_VIEW_SLOT = UINT32_MAX; // not in the position view
+static constexpr uint32_t NO_GROUP = UINT32_MAX;     // listing outside any group
+/// Largest quantity a request may carry, the risk totals are signed 64 bit
+static constexpr uint64_t QUANTITY_MAX = std::numeric_limits<int64_t>::max();
+
+/**
+ * @brief Notional (price x quantity) exposure with 4 implicit decimals. Buy and
+ * Sell hold the notional of the resting orders, Pos the signed notional of the
+ * filled positions at their average opening price. All totals are maintained
+ * incrementally.
+ */
+struct NotionalExposure {
+  Notional Buy{0};
+  Notional Sell{0};
+  Notional Pos{0};
+
+  /// Resting notional of both sides plus the absolute position notional
+  [[nodiscard]] constexpr Notional gross() const noexcept {
+    return notional_add(notional_add(Buy, Sell), notional_abs(Pos));
+  }
+
+  /// Worst net notional if all buys or all sells were to be filled
+  [[nodiscard]] constexpr Notional net() const noexcept {
+    return std::max(notional_abs(notional_add(Pos, Buy)),
+                    notional_abs(notional_sub(Pos, Sell)));
+  }
+
+  /**
+   * @brief False if a total or the gross saturated. Such a state cannot be
+   * undone by removing the same delta again, the limit checks reject it so
+   * the committed totals stay exact. The net is bounded by the gross.
+   */
+  [[nodiscard]] constexpr bool exact() const noexcept {
+    __int128 pos = Pos;
+    __int128 gross = __int128{Buy} + Sell + (pos < 0 ? -pos : pos);
+    return gross < NOTIONAL_MAX;
+  }
+
+private:
+  [[nodiscard]] static constexpr Notional notional_abs(Notional v) noexcept {
+    return v < 0 ? notional_sub(0, v) : v;
+  }
+};
+
+static_assert(!NotionalExposure{.Buy = NOTIONAL_MAX, .Sell = 0, .Pos = 0}
+                   .exact(),
+              "a saturated total must be rejected");
+
+/**
+ * @brief Filled position of a trader in one listing. The position notional is
+ * the net quantity at the average price it was opened at, so closing the
+ * position at any price brings its notional back to exactly zero. The
+ * difference to the closing price is realized P&L, not exposure.
+ */
+struct ListingPosition {
+  int64_t NetPos{0};
+  Notional Cost{0}; // NetPos at the average opening price
+
+  /**
+   * @brief Book a fill, the quantity first closes the open position and the
+   * rest opens a new one at the trade price.
+   * @param quantity - the traded quantity, negative for a sell
+   * @param price - the trade price
+   * @return the change of the position notional
+   */
+  constexpr Notional book(int64_t quantity, Price price) noexcept {
+    Notional before = Cost;
+    if (NetPos != 0 && (NetPos > 0) != (quantity > 0)) {
+      uint64_t open = magnitude(NetPos);
+      uint64_t closed = std::min(open, magnitude(quantity));
+      // the closed share of the cost, all of it once the position is flat
+      Cost -= closed == open
+                  ? Cost
+                  : static_cast<Notional>(static_cast<__int128>(Cost) *
+                                          closed / open);
+      int64_t change = static_cast<int64_t>(closed);
+      change = NetPos > 0 ? -change : change;
+      NetPos += change;
+      quantity -= change;
+    }
+    if (quantity != 0) {
+      Notional opened = notional(price, magnitude(quantity));
+      Cost = notional_add(Cost, quantity > 0 ? opened : -opened);
+      NetPos += quantity;
+    }
+    return notional_sub(Cost, before);
+  }
+
+private:
+  [[nodiscard]] static constexpr uint64_t magnitude(int64_t v) noexcept {
+    return v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+  }
+};
+
+static_assert(
+    [] {
+      ListingPosition position; // a round trip at different prices
+      (void)position.book(10, 100 * IMPLICIT_DEC);
+      (void)position.book(-10, 110 * IMPLICIT_DEC);
+      return position.Cost == 0;
+    }(),
+    "a flat position must have no notional");
+
+/**
+ * @brief Change to the risk state caused by a single event (new order, modify,
+ * cancel or fill). The same delta is applied to the product totals and to the
+ * exposure of the trader.
+ */
+struct RiskDelta {
+  int64_t BuyQty{0};
+  int64_t SellQty{0};
+  int64_t NetPos{0};
+  NotionalExposure Exposure{};
+
+  /**
+   * @brief Delta of adding resting quantity at a price on a side. Use a
+   * negative sign to remove it. The quantity is at most QUANTITY_MAX.
+   */
+  [[nodiscard]] static constexpr RiskDelta resting(char side, uint64_t quantity,
+                                                   Price price,
+                                                   int sign) noexcept {
+    RiskDelta delta;
+    int64_t qty = sign * static_cast<int64_t>(quantity);
+    Notional value = sign * notional(price, quantity);
+    if (side == 'B') {
+      delta.BuyQty = qty;
+      delta.Exposure.Buy = value;
+    } else {
+      delta.SellQty = qty;
+      delta.Exposure.Sell = value;
+    }
+    return delta;
+  }
+
+  /**
+   * @brief The quantities a fill of a resting order moves, off the book and
+   * into the position, to check them with ProductInfo::fits before booking.
+   */
+  [[nodiscard]] static constexpr RiskDelta traded(char side,
+                                                  uint64_t quantity) noexcept {
+    RiskDelta delta = resting(side, quantity, 0, -1);
+    int64_t qty = static_cast<int64_t>(quantity);
+    delta.NetPos = side == 'B' ? qty : -qty;
+    return delta;
+  }
+
+  /**
+   * @brief Delta of a fill: the resting quantity at the order price leaves the
+   * book and the position moves by the traded quantity. The position notional
+   * follows the net position of the trader in the listing, not the sum of the
+   * traded notionals.
+   * @param rested - the part of the quantity that was still resting, less
+   * than quantity when the order was cancelled or reduced meanwhile
+   * @param position - the position of the trader in the listing, booked here
+   */
+  [[nodiscard]] static constexpr RiskDelta
+  fill(char side, uint64_t quantity, uint64_t rested, Price orderPrice,
+       Price tradePrice, ListingPosition &position) noexcept {
+    RiskDelta delta = resting(side, rested, orderPrice, -1);
+    int64_t qty = static_cast<int64_t>(quantity);
+    delta.NetPos = side == 'B' ? qty : -qty;
+    delta.Exposure.Pos = position.book(delta.NetPos, tradePrice);
+    return delta;
+  }
+};
+
+/**
+ * @brief Apply a delta to notional exposure totals.
+ */
+constexpr void apply_delta(NotionalExposure &exposure,
+                           NotionalExposure const &delta) noexcept {
+  exposure.Buy = notional_add(exposure.Buy, delta.Buy);
+  exposure.Sell = notional_add(exposure.Sell, delta.Sell);
+  exposure.Pos = notional_add(exposure.Pos, delta.Pos);
+}
 
 struct ProductInfo {
-  uint64_t NetPos{0};
+  int64_t NetPos{0};
   uint64_t BuyQty{0};
   uint64_t SellQty{0};
   uint64_t MBuy{0};
   uint64_t MSell{0};
+  NotionalExposure Exposure{};
+  uint32_t ViewSlot{NO_VIEW_SLOT}; // slot in the shared position view
+  uint32_t Group{NO_GROUP};        // group of the listing in the limit tree
+  bool Dirty{false};               // changed since the last snapshot tick
+
+  /**
+   * @brief Apply a risk delta and recompute the hypothetical worst positions.
+   */
+  constexpr void apply(RiskDelta const &delta) noexcept {
+    NetPos += delta.NetPos;
+    BuyQty += delta.BuyQty;
+    SellQty += delta.SellQty;
+    int64_t buy = static_cast<int64_t>(BuyQty);
+    int64_t sell = static_cast<int64_t>(SellQty);
+    MBuy = static_cast<uint64_t>(std::max(buy, buy + NetPos));
+    MSell = static_cast<uint64_t>(std::max(sell, sell - NetPos));
+    apply_delta(Exposure, delta.Exposure);
+  }
+
+  /**
+   * @brief False if the delta would take a quantity total or a worst position
+   * out of the signed 64 bit range they are computed in. Like an overflowing
+   * notional such a request is rejected, the totals never wrap.
+   */
+  [[nodiscard]] constexpr bool fits(RiskDelta const &delta) const noexcept {
+    constexpr __int128 MAX = std::numeric_limits<int64_t>::max();
+    __int128 buy = __int128{BuyQty} + delta.BuyQty;
+    __int128 sell = __int128{SellQty} + delta.SellQty;
+    __int128 net = __int128{NetPos} + delta.NetPos;
+    return buy >= 0 && sell >= 0 && buy + (net > 0 ? net : 0) <= MAX &&
+           sell + (net < 0 ? -net : 0) <= MAX;
+  }
 
   friend std::ostream &operator<<(std::ostream &out, ProductInfo const &pr) {
     out << "NetPos: " << pr.NetPos << ", BuyQty: " << pr.BuyQty
         << ", SellQty: " << pr.SellQty << ", MaxBuy: " << pr.MBuy
-        << ", MSell: " << pr.MSell;
+        << ", MSell: " << pr.MSell
+        << ", GrossNotional: " << fixed_to_double(pr.Exposure.gross())
+        << ", NetNotional: " << fixed_to_double(pr.Exposure.net());
     return out;
   }
 };
 
+/**
+ * @brief A resting order of a trader. The order id is the key of the trader
+ * order map and the owning connection identifies the trader, so neither is
+ * repeated here. The price keeps the 4 implicit decimals of the wire format.
+ * The record is 32 bytes so two orders share a cache line.
+ *
+ * The generation counts the new orders of the session and travels with the
+ * order to the exchange, a fill only releases resting quantity from the
+ * order of its own generation and not from a later one reusing the order id.
+ * It wraps at 16 bits, a fill is handled within a sweep or two of its
+ * report, far fewer orders than that.
+ */
 struct Order {
-  int m_traderFd;
-  uint64_t m_id;
   uint64_t m_productId;
   uint64_t m_quantity;
-  double m_price;
-  char m_side;
+  Price m_price;         // 4 implicit decimals
+  uint32_t m_listingPos; // position inside the listing index of the trader
+  uint16_t m_generation; // tells the order from an earlier one with its id
+  char m_side;           // 'B' for BUY, 'S' for SELL
+};
+static_assert(sizeof(Order) == 32, "The Order record is not compact!");
+
+static_assert(!ProductInfo{.BuyQty = 10}.fits(
+                  RiskDelta::resting('B', QUANTITY_MAX, 0, 1)),
+              "a quantity total must not wrap");
+
+/// Pages backing the memory of the hot tables
+enum class HugePageMode : uint8_t {
+  Off,         // normal pages
+  Transparent, // madvise(MADV_HUGEPAGE), the kernel promotes what it can
+  Explicit     // MAP_HUGETLB, needs huge pages reserved in the kernel
 };
 
 struct ServerConfig {
-  uint64_t BuyLimit;
-  uint64_t SellLimit;
+  uint64_t BuyLimit{100};
+  uint64_t SellLimit{100};
+  Notional ProductGrossLimit{NOTIONAL_MAX}; // 4 implicit decimals
+  Notional ProductNetLimit{NOTIONAL_MAX};   // 4 implicit decimals
+  Notional TraderGrossLimit{NOTIONAL_MAX};  // 4 implicit decimals
+  Notional TraderNetLimit{NOTIONAL_MAX};    // 4 implicit decimals
+  uint32_t MsgRate{0};            // messages per second per session, 0 = off
+  uint32_t MsgBurst{0};           // messages a session can save up
+  uint32_t FairBudget{16};        // messages per session per loop iteration
+  uint64_t OverloadLoopNs{0};     // loop time that triggers shedding, 0 = off
+  uint64_t OverloadQueueBytes{0}; // buffered bytes that trigger shedding
+  std::string MetricsPort{};      // loopback metrics port, empty = off
+  uint64_t HeartbeatMs{0};        // evict traders silent this long, 0 = off
+
+  uint64_t SnapshotIntervalMs{1000}; // how often changed products are written
+  std::string SnapshotFile{};        // snapshot file, empty for stdout
+  std::string SnapshotSocket{};      // UNIX socket for snapshot subscribers
+
+  std::string PositionViewFile{};      // shared position view, empty = off
+  uint32_t PositionViewProducts{4096}; // product slots of the view
+  uint32_t PositionViewTraders{1024};  // trader slots of the view
+
+  bool SpinPoll{false};   // busy poll instead of blocking in poll
+  int PinCpu{-1};         // core of the event loop thread, -1 = any
+  int FifoPriority{0};    // SCHED_FIFO priority of the event loop, 0 = off
+  bool LockMemory{false}; // mlock and pre-fault the memory at startup
+  int BusyPollUs{0};      // SO_BUSY_POLL of the trader sockets, 0 = off
+
+  bool CoroutineSessions{false}; // coroutines on non-blocking sockets
+
+  uint32_t ExpectedListings{0}; // listings the tables are sized for, 0 = grow
+  uint32_t ExpectedTraders{0};  // sessions the tables are sized for
+  uint32_t OrdersPerTrader{0};  // resting orders sized for per session
+  HugePageMode HugePages{HugePageMode::Off}; // backing of the hot tables
+
+  std::string Exchange{};     // "mock" or HOST:PORT, empty = no gateway
+  uint32_t MockFillPct{100};  // share of every order the mock exchange fills
+  std::string OrderLogFile{}; // journal of the handled frames, empty = off
+  std::string DropCopy{};     // drop copy port or UNIX socket, empty = off
+
+  std::string GroupLimitsFile{}; // group limit hierarchy, empty = none
+  uint32_t ExecutorThreads{2};   // slow path workers, 0 = on the event loop
 };
 
 struct ServerInfo {
   uint64_t BuyLimit{100};
   uint64_t SellLimit{100};
+  Notional ProductGrossLimit{NOTIONAL_MAX};
+  Notional ProductNetLimit{NOTIONAL_MAX};
+  Notional TraderGrossLimit{NOTIONAL_MAX};
+  Notional TraderNetLimit{NOTIONAL_MAX};
+  uint32_t MsgRate{0};
+  uint32_t MsgBurst{0};
+  uint32_t FairBudget{16};
+  uint64_t OverloadLoopNs{0};
+  uint64_t OverloadQueueBytes{0};
+  std::string MetricsPort{};
+  uint64_t HeartbeatMs{0};
+  uint64_t SnapshotIntervalMs{1000};
+  std::string SnapshotFile{};
+  std::string SnapshotSocket{};
+  std::string PositionViewFile{};
+  uint32_t PositionViewProducts{4096};
+  uint32_t PositionViewTraders{1024};
+  bool SpinPoll{false};
+  int PinCpu{-1};
+  int FifoPriority{0};
+  bool LockMemory{false};
+  int BusyPollUs{0};
+  bool CoroutineSessions{false};
+  uint32_t ExpectedListings{0};
+  uint32_t ExpectedTraders{0};
+  uint32_t OrdersPerTrader{0};
+  HugePageMode HugePages{HugePageMode::Off};
+  std::string Exchange{};
+  uint32_t MockFillPct{100};
+  std::string OrderLogFile{};
+  std::string DropCopy{};
+  std::string GroupLimitsFile{};
+  uint32_t ExecutorThreads{2};
   std::string Host{"localhost"};
   std::string Port{"4000"};
+
+  /**
+   * @brief Check the worst positions of a product and the notional exposure of
+   * the product and of the trader against the limits in a single pass. A
+   * notional that overflowed exceeds every limit.
+   * @return true if any limit is exceeded
+   */
+  [[nodiscard]] constexpr bool
+  exceeds_limits(ProductInfo const &prod,
+                 NotionalExposure const &trader) const noexcept {
+    return !prod.Exposure.exact() || !trader.exact() ||
+           prod.MBuy > BuyLimit || prod.MSell > SellLimit ||
+           prod.Exposure.gross() > ProductGrossLimit ||
+           prod.Exposure.net() > ProductNetLimit ||
+           trader.gross() > TraderGrossLimit || trader.net() > TraderNetLimit;
+  }
 };
 
 #endif
@@ -0,0 +1,198 @@
+#ifndef SESSION_TASK_INCLUDED_H
+#define SESSION_TASK_INCLUDED_H
+
+#include <array>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Fixed set of blocks coroutine frames are carved from, owned by the
+ * object whose member coroutines use it. A session keeps only a couple of
+ * frames alive at a time, so taking and returning a block is a push / pop
+ * on a free list and no message allocates. Frames larger than a block, or
+ * beyond the last free block, fall back to the heap and are counted.
+ */
+class FramePool {
+public:
+  enum { block_size = 512, block_count = 4 };
+
+private:
+  alignas(std::max_align_t)
+      std::array<std::byte, block_size * block_count> m_arena;
+  std::array<uint8_t, block_count> m_free; // indices of the free blocks
+  uint32_t m_freeCount;
+  uint64_t m_heapFrames; // frames that did not fit the pool
+
+public:
+  FramePool()
+      : m_arena(), m_free(), m_freeCount(block_count), m_heapFrames(0) {
+    for (uint8_t i = 0; i < block_count; ++i) {
+      m_free[i] = i;
+    }
+  }
+  FramePool(FramePool const &) = delete;
+  FramePool &operator=(FramePool const &) = delete;
+
+  /// A free block of at least size bytes, nullptr if none is left
+  [[nodiscard]] inline void *allocate(size_t size) noexcept {
+    if (size > block_size || m_freeCount == 0) {
+      ++m_heapFrames;
+      return nullptr;
+    }
+    return m_arena.data() + m_free[--m_freeCount] * block_size;
+  }
+
+  inline void deallocate(void *ptr) noexcept {
+    size_t offset = static_cast<std::byte *>(ptr) - m_arena.data();
+    m_free[m_freeCount++] = static_cast<uint8_t>(offset / block_size);
+  }
+
+  /// Frames that had to be allocated on the heap
+  [[nodiscard]] inline uint64_t heap_frames() const noexcept {
+    return m_heapFrames;
+  }
+};
+
+/// An object whose member coroutines allocate their frames from its pool
+template <typename T>
+concept HasFramePool = requires(T &owner) {
+  { owner.frame_pool() } -> std::same_as<FramePool &>;
+};
+
+/**
+ * @brief Allocation of the frames of a coroutine. Member coroutines of a
+ * HasFramePool type take their frame from the pool of their object, the
+ * pool is remembered in front of the frame so it can be given back.
+ */
+struct PooledPromise {
+  static constexpr size_t HEADER = alignof(std::max_align_t);
+
+  static void *allocate(FramePool *pool, size_t size) {
+    void *block = pool != nullptr ? pool->allocate(size + HEADER) : nullptr;
+    if (block == nullptr) {
+      pool = nullptr;
+      block = ::operator new(size + HEADER);
+    }
+    *static_cast<FramePool **>(block) = pool;
+    return static_cast<std::byte *>(block) + HEADER;
+  }
+
+  template <HasFramePool Owner, typename... Args>
+  static void *operator new(size_t size, Owner &owner, Args &...) {
+    return allocate(&owner.frame_pool(), size);
+  }
+
+  static void *operator new(size_t size) { return allocate(nullptr, size); }
+
+  static void operator delete(void *frame) noexcept {
+    void *block = static_cast<std::byte *>(frame) - HEADER;
+    FramePool *pool = *static_cast<FramePool **>(block);
+    if (pool != nullptr) {
+      pool->deallocate(block);
+    } else {
+      ::operator delete(block);
+    }
+  }
+
+  template <HasFramePool Owner, typename... Args>
+  static void operator delete(void *frame, Owner &, Args &...) noexcept {
+    PooledPromise::operator delete(frame);
+  }
+};
+
+/**
+ * @brief Lazily started coroutine producing a T. Awaiting a task starts it
+ * and resumes the awaiting coroutine once it returned, without going through
+ * the event loop. A task that is never awaited is started with resume().
+ */
+template <typename T = void> class Task {
+  template <typename Derived> struct PromiseBase : PooledPromise {
+    std::coroutine_handle<> Continuation{};
+
+    struct FinalAwaiter {
+      bool await_ready() const noexcept { return false; }
+      std::coroutine_handle<>
+      await_suspend(std::coroutine_handle<Derived> handle) noexcept {
+        std::coroutine_handle<> next = handle.promise().Continuation;
+        return next ? next : std::noop_coroutine();
+      }
+      void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+
+  template <typename U> struct Promise : PromiseBase<Promise<U>> {
+    std::optional<U> Value{};
+    Task get_return_object() {
+      return Task{std::coroutine_handle<Promise>::from_promise(*this)};
+    }
+    void return_value(U value) { Value = std::move(value); }
+  };
+
+  template <typename U>
+    requires std::is_void_v<U>
+  struct Promise<U> : PromiseBase<Promise<U>> {
+    Task get_return_object() {
+      return Task{std::coroutine_handle<Promise>::from_promise(*this)};
+    }
+    void return_void() const noexcept {}
+  };
+
+public:
+  using promise_type = Promise<T>;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  Task() noexcept : m_handle() {}
+  explicit Task(handle_type handle) noexcept : m_handle(handle) {}
+  Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      reset();
+      m_handle = std::exchange(other.m_handle, {});
+    }
+    return *this;
+  }
+  Task(Task const &) = delete;
+  Task &operator=(Task const &) = delete;
+  ~Task() { reset(); }
+
+  /// Destroy the coroutine, wherever it is suspended
+  inline void reset() noexcept {
+    if (m_handle) {
+      m_handle.destroy();
+      m_handle = {};
+    }
+  }
+
+  [[nodiscard]] inline handle_type handle() const noexcept { return m_handle; }
+  [[nodiscard]] inline bool done() const noexcept {
+    return !m_handle || m_handle.done();
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    m_handle.promise().Continuation = awaiting;
+    return m_handle;
+  }
+  T await_resume() {
+    if constexpr (!std::is_void_v<T>) {
+      return std::move(*m_handle.promise().Value);
+    }
+  }
+
+private:
+  handle_type m_handle;
+};
+
+#endif
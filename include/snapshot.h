@@ -0,0 +1,78 @@
+#ifndef SNAPSHOT_INCLUDED_H
+#define SNAPSHOT_INCLUDED_H
+
+#include "server_util.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief State of a single product at the time of a snapshot tick.
+ */
+struct ProductSnapshot {
+  uint64_t ProductId{0};
+  ProductInfo Info{};
+};
+
+/**
+ * @brief Writes the products that changed since the previous tick from a
+ * background thread. The event loop hands over a batch once per tick, so the
+ * order path only pays for marking a product dirty and formatting never runs
+ * on the network thread. Batches go to stdout, to a file, or to every
+ * subscriber connected to a local UNIX socket.
+ */
+class SnapshotPublisher {
+  std::mutex m_mutex;
+  std::condition_variable_any m_cv;
+  std::vector<ProductSnapshot> m_pending; // batches not yet written
+  uint64_t m_pendingNs;                   // time of the latest tick
+  int m_fileFd;                           // stdout or the snapshot file
+  int m_listenerFd;                       // subscriber socket or INVALID_FD
+  std::vector<int> m_subscribers;
+  std::jthread m_thread;
+
+public:
+  SnapshotPublisher();
+  ~SnapshotPublisher();
+  SnapshotPublisher(SnapshotPublisher const &) = delete;
+  SnapshotPublisher &operator=(SnapshotPublisher const &) = delete;
+
+  /**
+   * @brief Open the target and start the publisher thread.
+   * @param file - file the snapshots are appended to, empty for stdout
+   * @param socketPath - UNIX socket subscribers connect to, empty for none.
+   * When set the snapshots go to the subscribers instead of the file.
+   * @return false if the target could not be opened
+   */
+  bool start(std::string const &file, std::string const &socketPath);
+
+  /**
+   * @brief Hand a batch of changed products to the publisher thread. The
+   * batch is swapped with an empty vector so its storage can be reused.
+   * @param batch - the changed products, left empty on return
+   * @param nowNs - time of the tick in nanoseconds from the Unix epoch
+   */
+  void publish(std::vector<ProductSnapshot> &batch, uint64_t nowNs);
+
+private:
+  /**
+   * @brief Body of the publisher thread.
+   */
+  void run(std::stop_token stop);
+
+  /**
+   * @brief Accept the subscribers waiting on the socket.
+   */
+  void accept_subscribers();
+
+  /**
+   * @brief Write a formatted batch to the file or to all the subscribers.
+   * Subscribers that cannot keep up or went away are dropped.
+   */
+  void write_out(std::string const &text);
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef SPSC_QUEUE_INCLUDED_H
+#define SPSC_QUEUE_INCLUDED_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Bounded lock-free queue between exactly one producer thread and one
+ * consumer thread. Neither side ever blocks, a full or empty queue is
+ * reported to the caller. Each side keeps a cached copy of the other side's
+ * index so the shared cache lines are only read when the cache runs out.
+ * @tparam T - trivially copyable element
+ * @tparam Capacity - number of slots, a power of two
+ */
+template <typename T, size_t Capacity> class SpscQueue {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "The capacity must be a power of two!");
+  static constexpr uint64_t MASK = Capacity - 1;
+
+  alignas(64) std::atomic<uint64_t> m_tail; // next slot written by producer
+  uint64_t m_headCache;                     // producer copy of m_head
+  alignas(64) std::atomic<uint64_t> m_head; // next slot read by consumer
+  uint64_t m_tailCache;                     // consumer copy of m_tail
+  alignas(64) std::array<T, Capacity> m_slots;
+
+public:
+  SpscQueue()
+      : m_tail(0), m_headCache(0), m_head(0), m_tailCache(0), m_slots() {}
+  SpscQueue(SpscQueue const &) = delete;
+  SpscQueue &operator=(SpscQueue const &) = delete;
+
+  /**
+   * @brief Append an element, producer side only.
+   * @return false if the queue is full
+   */
+  bool try_push(T const &value) noexcept {
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_headCache == Capacity) {
+      m_headCache = m_head.load(std::memory_order_acquire);
+      if (tail - m_headCache == Capacity) {
+        return false;
+      }
+    }
+    m_slots[tail & MASK] = value;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Remove the oldest element, consumer side only.
+   * @return false if the queue is empty
+   */
+  bool try_pop(T &value) noexcept {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tailCache) {
+      m_tailCache = m_tail.load(std::memory_order_acquire);
+      if (head == m_tailCache) {
+        return false;
+      }
+    }
+    value = m_slots[head & MASK];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Number of free slots as seen by the producer. Only the producer
+   * fills slots, so at least this many pushes will succeed.
+   */
+  [[nodiscard]] size_t free_slots() const noexcept {
+    return Capacity - (m_tail.load(std::memory_order_relaxed) -
+                       m_head.load(std::memory_order_acquire));
+  }
+};
+
+#endif
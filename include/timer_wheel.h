@@ -0,0 +1,283 @@
+#ifndef TIMER_WHEEL_INCLUDED_H
+#define TIMER_WHEEL_INCLUDED_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Reference to a timer armed in a TimerWheel. The generation of the
+ * node is bumped whenever the timer fires or is cancelled, so a handle that
+ * outlived its timer is detected.
+ */
+struct TimerId {
+  uint32_t Index{UINT32_MAX};
+  uint32_t Generation{0};
+};
+
+/**
+ * @brief Hashed hierarchical timer wheel driven by the event loop. Time is cut
+ * into ticks, the first level holds one slot per tick of the next 256 ticks
+ * and every further level one slot per 256 slots of the level below. Arming
+ * and cancelling a timer is a push / unlink on the intrusive list of its
+ * slot. Advancing the wheel only visits the slots that are due, timers of the
+ * upper levels are cascaded down when their slot comes up, and occupancy
+ * bitmaps let the wheel jump over empty stretches of time.
+ *
+ * Timers live in a slab reused through a free list, so the wheel does not
+ * allocate once it has been reserved for the number of timers it holds.
+ * @tparam T - trivially copyable payload handed back when the timer fires
+ */
+template <typename T> class TimerWheel {
+  static constexpr uint32_t LEVEL_BITS = 8;
+  static constexpr uint32_t SLOTS = 1u << LEVEL_BITS;
+  static constexpr uint32_t LEVELS = 4;
+  static constexpr uint32_t NIL = UINT32_MAX;
+  static constexpr uint64_t MAX_DELAY = (1ull << (LEVEL_BITS * LEVELS)) - 1;
+
+  struct Node {
+    uint64_t Expiry{0}; // tick the timer fires at
+    uint32_t Prev{NIL};
+    uint32_t Next{NIL}; // next node of the slot, or of the free list
+    uint32_t Generation{0};
+    uint32_t Slot{NIL}; // level * SLOTS + slot, NIL while free
+    T Data{};
+  };
+
+  using Bitmap = std::array<uint64_t, SLOTS / 64>;
+
+  std::vector<Node> m_nodes;
+  uint32_t m_free; // head of the free list
+  std::array<uint32_t, LEVELS * SLOTS> m_heads;
+  std::array<Bitmap, LEVELS> m_occupied; // slots with at least one timer
+  uint64_t m_tickNs;
+  uint64_t m_startNs; // time of tick 0
+  uint64_t m_now;     // last tick processed
+  size_t m_size;
+
+public:
+  /**
+   * @param tickNs - resolution of the wheel, timers fire at most a tick late
+   * @param nowNs - current time, the origin of the ticks
+   */
+  TimerWheel(uint64_t tickNs, uint64_t nowNs)
+      : m_nodes(), m_free(NIL), m_heads(), m_occupied(), m_tickNs(tickNs),
+        m_startNs(nowNs), m_now(0), m_size(0) {
+    m_heads.fill(NIL);
+  }
+  TimerWheel(TimerWheel const &) = delete;
+  TimerWheel &operator=(TimerWheel const &) = delete;
+
+  /// Make room for count timers so arming them does not allocate
+  void reserve(size_t count) {
+    while (m_nodes.size() < count) {
+      m_nodes.emplace_back().Next = m_free;
+      m_free = static_cast<uint32_t>(m_nodes.size() - 1);
+    }
+  }
+
+  /**
+   * @brief Arm a timer. A deadline that already passed fires on the next
+   * advance.
+   * @param deadlineNs - the timer fires once the wheel is advanced past it
+   * @param data - handed back when the timer fires
+   * @return the handle to cancel the timer with
+   */
+  TimerId schedule(uint64_t deadlineNs, T const &data) {
+    if (m_free == NIL) {
+      reserve(m_nodes.empty() ? 64 : m_nodes.size() * 2);
+    }
+    uint32_t index = m_free;
+    Node &node = m_nodes[index];
+    m_free = node.Next;
+
+    // round up so a timer never fires before its deadline
+    uint64_t since = deadlineNs > m_startNs ? deadlineNs - m_startNs : 0;
+    node.Expiry = std::max((since + m_tickNs - 1) / m_tickNs, m_now + 1);
+    node.Data = data;
+    link(index);
+    ++m_size;
+    return TimerId{.Index = index, .Generation = node.Generation};
+  }
+
+  /**
+   * @brief Disarm a timer.
+   * @return false if the timer already fired or was cancelled
+   */
+  bool cancel(TimerId id) noexcept {
+    if (id.Index >= m_nodes.size() ||
+        m_nodes[id.Index].Generation != id.Generation ||
+        m_nodes[id.Index].Slot == NIL) {
+      return false;
+    }
+    unlink(id.Index);
+    release(id.Index);
+    return true;
+  }
+
+  /**
+   * @brief Fire every timer whose deadline is not after nowNs, in deadline
+   * order at tick resolution. The callback may arm and cancel timers.
+   * @param func - called with the payload of every timer that fires
+   * @return the number of timers that fired
+   */
+  template <typename F> size_t advance(uint64_t nowNs, F &&func) {
+    uint64_t target = nowNs > m_startNs ? (nowNs - m_startNs) / m_tickNs : 0;
+    size_t fired = 0;
+    while (m_now < target) {
+      uint64_t next = m_size == 0 ? UINT64_MAX : next_event_tick();
+      if (next > target) { // nothing is due or cascades until then
+        m_now = target;
+        break;
+      }
+      m_now = next;
+      cascade();
+
+      uint32_t slot = static_cast<uint32_t>(m_now & (SLOTS - 1));
+      while (m_heads[slot] != NIL) { // the callback may touch this slot
+        uint32_t index = m_heads[slot];
+        unlink(index);
+        T data = m_nodes[index].Data;
+        release(index);
+        ++fired;
+        func(data);
+      }
+    }
+    return fired;
+  }
+
+  /**
+   * @brief Time the wheel has to be advanced at next. It can be earlier than
+   * the next deadline when an upper level slot has to be cascaded first.
+   * @return the time in ns, UINT64_MAX if no timer is armed
+   */
+  [[nodiscard]] uint64_t next_deadline_ns() const noexcept {
+    if (m_size == 0) {
+      return UINT64_MAX;
+    }
+    return m_startNs + next_event_tick() * m_tickNs;
+  }
+
+  /// Number of armed timers
+  [[nodiscard]] inline size_t size() const noexcept { return m_size; }
+
+private:
+  /// Put an armed node in the slot of its expiry relative to the current tick
+  void link(uint32_t index) noexcept {
+    Node &node = m_nodes[index];
+    uint64_t delay = std::min(node.Expiry - m_now, MAX_DELAY);
+    uint64_t expiry = m_now + delay;
+    uint32_t level = 0;
+    while (level + 1 < LEVELS &&
+           delay >= (1ull << (LEVEL_BITS * (level + 1)))) {
+      ++level;
+    }
+    uint32_t slot = static_cast<uint32_t>(
+        (expiry >> (LEVEL_BITS * level)) & (SLOTS - 1));
+
+    node.Slot = level * SLOTS + slot;
+    node.Prev = NIL;
+    node.Next = m_heads[node.Slot];
+    if (node.Next != NIL) {
+      m_nodes[node.Next].Prev = index;
+    }
+    m_heads[node.Slot] = index;
+    m_occupied[level][slot / 64] |= 1ull << (slot % 64);
+  }
+
+  void unlink(uint32_t index) noexcept {
+    Node &node = m_nodes[index];
+    if (node.Prev != NIL) {
+      m_nodes[node.Prev].Next = node.Next;
+    } else {
+      m_heads[node.Slot] = node.Next;
+    }
+    if (node.Next != NIL) {
+      m_nodes[node.Next].Prev = node.Prev;
+    }
+    if (m_heads[node.Slot] == NIL) {
+      uint32_t level = node.Slot / SLOTS;
+      uint32_t slot = node.Slot % SLOTS;
+      m_occupied[level][slot / 64] &= ~(1ull << (slot % 64));
+    }
+    node.Slot = NIL;
+  }
+
+  /// Give an unlinked node back to the free list and invalidate its handles
+  void release(uint32_t index) noexcept {
+    Node &node = m_nodes[index];
+    ++node.Generation;
+    node.Next = m_free;
+    m_free = index;
+    --m_size;
+  }
+
+  /**
+   * @brief Move the timers of the upper level slots that start at the
+   * current tick down the wheel, the highest level first so they can fall
+   * through several levels at once.
+   */
+  void cascade() noexcept {
+    for (uint32_t level = LEVELS - 1; level != 0; --level) {
+      uint32_t shift = LEVEL_BITS * level;
+      if ((m_now & ((1ull << shift) - 1)) != 0) {
+        continue;
+      }
+      uint32_t head = level * SLOTS + ((m_now >> shift) & (SLOTS - 1));
+      while (m_heads[head] != NIL) {
+        uint32_t index = m_heads[head];
+        unlink(index);
+        link(index);
+      }
+    }
+  }
+
+  /**
+   * @brief First occupied slot of a level strictly after the given slot,
+   * going around the wheel.
+   * @return the distance in slots, 0 if the level is empty
+   */
+  [[nodiscard]] uint32_t next_occupied(uint32_t level,
+                                       uint32_t slot) const noexcept {
+    Bitmap const &bits = m_occupied[level];
+    for (uint32_t step = 1; step <= SLOTS; step += 64) {
+      uint32_t from = (slot + step) % SLOTS;
+      // the 64 slots starting at from, stitched from two words
+      uint32_t word = from / 64;
+      uint32_t bit = from % 64;
+      uint64_t window = bits[word] >> bit;
+      if (bit != 0) {
+        window |= bits[(word + 1) % bits.size()] << (64 - bit);
+      }
+      if (window != 0) {
+        uint32_t distance = step + std::countr_zero(window);
+        return distance <= SLOTS ? distance : 0;
+      }
+    }
+    return 0;
+  }
+
+  /**
+   * @brief Next tick at which a timer fires or an upper level slot has to be
+   * cascaded.
+   * @return the tick, UINT64_MAX if the wheel is empty
+   */
+  [[nodiscard]] uint64_t next_event_tick() const noexcept {
+    uint64_t next = UINT64_MAX;
+    for (uint32_t level = 0; level < LEVELS; ++level) {
+      uint32_t shift = LEVEL_BITS * level;
+      uint64_t current = m_now >> shift;
+      uint32_t distance = next_occupied(
+          level, static_cast<uint32_t>(current & (SLOTS - 1)));
+      if (distance != 0) {
+        next = std::min(next, (current + distance) << shift);
+      }
+    }
+    return next;
+  }
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef TRANSPORT_INCLUDED_H
+#define TRANSPORT_INCLUDED_H
+
+#include "server_util.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief Byte stream a Connection reads its requests from and writes its
+ * responses to. Reads and writes follow the recv / send conventions so the
+ * socket implementation is a thin wrapper.
+ */
+class Transport {
+public:
+  Transport() = default;
+  virtual ~Transport() = default;
+  Transport(Transport const &) = delete;
+  Transport &operator=(Transport const &) = delete;
+
+  /**
+   * @brief Read the next bytes of the stream.
+   * @return bytes read, 0 if the peer hung up, -1 on error
+   */
+  virtual ssize_t read(char *buf, size_t size) = 0;
+
+  /**
+   * @brief Write bytes to the stream.
+   * @return bytes written, -1 on error
+   */
+  virtual ssize_t write(char const *buf, size_t size) = 0;
+
+  /// The file descriptor behind the stream, INVALID_FD if there is none
+  [[nodiscard]] virtual int fd() const noexcept = 0;
+};
+
+/**
+ * @brief Transport over a connected TCP socket. The socket is shut down and
+ * closed with the transport.
+ */
+class SocketTransport final : public Transport {
+  int m_fd;
+
+public:
+  explicit SocketTransport(int fd) : m_fd(fd) {}
+  ~SocketTransport() override;
+
+  ssize_t read(char *buf, size_t size) override;
+  ssize_t write(char const *buf, size_t size) override;
+  [[nodiscard]] int fd() const noexcept override { return m_fd; }
+};
+
+/**
+ * @brief Transport over memory, to drive a Connection without the kernel.
+ * Reads hand out a caller owned buffer of pre-encoded frames in chunks of at
+ * most the given size, like successive recv calls would. Once the input is
+ * consumed a read reports that the peer hung up, or EAGAIN like a drained
+ * non-blocking socket. Writes are counted and can be captured.
+ */
+class MemoryTransport final : public Transport {
+  std::string_view m_input;     // pre-encoded request frames
+  size_t m_inputPos;            // bytes of the input already read
+  size_t m_chunk;               // largest read, like the bytes of one recv
+  uint64_t m_bytesOut;          // bytes written by the connection
+  std::vector<char> *m_capture; // receives the written bytes, may be null
+  bool m_nonBlocking;           // EAGAIN instead of a hang up at the end
+
+public:
+  /**
+   * @param input - the request frames, must outlive the transport
+   * @param chunk - largest number of bytes a single read returns
+   * @param capture - buffer the written bytes are appended to, or nullptr
+   */
+  MemoryTransport(std::string_view input, size_t chunk,
+                  std::vector<char> *capture = nullptr)
+      : m_input(input), m_inputPos(0), m_chunk(chunk), m_bytesOut(0),
+        m_capture(capture), m_nonBlocking(false) {}
+  MemoryTransport(MemoryTransport const &) = delete;
+  MemoryTransport &operator=(MemoryTransport const &) = delete;
+
+  ssize_t read(char *buf, size_t size) override;
+  ssize_t write(char const *buf, size_t size) override;
+  [[nodiscard]] int fd() const noexcept override { return INVALID_FD; }
+
+  /// True while part of the input has not been read
+  [[nodiscard]] inline bool has_input() const noexcept {
+    return m_inputPos != m_input.size();
+  }
+
+  /// Report EAGAIN instead of a hang up once the input is consumed
+  inline void set_nonblocking(bool nonBlocking) noexcept {
+    m_nonBlocking = nonBlocking;
+  }
+
+  /// Start reading the input again from the given offset
+  inline void rewind(size_t offset = 0) noexcept { m_inputPos = offset; }
+
+  /// Bytes written by the connection so far
+  [[nodiscard]] inline uint64_t bytes_out() const noexcept {
+    return m_bytesOut;
+  }
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef TUNING_INCLUDED_H
+#define TUNING_INCLUDED_H
+
+#include <cstddef>
+
+/**
+ * Knobs for the low latency mode of the event loop. Every function logs why
+ * it failed and returns false, the server keeps running untuned.
+ */
+
+/// Bytes of stack touched by prefault_stack(), covers the event loop frames
+static constexpr size_t STACK_PREFAULT_BYTES = 512 * 1024;
+
+/**
+ * @brief Pin the calling thread to a single core.
+ * @param cpu - the core, as numbered by the kernel
+ */
+bool pin_thread(int cpu);
+
+/**
+ * @brief Run the calling thread under SCHED_FIFO so it is never preempted by
+ * normal threads. Needs CAP_SYS_NICE.
+ * @param priority - the real time priority, 1 to 99
+ */
+bool set_fifo_priority(int priority);
+
+/**
+ * @brief Lock every current and future page of the process in memory, which
+ * also faults them in now instead of on first use. Needs CAP_IPC_LOCK or a
+ * large enough RLIMIT_MEMLOCK.
+ */
+bool lock_memory();
+
+/**
+ * @brief Touch the next STACK_PREFAULT_BYTES of the calling thread's stack so
+ * the event loop never takes a page fault growing it.
+ */
+void prefault_stack();
+
+/**
+ * @brief Let recv and poll on the socket busy poll the device queue for up
+ * to the given time before sleeping (SO_BUSY_POLL).
+ * @param fd - the socket
+ * @param usec - busy poll budget in microseconds
+ */
+bool set_busy_poll(int fd, int usec);
+
+#endif
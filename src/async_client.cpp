@@ -0,0 +1,357 @@
+#include "include/async_client.h"
+#include "include/clock.h"
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+AsyncClient::AsyncClient(uint32_t window)
+    : m_sockfd(-1), m_version(PROTOCOL_V1), m_window(window), m_inFlight(0),
+      m_sequence(1), m_outbox(), m_outOffset(0), m_inBuf(recv_size),
+      m_rdPos(0), m_wrPos(0), m_pending(), m_massCancels(), m_onFill(),
+      m_batches(0), m_framesSent(0) {}
+
+AsyncClient::~AsyncClient() {
+  if (m_sockfd != -1) {
+    shutdown(m_sockfd, SHUT_RDWR);
+    close(m_sockfd);
+  }
+}
+
+/**
+ * @brief Read exactly size bytes from a blocking socket.
+ */
+static bool recv_all(int fd, char *buf, size_t size) {
+  size_t got = 0;
+  while (got != size) {
+    ssize_t n = recv(fd, buf + got, size - got, 0);
+    if (n <= 0) {
+      std::perror("async client recv: ");
+      return false;
+    }
+    got += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool AsyncClient::connect(std::string const &host, std::string const &port,
+                          uint16_t version) {
+  addrinfo hints;
+  addrinfo *out = nullptr;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (int rv = getaddrinfo(host.data(), port.data(), &hints, &out); rv != 0) {
+    std::cerr << "async client getaddrinfo error: " << gai_strerror(rv)
+              << "\n";
+    return false;
+  }
+
+  for (addrinfo *ptr = out; ptr != nullptr; ptr = ptr->ai_next) {
+    int fd = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+    if (fd == -1) {
+      continue;
+    }
+    if (::connect(fd, ptr->ai_addr, ptr->ai_addrlen) == -1) {
+      close(fd);
+      continue;
+    }
+    m_sockfd = fd;
+    break;
+  }
+  freeaddrinfo(out);
+  if (m_sockfd == -1) {
+    std::perror("async client connect: ");
+    return false;
+  }
+
+  // Batches are built by the client, Nagle would only delay them
+  int yes = 1;
+  setsockopt(m_sockfd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int));
+
+  // The Hello is answered before any other request, wait for it blocking
+  if (version > PROTOCOL_V1) {
+    Message<Hello> hello;
+    hello.data.messageType = Hello::MESSAGE_TYPE;
+    hello.data.maxVersion = version;
+    enqueue(hello);
+    std::array<char, HLRS_MSG_SIZE> frame;
+    Message<HelloResponse> resp;
+    if (!flush() || !recv_all(m_sockfd, frame.data(), frame.size())) {
+      return false;
+    }
+    WIRE_CODECS<HelloResponse>[PROTOCOL_V1].Decode(frame.data(), resp);
+    m_version = resp.data.version;
+  }
+
+  if (fcntl(m_sockfd, F_SETFL, O_NONBLOCK) == -1) {
+    std::perror("async client fcntl: ");
+    return false;
+  }
+  return true;
+}
+
+template <Sendable T> void AsyncClient::enqueue(Message<T> &msg) {
+  static_assert(max_frame_size<T>() <= max_frame,
+                "The request does not fit an outbox frame!");
+  msg.header.version = m_version;
+  msg.header.payloadSize = static_cast<uint16_t>(
+      WIRE_CODECS<T>[m_version].FrameSize - sizeof(Header));
+  msg.header.sequenceNumber = m_sequence++;
+  msg.header.timestamp = FastClock::now_ns();
+
+  OutFrame &frame = m_outbox.emplace_back();
+  frame.Size = static_cast<uint16_t>(
+      WIRE_CODECS<T>[m_version].Encode(msg, frame.Bytes.data()));
+}
+
+bool AsyncClient::new_order(uint64_t listingId, uint64_t orderId,
+                            uint64_t quantity, uint64_t price, char side,
+                            ResponseCallback callback) {
+  if (!has_window()) {
+    return false;
+  }
+  Message<NewOrder> msg;
+  msg.data.messageType = NewOrder::MESSAGE_TYPE;
+  msg.data.listingId = listingId;
+  msg.data.orderId = orderId;
+  msg.data.orderQuantity = quantity;
+  msg.data.orderPrice = price;
+  msg.data.side = side;
+  enqueue(msg);
+  m_pending[orderId].push_back(std::move(callback));
+  ++m_inFlight;
+  return true;
+}
+
+bool AsyncClient::delete_order(uint64_t orderId, ResponseCallback callback) {
+  if (!has_window()) {
+    return false;
+  }
+  Message<DeleteOrder> msg;
+  msg.data.messageType = DeleteOrder::MESSAGE_TYPE;
+  msg.data.orderId = orderId;
+  enqueue(msg);
+  m_pending[orderId].push_back(std::move(callback));
+  ++m_inFlight;
+  return true;
+}
+
+bool AsyncClient::modify_order(uint64_t orderId, uint64_t newQuantity,
+                               ResponseCallback callback) {
+  if (!has_window()) {
+    return false;
+  }
+  Message<ModifyOrderQuantity> msg;
+  msg.data.messageType = ModifyOrderQuantity::MESSAGE_TYPE;
+  msg.data.orderId = orderId;
+  msg.data.newQuantity = newQuantity;
+  enqueue(msg);
+  m_pending[orderId].push_back(std::move(callback));
+  ++m_inFlight;
+  return true;
+}
+
+bool AsyncClient::cancel_all(MassCancelCallback callback) {
+  if (!has_window()) {
+    return false;
+  }
+  Message<CancelAll> msg;
+  msg.data.messageType = CancelAll::MESSAGE_TYPE;
+  enqueue(msg);
+  m_massCancels.push_back(std::move(callback));
+  ++m_inFlight;
+  return true;
+}
+
+bool AsyncClient::cancel_listing(uint64_t listingId,
+                                 MassCancelCallback callback) {
+  if (!has_window()) {
+    return false;
+  }
+  Message<CancelByListing> msg;
+  msg.data.messageType = CancelByListing::MESSAGE_TYPE;
+  msg.data.listingId = listingId;
+  enqueue(msg);
+  m_massCancels.push_back(std::move(callback));
+  ++m_inFlight;
+  return true;
+}
+
+bool AsyncClient::poll(int timeoutMs) {
+  if (!flush()) {
+    return false;
+  }
+
+  pollfd pfd{.fd = m_sockfd,
+             .events = static_cast<short>(POLLIN |
+                                          (m_outbox.empty() ? 0 : POLLOUT)),
+             .revents = 0};
+  int ready = ::poll(&pfd, 1, timeoutMs);
+  if (ready == -1) {
+    std::perror("async client poll: ");
+    return false;
+  }
+  if (pfd.revents & POLLOUT && !flush()) {
+    return false;
+  }
+  if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+    return receive();
+  }
+  return true;
+}
+
+bool AsyncClient::flush() {
+  while (!m_outbox.empty()) {
+    std::array<iovec, IOV_MAX> iov;
+    size_t count = 0;
+    for (auto it = m_outbox.begin(); it != m_outbox.end() && count < IOV_MAX;
+         ++it, ++count) {
+      size_t skip = count == 0 ? m_outOffset : 0; // partially written
+      iov[count].iov_base = it->Bytes.data() + skip;
+      iov[count].iov_len = it->Size - skip;
+    }
+
+    // sendmsg takes MSG_NOSIGNAL, a server that hung up fails the write
+    msghdr msg{};
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = count;
+    ssize_t nbytes = sendmsg(m_sockfd, &msg, MSG_NOSIGNAL);
+    if (nbytes == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true; // the rest goes out once the socket drained
+      }
+      std::perror("async client sendmsg: ");
+      return false;
+    }
+    ++m_batches;
+
+    // drop the frames that were written completely
+    size_t written = static_cast<size_t>(nbytes) + m_outOffset;
+    while (!m_outbox.empty() && written >= m_outbox.front().Size) {
+      written -= m_outbox.front().Size;
+      m_outbox.pop_front();
+      ++m_framesSent;
+    }
+    m_outOffset = written;
+    if (!m_outbox.empty() && m_outOffset != 0) {
+      return true; // the socket buffer is full
+    }
+  }
+  return true;
+}
+
+bool AsyncClient::receive() {
+  while (true) {
+    if (m_wrPos == m_inBuf.size()) { // move the partial frame to the front
+      std::memmove(m_inBuf.data(), m_inBuf.data() + m_rdPos,
+                   m_wrPos - m_rdPos);
+      m_wrPos -= m_rdPos;
+      m_rdPos = 0;
+    }
+
+    ssize_t nbytes =
+        recv(m_sockfd, m_inBuf.data() + m_wrPos, m_inBuf.size() - m_wrPos, 0);
+    if (nbytes == 0) {
+      std::cerr << "async client: the server hung up\n";
+      return false;
+    }
+    if (nbytes == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      std::perror("async client recv: ");
+      return false;
+    }
+    m_wrPos += static_cast<size_t>(nbytes);
+
+    // Dispatch every complete frame, however the responses were coalesced
+    while (m_wrPos - m_rdPos >= sizeof(Header)) {
+      char const *frame = m_inBuf.data() + m_rdPos;
+      size_t size = sizeof(Header) +
+                    load_u16(m_version, frame + offsetof(Header, payloadSize));
+      if (m_wrPos - m_rdPos < size) {
+        break;
+      }
+      dispatch(frame, size);
+      m_rdPos += size;
+    }
+    if (m_rdPos == m_wrPos) {
+      m_rdPos = m_wrPos = 0;
+    }
+  }
+}
+
+template <Sendable T>
+bool AsyncClient::decode(char const *frame, size_t size,
+                         Message<T> &msg) const {
+  WireCodec<T> const &codec = WIRE_CODECS<T>[m_version];
+  if (codec.FrameSize != size) {
+    std::cerr << "async client: unexpected frame of " << size << " bytes\n";
+    return false;
+  }
+  codec.Decode(frame, msg);
+  return true;
+}
+
+void AsyncClient::dispatch(char const *frame, size_t size) {
+  uint16_t msgType = 0;
+  if (size >= sizeof(Header) + sizeof(msgType)) {
+    msgType = load_u16(m_version, frame + sizeof(Header));
+  }
+
+  switch (msgType) {
+  case OrderResponse::MESSAGE_TYPE: {
+    Message<OrderResponse> msg;
+    if (!decode(frame, size, msg)) {
+      return;
+    }
+    auto pending_it = m_pending.find(msg.data.orderId);
+    if (pending_it == m_pending.end()) {
+      std::cerr << "async client: response to unknown order "
+                << msg.data.orderId << "\n";
+      return;
+    }
+    ResponseCallback callback = std::move(pending_it->second.front());
+    pending_it->second.pop_front();
+    if (pending_it->second.empty()) {
+      m_pending.erase(pending_it);
+    }
+    --m_inFlight;
+    if (callback) {
+      callback(msg.data);
+    }
+    return;
+  }
+  case MassCancelResponse::MESSAGE_TYPE: {
+    Message<MassCancelResponse> msg;
+    if (!decode(frame, size, msg) || m_massCancels.empty()) {
+      return;
+    }
+    MassCancelCallback callback = std::move(m_massCancels.front());
+    m_massCancels.pop_front();
+    --m_inFlight;
+    if (callback) {
+      callback(msg.data);
+    }
+    return;
+  }
+  case Trade::MESSAGE_TYPE: {
+    Message<Trade> msg;
+    if (decode(frame, size, msg) && m_onFill) {
+      m_onFill(msg.data);
+    }
+    return;
+  }
+  default:
+    std::cerr << "async client: unexpected message type " << msgType << "\n";
+  }
+}
@@ -1,6 +1,6 @@
 #include "include/client.h"
+#include "include/clock.h"
 #include <arpa/inet.h>
-#include <chrono>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
@@ -61,18 +61,14 @@ void TCPClient::run() {
   std::cout << "If you wish to exit enter:  EXIT\n";
   uint16_t msg_type = 0;
   Header header;
-  Message<OrderResponse> rsp;
   while (true) {
     // clear vars
     std::memset(&header, 0, sizeof(Header));
-    std::memset(&rsp, 0, sizeof(Message<OrderResponse>));
 
     // Preset fields
     header.version = 1;
     header.sequenceNumber = seq++;
-    header.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
-                           std::chrono::system_clock::now().time_since_epoch())
-                           .count();
+    header.timestamp = FastClock::now_ns();
 
     // TODO: make factory for creating requests
     std::cout << "Message type: ";
@@ -124,6 +120,7 @@ void TCPClient::run() {
       std::cout << "Enter: (OrderId, NewQty)\n";
       Message<ModifyOrderQuantity> msg;
       std::memset(&msg, 0, MODO_MSG_SIZE);
+      header.payloadSize = sizeof(ModifyOrderQuantity);
       msg.header = std::move(header);
       msg.data.messageType = ModifyOrderQuantity::MESSAGE_TYPE;
       uint64_t order_id, new_quant;
@@ -140,6 +137,7 @@ void TCPClient::run() {
       std::cout << "Enter: (ProductId, TradeId, TradeQty, TradePrice)\n";
       Message<Trade> msg;
       std::memset(&msg, 0, TRO_MSG_SIZE);
+      header.payloadSize = sizeof(Trade);
       msg.header = std::move(header);
       msg.data.messageType = Trade::MESSAGE_TYPE;
       uint64_t listing_id, trade_id, trade_q, trade_p;
@@ -158,18 +156,49 @@ void TCPClient::run() {
       sendData(msg);
       break;
     }
+    case CancelAll::MESSAGE_TYPE: {
+      Message<CancelAll> msg;
+      std::memset(&msg, 0, CALL_MSG_SIZE);
+      header.payloadSize = sizeof(CancelAll);
+      msg.header = std::move(header);
+      msg.data.messageType = CancelAll::MESSAGE_TYPE;
+      sendData(msg);
+      receiveData<MassCancelResponse>();
+      continue;
+    }
+    case CancelByListing::MESSAGE_TYPE: {
+      std::cout << "Enter: (ProductId)\n";
+      Message<CancelByListing> msg;
+      std::memset(&msg, 0, CLST_MSG_SIZE);
+      header.payloadSize = sizeof(CancelByListing);
+      msg.header = std::move(header);
+      msg.data.messageType = CancelByListing::MESSAGE_TYPE;
+      uint64_t listing_id;
+      std::cout << "ProductId: ";
+      std::cin >> listing_id;
+      msg.data.listingId = listing_id;
+      sendData(msg);
+      receiveData<MassCancelResponse>();
+      continue;
+    }
     default:
-      std::cerr << "Illegal type try again: (1,2,3,4)\n";
+      std::cerr << "Illegal type try again: (1,2,3,4,6,7)\n";
     }
 
     // Receive data from server and print it
-    ssize_t nbytes = recv(m_sockfd, &rsp, sizeof(Message<OrderResponse>), 0);
-    if (nbytes <= 0) {
-      std::cerr << "Something went wrong on the server side\n";
-    }
-    deserialize(rsp);
-    std::cout << rsp;
+    receiveData<OrderResponse>();
+  }
+}
+
+template <Sendable T> void TCPClient::receiveData() {
+  Message<T> rsp;
+  std::memset(&rsp, 0, sizeof(Message<T>));
+  ssize_t nbytes = recv(m_sockfd, &rsp, sizeof(Message<T>), 0);
+  if (nbytes <= 0) {
+    std::cerr << "Something went wrong on the server side\n";
   }
+  deserialize(rsp);
+  std::cout << rsp;
 }
 
 template <Sendable T> void TCPClient::sendData(Message<T> &message) {
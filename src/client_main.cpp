@@ -1,8 +1,10 @@
 #include "include/client.h"
+#include "include/clock.h"
 
 int main() {
   std::string host{"localhost"};
   std::string port{"4000"};
+  FastClock::calibrate();
   TCPClient client{std::move(host), std::move(port)};
 
   client.run();
@@ -0,0 +1,72 @@
+#include "include/clock.h"
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+bool FastClock::s_useTsc = false;
+FastClock::Params FastClock::s_params;
+std::atomic<uint64_t> FastClock::s_version{0};
+uint64_t FastClock::s_firstTsc = 0;
+uint64_t FastClock::s_firstNs = 0;
+
+#if defined(__x86_64__)
+/**
+ * @brief Read the TSC and the wall clock as close together as possible. The
+ * TSC is read on both sides of clock_gettime and the midpoint is used.
+ */
+static void sample(uint64_t &tsc, uint64_t &ns) {
+  uint64_t before = __rdtsc();
+  ns = FastClock::realtime_ns();
+  uint64_t after = __rdtsc();
+  tsc = before + (after - before) / 2;
+}
+#endif
+
+bool FastClock::calibrate() {
+#if defined(__x86_64__)
+  // CPUID.80000007H:EDX[8] reports an invariant TSC
+  unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) ||
+      !(edx & (1u << 8))) {
+    return false;
+  }
+
+  sample(s_firstTsc, s_firstNs);
+  timespec pause{.tv_sec = 0, .tv_nsec = 20000000};
+  nanosleep(&pause, nullptr);
+  uint64_t tsc, ns;
+  sample(tsc, ns);
+  if (tsc <= s_firstTsc || ns <= s_firstNs) {
+    return false;
+  }
+
+  recalibrate();
+  s_useTsc = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void FastClock::recalibrate() {
+#if defined(__x86_64__)
+  uint64_t tsc, ns;
+  sample(tsc, ns);
+  if (tsc <= s_firstTsc || ns <= s_firstNs) {
+    return;
+  }
+
+  uint64_t mult = static_cast<uint64_t>(
+      (static_cast<unsigned __int128>(ns - s_firstNs) << s_shift) /
+      (tsc - s_firstTsc));
+
+  // an odd version makes the readers retry until the parameters are whole
+  uint64_t version = s_version.load(std::memory_order_relaxed);
+  s_version.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s_params.Mult.store(mult, std::memory_order_relaxed);
+  s_params.BaseTsc.store(tsc, std::memory_order_relaxed);
+  s_params.BaseNs.store(ns, std::memory_order_relaxed);
+  s_version.store(version + 2, std::memory_order_release);
+#endif
+}
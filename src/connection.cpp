@@ -1,140 +1,496 @@
 #include "include/connection.h"
+#include "include/instrumentation.h"
+#include "include/metrics.h"
 #include "include/orders.h"
-#include "include/server.h"
-#include <chrono>
+#include <algorithm>
+#include <cstddef>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 
+static constexpr size_t MAX_SPARE_BUFFERS = 256; // kept per thread
+
 uint32_t Connection::s_sequenceNumber = 0;
+thread_local std::vector<std::unique_ptr<Connection::RequestBuffer>>
+    Connection::s_spareBuffers;
+
+Connection::Connection(std::unique_ptr<Transport> transport,
+                       uint32_t traderId, RiskContext *context,
+                       bool coroutine)
+    : m_transport(std::move(transport)), m_traderId(traderId), m_rdPos(0),
+      m_wrPos(0), m_version(PROTOCOL_V1), m_nbytes(0), m_context(context),
+      m_bucket(), m_stamps(), m_reqBuf(), m_orders(context->Memory),
+      m_listingOrders(context->Memory), m_listingPositions(context->Memory),
+      m_exposure(), m_viewSlot(NO_VIEW_SLOT), m_generation(0), m_resBuf(),
+      m_massCancelBuf(), m_helloBuf(), m_preCheckBuf(), m_sendBuf(),
+      m_framePool(), m_session(), m_resumePoint(), m_wait(SessionWait::None),
+      m_budget(0), m_admission(nullptr), m_outBuf(), m_outPos(0) {
+  if (uint32_t orders = context->Info.OrdersPerTrader; orders != 0) {
+    m_orders.reserve(orders); // no rehash until the expected load
+    m_listingOrders.reserve(std::min(
+        orders, std::max(context->Info.ExpectedListings, uint32_t{1})));
+  }
+  if (coroutine) { // started by the first event
+    m_framePool = std::make_unique<FramePool>();
+    m_session = run_session();
+    m_resumePoint = m_session.handle();
+    m_outBuf.reserve(buf_size);
+  }
+}
 
-Connection::Connection(int sockfd, Server *owner)
-    : m_reqBuf(), m_orders(), m_resBuf(), m_nbytes(0), m_traderSock(sockfd),
-      m_server(owner) {}
+bool Connection::handle_client_request(bool readable,
+                                       AdmissionState const &admission,
+                                       bool writable) {
+  if (m_framePool != nullptr) {
+    return resume_session(readable, writable, admission);
+  }
+  if (readable && !fill_request_buffer()) { // extract client orders
+    return false;
+  }
 
-Connection::~Connection() { shutdown_connection(); }
+  // Serve at most the fair budget of frames, the rest waits for the next sweep
+  uint32_t budget = m_context->Info.FairBudget;
+  for (; budget != 0 && has_pending_request(); --budget) {
+    if (!handle_frame(admission)) {
+      return false;
+    }
+  }
 
-void Connection::handle_client_request() {
-  fill_request_buffer(); // extract client order
+  if (m_rdPos == m_wrPos) { // everything consumed, rewind the buffer
+    m_rdPos = m_wrPos = 0;
+    release_request_buffer();
+  }
+  return true;
+}
 
-  // Handle client order
-  switch (m_nbytes) {
-  case NEWO_MSG_SIZE: {
-    handle_order<NewOrder>();
-    break;
+bool Connection::has_pending_request() const noexcept {
+  if (m_wrPos - m_rdPos < sizeof(Header)) {
+    return false;
   }
-  case DELO_MSG_SIZE: {
-    handle_order<DeleteOrder>();
-    break;
+  return m_wrPos - m_rdPos >= frame_size();
+}
+
+size_t Connection::frame_size() const noexcept {
+  return sizeof(Header) +
+         load_u16(m_version,
+                  m_reqBuf->data() + m_rdPos + offsetof(Header, payloadSize));
+}
+
+bool Connection::handle_frame(AdmissionState const &admission) {
+  size_t const nbytes = frame_size();
+  m_nbytes = nbytes;
+  char const *frame = m_reqBuf->data() + m_rdPos;
+
+  // Every frame must use the protocol version negotiated for the session
+  if (load_u16(m_version, frame + offsetof(Header, version)) != m_version) {
+    std::cerr << "Unexpected protocol version, closing the connection\n";
+    return false;
   }
-  case MODO_MSG_SIZE: {
-    handle_order<ModifyOrderQuantity>();
-    break;
+
+  // The message type directly follows the header, sizes alone are ambiguous
+  uint16_t msgType = 0;
+  if (nbytes >= sizeof(Header) + sizeof(msgType)) {
+    msgType = load_u16(m_version, frame + sizeof(Header));
+  }
+  Metrics::add(Metrics::message_metric(msgType));
+
+  // Unknown types and frames of the wrong size are rejected, the session and
+  // the server carry on
+  if (msgType >= s_dispatch.size() ||
+      s_dispatch[msgType].FrameSize[m_version] != nbytes) {
+    std::cerr << "Cannot handle message type " << msgType << " of " << nbytes
+              << " bytes\n";
+    drop_copy(m_stamps.IngressNs, msgType, OrderResponse::Status::REJECTED);
+    send_rejection(0, OrderResponse::Status::REJECTED);
+    m_rdPos += nbytes;
+    return true;
+  }
+
+  // Requests adding or evaluating risk pass admission control before they
+  // are decoded
+  DispatchEntry const &entry = s_dispatch[msgType];
+  if (entry.Admitted) {
+    OrderResponse::Status status = admit(admission, entry.AddsRisk);
+    if (status != OrderResponse::Status::ACCEPTED) {
+      (this->*entry.Reject)(status);
+      m_rdPos += nbytes;
+      return true;
+    }
+  }
+
+  // Only the requests that reach the risk checks are journaled
+  m_context->Journal.append(m_stamps.IngressNs, m_traderId, m_version, frame,
+                            nbytes);
+  (this->*entry.Handle)();
+  m_rdPos += nbytes;
+  return true;
+}
+
+OrderResponse::Status Connection::admit(AdmissionState const &admission,
+                                        bool addsRisk) {
+  if (admission.Overloaded ||
+      (addsRisk && !m_context->Gateway.has_capacity())) {
+    return OrderResponse::Status::OVERLOADED;
+  }
+
+  ServerInfo const &info = m_context->Info;
+  if (!m_bucket.try_consume(admission.NowNs, info.MsgRate, info.MsgBurst)) {
+    return OrderResponse::Status::THROTTLED;
+  }
+  return OrderResponse::Status::ACCEPTED;
+}
+
+template <Sendable T>
+void Connection::reject_frame(OrderResponse::Status status) {
+  Message<T> msg = decode_frame<T>();
+  uint64_t orderId = 0;
+  if constexpr (requires(T const &request) { request.orderId; }) {
+    orderId = msg.data.orderId;
+  }
+  drop_copy(m_stamps.IngressNs, msg.data, status);
+  send_rejection(orderId, status);
+}
+
+template <typename T>
+void Connection::drop_copy(uint64_t timestampNs, T const &request,
+                           OrderResponse::Status status, uint64_t count) {
+  uint16_t messageType = 0;
+  if constexpr (std::is_same_v<T, uint16_t>) { // undecodable frame
+    messageType = request;
+  } else {
+    messageType = T::MESSAGE_TYPE;
+  }
+  Instrumentation::on_decision(m_traderId, messageType,
+                               static_cast<uint16_t>(status));
+  DropCopy &copies = m_context->Copies;
+  if (!copies.enabled()) {
+    return;
+  }
+
+  DropCopyEvent event;
+  event.TimestampNs = timestampNs;
+  event.TraderId = m_traderId;
+  event.MessageType = messageType;
+  event.Status = static_cast<uint16_t>(status);
+  event.Quantity = count;
+  if constexpr (requires { request.orderId; }) {
+    event.OrderId = request.orderId;
+  }
+  if constexpr (requires { request.listingId; }) {
+    event.ListingId = request.listingId;
+  }
+  if constexpr (requires { request.side; }) {
+    event.Side = request.side;
+  }
+  if constexpr (requires { request.orderQuantity; }) {
+    event.Quantity = request.orderQuantity;
+    event.Price = request.orderPrice;
+  } else if constexpr (requires { request.newQuantity; }) {
+    event.Quantity = request.newQuantity;
+  } else if constexpr (requires { request.tradeId; }) {
+    event.OrderId = request.tradeId;
+    event.Quantity = request.tradeQuantity;
+    event.Price = request.tradePrice;
+  }
+  copies.publish(event);
+}
+
+void Connection::send_rejection(uint64_t orderId,
+                                OrderResponse::Status status) {
+  m_resBuf.data.messageType = OrderResponse::MESSAGE_TYPE;
+  m_resBuf.data.orderId = orderId;
+  m_resBuf.data.status = status;
+  Metrics::add(Metrics::response_metric(static_cast<uint16_t>(status)));
+  generate_response_msg(m_resBuf);
+  send_message(m_resBuf);
+}
+
+bool Connection::fill_request_buffer() {
+  if (read_some() == ReadStatus::Closed) {
+    return false;
+  }
+
+  // A frame that can never fit the buffer cannot be recovered from
+  return m_wrPos - m_rdPos < sizeof(Header) || frame_size() <= buf_size;
+}
+
+Connection::ReadStatus Connection::read_some() {
+  if (m_reqBuf == nullptr) {
+    if (s_spareBuffers.empty()) {
+      m_reqBuf = std::make_unique<RequestBuffer>();
+    } else {
+      m_reqBuf = std::move(s_spareBuffers.back());
+      s_spareBuffers.pop_back();
+    }
   }
-  case TRO_MSG_SIZE: {
-    handle_order<Trade>();
+  if (m_rdPos != 0) { // move the partial frame to the front
+    std::memmove(m_reqBuf->data(), m_reqBuf->data() + m_rdPos,
+                 m_wrPos - m_rdPos);
+    m_wrPos -= m_rdPos;
+    m_rdPos = 0;
+  }
+  if (m_wrPos == m_reqBuf->size()) { // full, leave the rest in the kernel
+    return ReadStatus::Data;
+  }
+
+  ssize_t nbytes = m_transport->read(m_reqBuf->data() + m_wrPos,
+                                     m_reqBuf->size() - m_wrPos);
+  if (nbytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    if (m_wrPos == 0) {
+      release_request_buffer();
+    }
+    return ReadStatus::Again; // non-blocking and drained
+  }
+  if (nbytes <= 0) { // close the conection
+    if (nbytes == 0) {
+      std::cout << "pollconnection: " << get_socket() << " hung up\n";
+    } else {
+      std::perror("recv");
+    }
+    return ReadStatus::Closed;
+  }
+  m_wrPos += static_cast<uint32_t>(nbytes);
+  Metrics::add(Metric::BytesIn, nbytes);
+  Instrumentation::on_recv(m_traderId, nbytes);
+  m_stamps.IngressNs = FastClock::now_ns();
+  return ReadStatus::Data;
+}
+
+void Connection::release_request_buffer() noexcept {
+  if (m_reqBuf != nullptr && s_spareBuffers.size() < MAX_SPARE_BUFFERS) {
+    s_spareBuffers.push_back(std::move(m_reqBuf));
+  }
+  m_reqBuf.reset();
+}
+
+bool Connection::resume_session(bool readable, bool writable,
+                                AdmissionState const &admission) {
+  m_admission = &admission;
+  m_budget = m_context->Info.FairBudget;
+  if ((writable || readable) && !flush_output()) { // readable: maybe a hang up
+    return false;
+  }
+
+  switch (m_wait) {
+  case SessionWait::Read:
+    if (!readable) {
+      return true;
+    }
+    break;
+  case SessionWait::Write:
+    if (m_outPos != m_outBuf.size()) {
+      return true;
+    }
+    break;
+  case SessionWait::None:
+  case SessionWait::Sweep:
     break;
   }
-  default:
-    std::cerr << "Cannot handle this message!\n";
-    exit(1);
-  };
 
-  generate_response_msg(); // create full response message
-  send_message();          // send to client
+  m_wait = SessionWait::None;
+  m_resumePoint.resume(); // runs until the session waits again
+  return !m_session.done();
+}
+
+// GCC pairs the frame deallocation of a coroutine with the placement
+// operator new of its promise and warns, the frames are released correctly
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+Task<> Connection::run_session() {
+  // GCC 12 miscompiles a co_await on the right hand side of ||
+  while (true) {
+    FrameStatus status = co_await read_frame();
+    if (status == FrameStatus::Closed) {
+      co_return;
+    }
+    if (status != FrameStatus::Ready) { // the wait is over, look again
+      continue;
+    }
+    if (!handle_frame(*m_admission)) {
+      co_return;
+    }
 
-  m_server->print_system_state(); // print system state
+    // the responses of everything buffered go out together, and before
+    // anything more is read
+    if (has_pending_request() && m_budget != 0) {
+      continue;
+    }
+    bool written = co_await write();
+    if (!written) {
+      co_return;
+    }
+  }
 }
 
-void Connection::fill_request_buffer() {
+#pragma GCC diagnostic pop
 
-  m_nbytes = recv(m_traderSock, m_reqBuf.data(), m_reqBuf.size(), 0);
-  std::cout << "Connection [ " << m_traderSock << "] got: " << m_nbytes
-            << " bytes\n\n";
+Connection::FrameStatus Connection::next_frame() {
+  while (true) {
+    if (has_pending_request()) {
+      if (m_budget == 0) { // the rest waits for the next sweep
+        return FrameStatus::Sweep;
+      }
+      --m_budget;
+      return FrameStatus::Ready;
+    }
 
-  if (m_nbytes <= 0) { // close the conection
-    if (m_nbytes == 0) {
-      std::cout << "pollconnection: " << m_traderSock << " hung up\n";
+    ReadStatus status = read_some();
+    if (status == ReadStatus::Closed ||
+        (m_wrPos - m_rdPos >= sizeof(Header) && frame_size() > buf_size)) {
+      return FrameStatus::Closed;
+    }
+    if (status == ReadStatus::Again) {
+      return FrameStatus::Read;
     }
-    std::perror("recv");
-    // TODO: deregister
   }
 }
 
-void Connection::shutdown_connection() {
-  shutdown(m_traderSock, SHUT_RDWR);
-  close(m_traderSock);
+bool Connection::flush_output() {
+  while (m_outPos != m_outBuf.size()) {
+    ssize_t nbytes = m_transport->write(m_outBuf.data() + m_outPos,
+                                        m_outBuf.size() - m_outPos);
+    if (nbytes == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true; // the rest goes out once the socket drained
+      }
+      std::perror("send");
+      return false;
+    }
+    m_outPos += static_cast<size_t>(nbytes);
+    Metrics::add(Metric::BytesOut, nbytes);
+    Instrumentation::on_send(m_traderId, nbytes);
+  }
+  m_outBuf.clear();
+  m_outPos = 0;
+  return true;
 }
 
-void Connection::generate_response_msg() {
+template <Sendable T>
+void Connection::generate_response_msg(Message<T> &msg) {
   // Create header and send response
-  uint64_t time = std::chrono::duration_cast<std::chrono::seconds>(
-                      std::chrono::system_clock::now().time_since_epoch())
-                      .count();
-  Header responseHeader{.version = 1,
-                        .payloadSize = sizeof(OrderResponse),
+  m_stamps.EgressNs = FastClock::now_ns();
+  Header responseHeader{.version = m_version,
+                        .payloadSize = static_cast<uint16_t>(
+                            WIRE_CODECS<T>[m_version].FrameSize -
+                            sizeof(Header)),
                         .sequenceNumber = s_sequenceNumber++,
-                        .timestamp = time};
-  m_resBuf.header = std::move(responseHeader);
+                        .timestamp = m_stamps.EgressNs};
+  msg.header = std::move(responseHeader);
 }
 
-void Connection::send_message() {
-  serialize(m_resBuf);
+template <Sendable T> void Connection::send_message(Message<T> const &msg) {
+  static_assert(max_frame_size<T>() <= std::tuple_size_v<decltype(m_sendBuf)>,
+                "The response does not fit the send buffer!");
 
-  size_t toSend = ORDR_MSG_SIZE;
-  ssize_t actuallySent = send(m_traderSock, &m_resBuf, toSend, 0);
+  size_t toSend = WIRE_CODECS<T>[m_version].Encode(msg, m_sendBuf.data());
+  if (m_framePool != nullptr) { // written by the session coroutine
+    m_outBuf.insert(m_outBuf.end(), m_sendBuf.data(),
+                    m_sendBuf.data() + toSend);
+    return;
+  }
+  ssize_t actuallySent = m_transport->write(m_sendBuf.data(), toSend);
   if (actuallySent == -1) {
     std::cerr << "Some err\n";
+    return;
   }
+  Metrics::add(Metric::BytesOut, actuallySent);
+  Instrumentation::on_send(m_traderId, actuallySent);
 }
 
-template <Sendable T> void Connection::handle_order() {
-  Message<T> msg = create_msg_from_type<T>(m_reqBuf, m_nbytes);
-  deserialize(msg);
-  std::cout << msg;
-  m_resBuf.data = handle_order(msg);
+template <Sendable T> Message<T> Connection::decode_frame() const {
+  Message<T> msg;
+  WIRE_CODECS<T>[m_version].Decode(m_reqBuf->data() + m_rdPos, msg);
+  Instrumentation::on_decode(m_traderId, T::MESSAGE_TYPE);
+  return msg;
 }
 
-OrderResponse Connection::handle_order(Message<NewOrder> const &msg) {
-  // Create order from message
-  Order ord;
-  ord.m_traderFd = m_traderSock;
-  ord.m_id = msg.data.orderId;
-  ord.m_productId = msg.data.listingId;
-  ord.m_quantity = msg.data.orderQuantity;
-  ord.m_price = static_cast<double>(msg.data.orderPrice) / IMPLICIT_DEC;
-  ord.m_side = msg.data.side;
-
-  m_orders.insert(std::make_pair(ord.m_id, ord));
-
-  // update server state
-  auto &ProductMap = m_server->get_products();
-  auto prod_it = ProductMap.find(ord.m_productId);
-  if (prod_it == ProductMap.end()) { // insert default if it does not exist
-    prod_it =
-        ProductMap.insert(std::make_pair(ord.m_productId, ProductInfo())).first;
+template <Sendable T> void Connection::handle_order() {
+  Message<T> msg = decode_frame<T>();
+
+  if constexpr (std::is_same_v<T, CancelAll> ||
+                std::is_same_v<T, CancelByListing>) {
+    m_massCancelBuf.data = handle_order(msg);
+    drop_copy(m_stamps.IngressNs, msg.data, OrderResponse::Status::ACCEPTED,
+              m_massCancelBuf.data.cancelledCount);
+    generate_response_msg(m_massCancelBuf); // create full response message
+    send_message(m_massCancelBuf);          // send to client
+  } else if constexpr (std::is_same_v<T, Hello>) {
+    m_helloBuf.data = handle_order(msg);
+    generate_response_msg(m_helloBuf); // answered in the current version
+    send_message(m_helloBuf);
+    m_version = m_helloBuf.data.version;
+  } else if constexpr (std::is_same_v<T, PreCheck>) {
+    m_preCheckBuf.data = handle_order(msg);
+    generate_response_msg(m_preCheckBuf);
+    send_message(m_preCheckBuf);
+  } else {
+    m_resBuf.data = handle_order(msg);
+    drop_copy(m_stamps.IngressNs, msg.data, m_resBuf.data.status);
+    Metrics::add(
+        Metrics::response_metric(static_cast<uint16_t>(m_resBuf.data.status)));
+    generate_response_msg(m_resBuf); // create full response message
+    send_message(m_resBuf);          // send to client
   }
+}
 
-  ProductInfo prod = prod_it->second;
-  if (ord.m_side == 'B') {
-    prod.BuyQty += ord.m_quantity;
-  } else {
-    prod.SellQty += ord.m_quantity;
+template <Sendable T>
+constexpr void Connection::add_entry(DispatchTable &table) {
+  DispatchEntry &entry = table[T::MESSAGE_TYPE];
+  if (entry.Handle != nullptr) {
+    throw "Two request types share a message type";
+  }
+  for (uint16_t version = 0; version <= PROTOCOL_MAX; ++version) {
+    entry.FrameSize[version] = WIRE_CODECS<T>[version].FrameSize;
   }
+  entry.AddsRisk = std::is_same_v<T, NewOrder> ||
+                   std::is_same_v<T, ModifyOrderQuantity>;
+  // a pre-check runs up to a frame of risk checks, it is charged like an order
+  entry.Admitted = entry.AddsRisk || std::is_same_v<T, PreCheck>;
+  entry.Handle = &Connection::handle_order<T>;
+  entry.Reject = &Connection::reject_frame<T>;
+}
 
-  prod.MBuy = std::max(prod.BuyQty, prod.NetPos + prod.BuyQty);
-  prod.MSell = std::max(prod.SellQty, prod.SellQty - prod.NetPos);
+template <typename... Ts>
+constexpr Connection::DispatchTable
+Connection::make_dispatch_table(TypeList<Ts...>) {
+  DispatchTable table{};
+  (add_entry<Ts>(table), ...);
+  return table;
+}
+
+constexpr Connection::DispatchTable Connection::s_dispatch =
+    make_dispatch_table(RequestTypes{});
 
+OrderResponse Connection::handle_order(Message<NewOrder> const &msg) {
+  // Create order from message
   OrderResponse resp;
-  resp.orderId = ord.m_id;
+  resp.orderId = msg.data.orderId;
   resp.messageType = OrderResponse::MESSAGE_TYPE;
+  // order ids must stay unique, quantities fit the signed risk totals
+  if (m_orders.contains(msg.data.orderId) ||
+      msg.data.orderQuantity > QUANTITY_MAX) {
+    resp.status = OrderResponse::Status::REJECTED;
+    return resp;
+  }
 
-  ServerInfo &info = m_server->get_info();
-  // If we violate server do not add new order
-  if (prod.MBuy > info.BuyLimit && prod.MSell > info.SellLimit) {
+  Order ord;
+  ord.m_productId = msg.data.listingId;
+  ord.m_quantity = msg.data.orderQuantity;
+  ord.m_price = msg.data.orderPrice;
+  ord.m_listingPos = 0;
+  ord.m_generation = m_generation++;
+  ord.m_side = msg.data.side;
+
+  // If we violate server limits do not add new order
+  RiskDelta delta =
+      RiskDelta::resting(ord.m_side, ord.m_quantity, ord.m_price, 1);
+  if (!apply_risk(ord.m_productId, delta, true)) {
     resp.status = OrderResponse::Status::REJECTED;
     return resp;
   }
 
-  ProductMap[ord.m_productId] = std::move(prod); // update the product
+  insert_order(msg.data.orderId, ord); // only rested if accepted
+  forward_to_exchange(GatewayOrder::Kind::New, msg.data.orderId, ord);
   resp.status = OrderResponse::Status::ACCEPTED;
   return resp;
 }
@@ -149,28 +505,16 @@ OrderResponse Connection::handle_order(Message<DeleteOrder> const &msg) {
     return resp;
   }
 
+  // Removing resting quantity only lowers the risk, it is never rejected
   Order &ord_v = order.value();
-  auto &ProductMap = m_server->get_products();
-  auto prod_it = ProductMap.find(ord_v.m_productId);
-  ProductInfo prod = prod_it->second;
-
-  if (ord_v.m_side == 'B') {
-    prod.BuyQty -= ord_v.m_quantity;
-  } else {
-    prod.SellQty -= ord_v.m_quantity;
-  }
-
-  prod.MBuy = std::max(prod.MBuy, prod.MBuy + prod.NetPos);
-  prod.MSell = std::max(prod.SellQty, prod.SellQty - prod.NetPos);
-  ServerInfo &info = m_server->get_info();
-  if (prod.MBuy > info.BuyLimit || prod.MSell > info.SellLimit) {
-    resp.status = OrderResponse::Status::REJECTED;
-    return resp;
-  }
-  ProductMap[ord_v.m_productId] = std::move(prod); // update value
+  apply_risk(ord_v.m_productId,
+             RiskDelta::resting(ord_v.m_side, ord_v.m_quantity, ord_v.m_price,
+                                -1),
+             false);
 
   // erase the order
-  ProductMap.erase(ord_v.m_id);
+  forward_to_exchange(GatewayOrder::Kind::Delete, msg.data.orderId, ord_v);
+  erase_order(msg.data.orderId);
   resp.status = OrderResponse::Status::ACCEPTED;
   return resp;
 }
@@ -182,21 +526,35 @@ Connection::handle_order(Message<ModifyOrderQuantity> const &msg) {
   resp.messageType = OrderResponse::MESSAGE_TYPE;
   resp.orderId = msg.data.orderId;
   // Find the order and if it exists modify quantity
-  std::optional<Order> order(find_order_by_id(msg.data.orderId));
-  if (!order.has_value()) {
+  auto ord_it = m_orders.find(msg.data.orderId);
+  if (ord_it == m_orders.end() || msg.data.newQuantity > QUANTITY_MAX) {
+    resp.status = OrderResponse::Status::REJECTED;
+    return resp;
+  }
+
+  // Swap the old resting quantity for the new one, only increases are checked
+  Order &ord = ord_it->second;
+  RiskDelta delta =
+      RiskDelta::resting(ord.m_side, msg.data.newQuantity, ord.m_price, 1);
+  RiskDelta removed =
+      RiskDelta::resting(ord.m_side, ord.m_quantity, ord.m_price, -1);
+  delta.BuyQty += removed.BuyQty;
+  delta.SellQty += removed.SellQty;
+  apply_delta(delta.Exposure, removed.Exposure);
+
+  bool increases = msg.data.newQuantity > ord.m_quantity;
+  if (!apply_risk(ord.m_productId, delta, increases)) {
     resp.status = OrderResponse::Status::REJECTED;
     return resp;
   }
 
-  /**
-   * 1. Get the order
-   * 2. Check for changes in hypothetical worst pos
-   *    - get abs(ord.quat - newQuant)
-   *    - add diff to either sell or buy
-   *    - calculate pos
-   *    - either accept or reject
-   *
-   */
+  ord.m_quantity = msg.data.newQuantity;
+  if (ord.m_quantity == 0) { // nothing left to rest
+    forward_to_exchange(GatewayOrder::Kind::Delete, msg.data.orderId, ord);
+    erase_order(msg.data.orderId);
+  } else {
+    forward_to_exchange(GatewayOrder::Kind::Modify, msg.data.orderId, ord);
+  }
 
   // send response
   resp.status = OrderResponse::Status::ACCEPTED;
@@ -208,20 +566,246 @@ OrderResponse Connection::handle_order(Message<Trade> const &msg) {
   resp.messageType = OrderResponse::MESSAGE_TYPE;
   resp.orderId = msg.data.tradeId;
 
-  std::optional<Order> order(find_order_by_id(msg.data.tradeId));
-  if (!order.has_value()) {
+  // The fill must refer to a resting order on the same listing
+  auto ord_it = m_orders.find(msg.data.tradeId);
+  if (ord_it == m_orders.end() || msg.data.tradeQuantity > QUANTITY_MAX ||
+      ord_it->second.m_productId != msg.data.listingId ||
+      ord_it->second.m_quantity < msg.data.tradeQuantity) {
     resp.status = OrderResponse::Status::REJECTED;
     return resp;
   }
 
-  // Find the order and execute a trade
+  // A valid fill is applied without the limit checks, but never one that
+  // would take the position out of range
+  Order &ord = ord_it->second;
+  if (!m_context->product(ord.m_productId)
+           .fits(RiskDelta::traded(ord.m_side, msg.data.tradeQuantity))) {
+    resp.status = OrderResponse::Status::REJECTED;
+    return resp;
+  }
+  book_fill(ord.m_productId, ord.m_side, msg.data.tradeQuantity,
+            msg.data.tradeQuantity, ord.m_price, msg.data.tradePrice);
+  ord.m_quantity -= msg.data.tradeQuantity;
+  if (ord.m_quantity == 0) { // fully filled
+    erase_order(msg.data.tradeId);
+  }
 
   // send response
   resp.status = OrderResponse::Status::ACCEPTED;
   return resp;
 }
 
-std::optional<Order> Connection::find_order_by_id(int orderId) {
+bool Connection::apply_risk(uint64_t productId, RiskDelta const &delta,
+                            bool enforce) {
+  ProductInfo &current = m_context->product(productId);
+  if (enforce && !current.fits(delta)) { // a total would overflow
+    return false;
+  }
+  LimitTree const &groups = m_context->Groups;
+  ProductInfo prod = current;
+  NotionalExposure trader = m_exposure;
+  prod.apply(delta);
+  apply_delta(trader, delta.Exposure);
+
+  // listing, groups and trader are checked before anything is committed
+  Notional grossDelta =
+      notional_sub(prod.Exposure.gross(), current.Exposure.gross());
+  if (enforce && (m_context->Info.exceeds_limits(prod, trader) ||
+                  groups.exceeds_limits(prod.Group, delta.Exposure,
+                                        grossDelta))) {
+    return false;
+  }
+
+  m_context->commit(productId, current, prod, delta.Exposure, grossDelta);
+  m_exposure = trader;
+  m_context->Positions.publish_trader(m_viewSlot, m_traderId, m_exposure);
+  return true;
+}
+
+MassCancelResponse Connection::handle_order(Message<CancelAll> const &) {
+  MassCancelResponse resp;
+  resp.messageType = MassCancelResponse::MESSAGE_TYPE;
+  resp.listingId = 0;
+  resp.cancelledCount = discard_trader_state();
+  return resp;
+}
+
+size_t Connection::discard_trader_state() {
+  size_t cancelled = m_orders.size();
+  for (auto const &[listingId, orderIds] : m_listingOrders) {
+    release_listing(listingId, orderIds);
+  }
+  m_listingOrders.clear();
+  m_orders.clear();
+  Metrics::sub(Metric::RestingOrders, cancelled);
+  return cancelled;
+}
+
+MassCancelResponse
+Connection::handle_order(Message<CancelByListing> const &msg) {
+  MassCancelResponse resp;
+  resp.messageType = MassCancelResponse::MESSAGE_TYPE;
+  resp.listingId = msg.data.listingId;
+  resp.cancelledCount = 0;
+
+  auto listing_it = m_listingOrders.find(msg.data.listingId);
+  if (listing_it == m_listingOrders.end()) { // nothing rests on the listing
+    return resp;
+  }
+
+  release_listing(listing_it->first, listing_it->second);
+  for (uint64_t orderId : listing_it->second) {
+    m_orders.erase(orderId);
+  }
+  resp.cancelledCount = listing_it->second.size();
+  Metrics::sub(Metric::RestingOrders, resp.cancelledCount);
+  m_listingOrders.erase(listing_it);
+  return resp;
+}
+
+HelloResponse Connection::handle_order(Message<Hello> const &msg) {
+  uint16_t requested = msg.data.maxVersion;
+  HelloResponse resp;
+  resp.messageType = HelloResponse::MESSAGE_TYPE;
+  resp.version = std::clamp(requested, PROTOCOL_V1, PROTOCOL_MAX);
+  return resp;
+}
+
+PreCheckResponse Connection::handle_order(Message<PreCheck> const &msg) {
+  uint16_t requested = msg.data.count; // at most a full frame is evaluated
+  uint16_t count = std::min(requested, PRECHECK_MAX_ORDERS);
+  std::array<WhatIfOrder, PRECHECK_MAX_ORDERS> orders;
+  for (uint16_t i = 0; i < count; ++i) {
+    PreCheckOrder const &candidate = msg.data.orders[i];
+    orders[i] = WhatIfOrder{.ListingId = candidate.listingId,
+                            .Quantity = candidate.orderQuantity,
+                            .OrderPrice = candidate.orderPrice,
+                            .Side = candidate.side};
+  }
+  uint64_t passed = 0;
+  precheck(std::span(orders.data(), count), std::span(&passed, 1));
+
+  PreCheckResponse resp;
+  resp.messageType = PreCheckResponse::MESSAGE_TYPE;
+  resp.count = count;
+  resp.requestId = msg.data.requestId;
+  resp.passed = static_cast<uint16_t>(passed);
+  return resp;
+}
+
+void Connection::release_listing(uint64_t listingId,
+                                 std::pmr::vector<uint64_t> const &orderIds) {
+  RiskDelta delta;
+  for (uint64_t orderId : orderIds) {
+    Order const &ord = m_orders.find(orderId)->second;
+    RiskDelta released =
+        RiskDelta::resting(ord.m_side, ord.m_quantity, ord.m_price, -1);
+    delta.BuyQty += released.BuyQty;
+    delta.SellQty += released.SellQty;
+    apply_delta(delta.Exposure, released.Exposure);
+    forward_to_exchange(GatewayOrder::Kind::Delete, orderId, ord);
+  }
+
+  // Cancelling only lowers the worst positions so no limit check is needed
+  apply_risk(listingId, delta, false);
+}
+
+void Connection::book_fill(uint64_t listingId, char side, uint64_t quantity,
+                           uint64_t rested, Price orderPrice,
+                           Price tradePrice) {
+  auto position_it = m_listingPositions.try_emplace(listingId).first;
+  apply_risk(listingId,
+             RiskDelta::fill(side, quantity, rested, orderPrice, tradePrice,
+                             position_it->second),
+             false);
+  if (position_it->second.NetPos == 0) { // flat, nothing left to track
+    m_listingPositions.erase(position_it);
+  }
+}
+
+void Connection::handle_fill(GatewayFill const &fill) {
+  // The exchange executed the fill, it is booked even if the order was
+  // cancelled or reduced meanwhile. Only what still rests is released, and
+  // only from the filled order, not from a later one reusing its id.
+  ExchangeFillRecord booked = fill.record();
+  auto ord_it = m_orders.find(fill.OrderId);
+  if (ord_it != m_orders.end() &&
+      ord_it->second.m_generation == fill.Generation) {
+    Order &ord = ord_it->second;
+    booked.Rested = std::min(fill.Quantity, ord.m_quantity);
+    book_fill(ord.m_productId, ord.m_side, fill.Quantity, booked.Rested,
+              ord.m_price, fill.Price);
+    ord.m_quantity -= booked.Rested;
+    if (ord.m_quantity == 0) { // nothing rests any more
+      erase_order(fill.OrderId);
+    }
+  } else { // the order left the book, only the position moves
+    book_fill(fill.ListingId, fill.Side, fill.Quantity, 0, fill.Price,
+              fill.Price);
+  }
+  uint64_t nowNs = FastClock::now_ns();
+  m_context->Journal.append_fill(nowNs, m_traderId, booked);
+
+  Message<Trade> msg;
+  msg.data = fill.trade();
+  drop_copy(nowNs, msg.data, OrderResponse::Status::ACCEPTED);
+
+  generate_response_msg(msg); // report the execution to the trader
+  send_message(msg);
+  if (m_framePool != nullptr) {
+    flush_output(); // a failed write shows up as a hang up on the next read
+  }
+}
+
+void Connection::forward_to_exchange(GatewayOrder::Kind kind,
+                                     uint64_t orderId, Order const &ord) {
+  ExchangeGateway &gateway = m_context->Gateway;
+  if (!gateway.enabled()) {
+    return;
+  }
+
+  GatewayOrder order{.Type = kind,
+                     .Side = ord.m_side,
+                     .TraderFd = get_socket(),
+                     .TraderId = m_traderId,
+                     .OrderId = orderId,
+                     .ListingId = ord.m_productId,
+                     .Quantity = ord.m_quantity,
+                     .Price = ord.m_price,
+                     .Generation = ord.m_generation};
+  gateway.forward(order);
+}
+
+void Connection::insert_order(uint64_t orderId, Order ord) {
+  std::pmr::vector<uint64_t> &orderIds = m_listingOrders[ord.m_productId];
+  ord.m_listingPos = static_cast<uint32_t>(orderIds.size());
+  orderIds.push_back(orderId);
+  m_orders.insert(std::make_pair(orderId, ord));
+  Metrics::add(Metric::RestingOrders);
+}
+
+void Connection::erase_order(uint64_t orderId) {
+  auto ord_it = m_orders.find(orderId);
+  if (ord_it == m_orders.end()) {
+    return;
+  }
+
+  // swap the last order of the listing into the freed position
+  auto listing_it = m_listingOrders.find(ord_it->second.m_productId);
+  std::pmr::vector<uint64_t> &orderIds = listing_it->second;
+  uint32_t pos = ord_it->second.m_listingPos;
+  orderIds[pos] = orderIds.back();
+  m_orders.find(orderIds[pos])->second.m_listingPos = pos;
+  orderIds.pop_back();
+  if (orderIds.empty()) {
+    m_listingOrders.erase(listing_it);
+  }
+
+  m_orders.erase(ord_it);
+  Metrics::sub(Metric::RestingOrders);
+}
+
+std::optional<Order> Connection::find_order_by_id(uint64_t orderId) {
   auto pos = m_orders.find(orderId);
   if (pos == m_orders.end()) { // no orders for trader or wrong order
     return std::nullopt;
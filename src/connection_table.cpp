@@ -0,0 +1,47 @@
+#include "include/connection_table.h"
+
+ConnectionTable::ConnectionTable() : m_chunks(), m_size(0) {}
+
+void ConnectionTable::reserve(size_t fds) {
+  while ((m_chunks.size() << chunk_bits) < fds) {
+    m_chunks.push_back(std::make_unique<Chunk>());
+  }
+}
+
+ConnectionHandle ConnectionTable::emplace(int fd, uint32_t traderId,
+                                          RiskContext *context,
+                                          bool coroutine) {
+  size_t idx = static_cast<size_t>(fd);
+  reserve(idx + 1); // grow without moving
+
+  Slot &slot = (*m_chunks[idx >> chunk_bits])[idx & (chunk_size - 1)];
+  if (slot.Conn) {
+    ++slot.Generation;
+    --m_size;
+  }
+  slot.Conn.emplace(std::make_unique<SocketTransport>(fd), traderId, context,
+                    coroutine);
+  ++m_size;
+  return ConnectionHandle{.Fd = fd, .Generation = slot.Generation};
+}
+
+bool ConnectionTable::erase(ConnectionHandle handle) {
+  Slot *slot = find_slot(handle.Fd);
+  if (slot == nullptr || !slot->Conn ||
+      slot->Generation != handle.Generation) {
+    return false;
+  }
+
+  slot->Conn.reset(); // closes the socket unless it was released
+  ++slot->Generation; // invalidate outstanding handles
+  --m_size;
+  return true;
+}
+
+std::optional<ConnectionHandle> ConnectionTable::handle(int fd) noexcept {
+  Slot *slot = find_slot(fd);
+  if (slot == nullptr || !slot->Conn) {
+    return std::nullopt;
+  }
+  return ConnectionHandle{.Fd = fd, .Generation = slot->Generation};
+}
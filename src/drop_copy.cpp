@@ -0,0 +1,185 @@
+#include "include/drop_copy.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static constexpr int DROP_COPY_POLL_MS = 100; // how often stop is checked
+static constexpr uint64_t EVENT_SIZE = sizeof(DropCopyEvent);
+
+DropCopy::DropCopy()
+    : m_ring(), m_enabled(false), m_published(false), m_sequence(0),
+      m_event(INVALID_FD), m_listenerFd(INVALID_FD), m_subscribers(),
+      m_thread() {}
+
+DropCopy::~DropCopy() {
+  if (m_thread.joinable()) {
+    m_thread.request_stop();
+    eventfd_write(m_event, 1);
+    m_thread.join();
+  }
+  for (Subscriber const &sub : m_subscribers) {
+    close(sub.Fd);
+  }
+  for (int fd : {m_event, m_listenerFd}) {
+    if (fd != INVALID_FD) {
+      close(fd);
+    }
+  }
+}
+
+bool DropCopy::start(std::string const &endpoint) {
+  m_listenerFd = open_listener(endpoint);
+  if (m_listenerFd == INVALID_FD) {
+    return false;
+  }
+  m_event = eventfd(0, EFD_NONBLOCK);
+  if (m_event == -1) {
+    std::perror("drop copy eventfd: ");
+    m_event = INVALID_FD;
+    return false;
+  }
+  m_ring = std::make_unique<EventRing>();
+  m_enabled = true;
+  m_thread = std::jthread([this](std::stop_token stop) { run(stop); });
+  return true;
+}
+
+int DropCopy::open_listener(std::string const &endpoint) {
+  bool port = !endpoint.empty() &&
+              std::all_of(endpoint.begin(), endpoint.end(),
+                          [](unsigned char c) { return std::isdigit(c); });
+  int fd = INVALID_FD;
+  int result = -1;
+  if (port) { // TCP on the loopback interface, like the metrics endpoint
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(std::stoi(endpoint)));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int yes = 1;
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    result = fd == -1 ? -1
+                      : setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes,
+                                   sizeof(yes));
+    if (result != -1) {
+      result = bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    }
+  } else {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, endpoint.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(endpoint.c_str());
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    result = fd == -1 ? -1
+                      : bind(fd, reinterpret_cast<sockaddr *>(&addr),
+                             sizeof(addr));
+  }
+
+  if (result == -1 || listen(fd, BACK_LOG) == -1) {
+    std::perror("drop copy listen: ");
+    if (fd != -1) {
+      close(fd);
+    }
+    return INVALID_FD;
+  }
+  return fd;
+}
+
+void DropCopy::flush() noexcept {
+  if (m_published) {
+    eventfd_write(m_event, 1);
+    m_published = false;
+  }
+}
+
+void DropCopy::run(std::stop_token stop) {
+  std::vector<pollfd> fds;
+  uint64_t seen = 0; // events already counted
+  while (!stop.stop_requested()) {
+    // wait for new events, subscribers, or room on a subscriber still behind
+    uint64_t published = m_ring->published();
+    fds.clear();
+    fds.push_back({.fd = m_event, .events = POLLIN, .revents = 0});
+    fds.push_back({.fd = m_listenerFd, .events = POLLIN, .revents = 0});
+    for (Subscriber const &sub : m_subscribers) {
+      if (sub.Cursor != published * EVENT_SIZE) {
+        fds.push_back({.fd = sub.Fd, .events = POLLOUT, .revents = 0});
+      }
+    }
+    if (poll(fds.data(), fds.size(), DROP_COPY_POLL_MS) <= 0) {
+      continue;
+    }
+    if (fds[0].revents & POLLIN) {
+      eventfd_t pending = 0;
+      eventfd_read(m_event, &pending);
+    }
+
+    published = m_ring->published();
+    Metrics::add(Metric::DropCopyEvents, published - seen);
+    seen = published;
+    if (fds[1].revents & POLLIN) {
+      accept_subscribers(published);
+    }
+
+    // every subscriber is written as far as it takes, then the slots all of
+    // them have seen go back to the risk loop
+    uint64_t slowest = published;
+    std::erase_if(m_subscribers, [&](Subscriber &sub) {
+      if (!send_events(sub, published)) {
+        close(sub.Fd);
+        Metrics::add(Metric::DropCopyDetached);
+        Metrics::sub(Metric::DropCopySubscribers);
+        return true;
+      }
+      slowest = std::min(slowest, sub.Cursor / EVENT_SIZE);
+      return false;
+    });
+    m_ring->release(slowest);
+  }
+}
+
+void DropCopy::accept_subscribers(uint64_t published) {
+  DropCopyHeader header;
+  int fd;
+  while ((fd = accept4(m_listenerFd, nullptr, nullptr, SOCK_NONBLOCK)) !=
+         -1) {
+    // the header always fits the empty socket buffer
+    if (send(fd, &header, sizeof(header), MSG_NOSIGNAL) != sizeof(header)) {
+      close(fd);
+      continue;
+    }
+    m_subscribers.push_back(
+        Subscriber{.Fd = fd, .Cursor = published * EVENT_SIZE});
+    Metrics::add(Metric::DropCopySubscribers);
+  }
+}
+
+bool DropCopy::send_events(Subscriber &sub, uint64_t published) {
+  uint64_t end = published * EVENT_SIZE;
+  if (published - sub.Cursor / EVENT_SIZE > DROP_COPY_MAX_LAG) {
+    return false; // detached before it holds up the ring
+  }
+  while (sub.Cursor != end) {
+    uint64_t position = sub.Cursor / EVENT_SIZE;
+    uint64_t offset = sub.Cursor % EVENT_SIZE;
+    uint64_t events = EventRing::contiguous(position, published - position);
+    char const *data =
+        reinterpret_cast<char const *>(&m_ring->at(position)) + offset;
+    ssize_t sent = send(sub.Fd, data, events * EVENT_SIZE - offset,
+                        MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent == -1) {
+      return errno == EAGAIN || errno == EWOULDBLOCK; // full, or gone
+    }
+    sub.Cursor += static_cast<uint64_t>(sent);
+  }
+  return true;
+}
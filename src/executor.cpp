@@ -0,0 +1,153 @@
+#include "include/executor.h"
+#include "include/clock.h"
+#include "include/metrics.h"
+#include "include/server_util.h"
+#include <cstdio>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+thread_local int Executor::t_worker = -1;
+
+Executor::Executor()
+    : m_queues(), m_idleMutex(), m_idle(), m_queued(0), m_next(0),
+      m_doneMutex(), m_done(), m_doneBatch(), m_doneEvent(INVALID_FD),
+      m_threads() {}
+
+Executor::~Executor() {
+  for (std::jthread &thread : m_threads) {
+    thread.request_stop(); // queued tasks are dropped with the queues
+  }
+  m_threads.clear();
+  if (m_doneEvent != INVALID_FD) {
+    close(m_doneEvent);
+  }
+}
+
+bool Executor::start(unsigned threads) {
+  if (threads == 0) {
+    return true;
+  }
+  m_doneEvent = eventfd(0, EFD_NONBLOCK);
+  if (m_doneEvent == -1) {
+    std::perror("executor eventfd: ");
+    m_doneEvent = INVALID_FD;
+    return false;
+  }
+  for (unsigned i = 0; i < threads; ++i) {
+    m_queues.push_back(std::make_unique<WorkerQueue>());
+  }
+  for (unsigned i = 0; i < threads; ++i) {
+    m_threads.emplace_back(
+        [this, i](std::stop_token stop) { run(std::move(stop), i); });
+  }
+  return true;
+}
+
+void Executor::post(Work work) {
+  Task task{.Run = std::move(work), .PostedNs = FastClock::now_ns()};
+  if (m_threads.empty()) {
+    execute(task, false);
+    return;
+  }
+
+  unsigned queue = t_worker >= 0
+                       ? static_cast<unsigned>(t_worker)
+                       : m_next.fetch_add(1, std::memory_order_relaxed) %
+                             m_queues.size();
+  {
+    std::lock_guard<std::mutex> lock(m_queues[queue]->Mutex);
+    m_queues[queue]->Tasks.push_back(std::move(task));
+  }
+  Metrics::add(Metric::ExecutorQueued);
+  {
+    std::lock_guard<std::mutex> lock(m_idleMutex); // no lost wake up
+    m_queued.fetch_add(1, std::memory_order_relaxed);
+  }
+  m_idle.notify_one();
+}
+
+void Executor::complete(Work done) {
+  if (m_threads.empty()) { // already on the event loop
+    done();
+    Metrics::add(Metric::ExecutorCompletions);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_doneMutex);
+    m_done.push_back(std::move(done));
+  }
+  eventfd_write(m_doneEvent, 1);
+}
+
+size_t Executor::run_completions() {
+  if (m_doneEvent == INVALID_FD) {
+    return 0;
+  }
+  eventfd_t pending = 0;
+  eventfd_read(m_doneEvent, &pending);
+  {
+    std::lock_guard<std::mutex> lock(m_doneMutex);
+    m_doneBatch.swap(m_done);
+  }
+  size_t count = m_doneBatch.size();
+  for (Work &done : m_doneBatch) {
+    done();
+  }
+  m_doneBatch.clear();
+  Metrics::add(Metric::ExecutorCompletions, count);
+  return count;
+}
+
+void Executor::run(std::stop_token stop, unsigned self) {
+  t_worker = static_cast<int>(self);
+  while (!stop.stop_requested()) {
+    if (run_one(self)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_idleMutex);
+    m_idle.wait(lock, stop, [this] {
+      return m_queued.load(std::memory_order_relaxed) != 0;
+    });
+  }
+}
+
+bool Executor::run_one(unsigned self) {
+  Task task;
+  size_t workers = m_queues.size();
+  for (size_t i = 0; i < workers; ++i) {
+    WorkerQueue &queue = *m_queues[(self + i) % workers];
+    {
+      std::lock_guard<std::mutex> lock(queue.Mutex);
+      if (queue.Tasks.empty()) {
+        continue;
+      }
+      if (i == 0) { // own tasks in the order they were posted
+        task = std::move(queue.Tasks.front());
+        queue.Tasks.pop_front();
+      } else { // steal the most recent task of another worker
+        task = std::move(queue.Tasks.back());
+        queue.Tasks.pop_back();
+      }
+    }
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    Metrics::sub(Metric::ExecutorQueued);
+    execute(task, i != 0);
+    return true;
+  }
+  return false;
+}
+
+void Executor::execute(Task &task, bool stolen) {
+  uint64_t startNs = FastClock::now_ns();
+  task.Run();
+  task.Run = nullptr; // captured resources are released on this thread
+  uint64_t endNs = FastClock::now_ns();
+
+  // the clock may step back on recalibration
+  Metrics::add(Metric::ExecutorTasks);
+  Metrics::add(Metric::ExecutorTasksStolen, stolen ? 1 : 0);
+  Metrics::add(Metric::ExecutorWaitNsTotal,
+               startNs > task.PostedNs ? startNs - task.PostedNs : 0);
+  Metrics::add(Metric::ExecutorRunNsTotal,
+               endNs > startNs ? endNs - startNs : 0);
+}
@@ -0,0 +1,488 @@
+#include "include/gateway.h"
+#include "include/metrics.h"
+#include "include/protocol.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+static constexpr int GATEWAY_POLL_MS = 100; // how often stop is checked
+
+/**
+ * @brief Fill in a version 2 message and encode it.
+ * @return number of bytes written
+ */
+template <Sendable T>
+static size_t encode_v2_message(T const &payload, uint32_t sequenceNumber,
+                                char *out) {
+  Message<T> msg;
+  msg.header.version = PROTOCOL_V2;
+  msg.header.payloadSize = static_cast<uint16_t>(
+      WIRE_CODECS<T>[PROTOCOL_V2].FrameSize - sizeof(Header));
+  msg.header.sequenceNumber = sequenceNumber;
+  msg.header.timestamp = 0;
+  msg.data = payload;
+  return WIRE_CODECS<T>[PROTOCOL_V2].Encode(msg, out);
+}
+
+/**
+ * @brief Write the whole buffer, the socket is blocking.
+ * @return false if the peer went away
+ */
+static bool send_all(int fd, char const *data, size_t size) {
+  while (size != 0) {
+    ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+    if (sent <= 0) {
+      return false;
+    }
+    data += sent;
+    size -= static_cast<size_t>(sent);
+  }
+  return true;
+}
+
+/**
+ * @brief Size of the version 2 frame at the start of the buffer, 0 if not
+ * even its header has been received.
+ */
+static size_t v2_frame_size(char const *data, size_t available) {
+  if (available < sizeof(Header)) {
+    return 0;
+  }
+  return sizeof(Header) +
+         load_u16(PROTOCOL_V2, data + offsetof(Header, payloadSize));
+}
+
+MockExchange::~MockExchange() {
+  if (m_thread.joinable()) {
+    m_thread.request_stop();
+    m_thread.join();
+  }
+  if (m_fd != INVALID_FD) {
+    close(m_fd);
+  }
+}
+
+void MockExchange::start(int fd, uint32_t fillPct) {
+  m_fd = fd;
+  m_fillPct = std::min(fillPct, 100u);
+  m_thread = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+void MockExchange::run(std::stop_token stop) {
+  std::vector<char> in(GATEWAY_BUF_SIZE);
+  std::vector<char> out(2 * GATEWAY_BUF_SIZE); // two reports per order at most
+  size_t inPos = 0;
+  pollfd pfd{.fd = m_fd, .events = POLLIN, .revents = 0};
+  while (!stop.stop_requested()) {
+    if (poll(&pfd, 1, GATEWAY_POLL_MS) <= 0) {
+      continue;
+    }
+    ssize_t nbytes = recv(m_fd, in.data() + inPos, in.size() - inPos, 0);
+    if (nbytes <= 0) { // the gateway went away
+      return;
+    }
+    inPos += static_cast<size_t>(nbytes);
+
+    // answer every complete frame of the read with a single send
+    size_t rdPos = 0, outPos = 0, frameSize = 0;
+    while ((frameSize = v2_frame_size(in.data() + rdPos, inPos - rdPos)) !=
+               0 &&
+           frameSize <= inPos - rdPos) {
+      uint16_t msgType = load_u16(PROTOCOL_V2, in.data() + rdPos +
+                                                   sizeof(Header));
+      outPos += handle_frame(in.data() + rdPos, msgType, out.data() + outPos);
+      rdPos += frameSize;
+    }
+    std::memmove(in.data(), in.data() + rdPos, inPos - rdPos);
+    inPos -= rdPos;
+    if (!send_all(m_fd, out.data(), outPos)) {
+      return;
+    }
+  }
+}
+
+size_t MockExchange::handle_frame(char const *frame, uint16_t msgType,
+                                  char *out) {
+  OrderResponse ack;
+  ack.messageType = OrderResponse::MESSAGE_TYPE;
+  ack.status = OrderResponse::Status::ACCEPTED;
+  size_t written = 0;
+
+  if (msgType == NewOrder::MESSAGE_TYPE) {
+    Message<NewOrder> msg;
+    WIRE_CODECS<NewOrder>[PROTOCOL_V2].Decode(frame, msg);
+    ack.orderId = msg.data.orderId;
+    written += encode_v2_message(ack, 0, out);
+
+    uint64_t filled = msg.data.orderQuantity * m_fillPct / 100;
+    if (filled != 0) {
+      Trade fill;
+      fill.messageType = Trade::MESSAGE_TYPE;
+      fill.listingId = msg.data.listingId;
+      fill.tradeId = msg.data.orderId;
+      fill.tradeQuantity = filled;
+      fill.tradePrice = msg.data.orderPrice;
+      written += encode_v2_message(fill, 0, out + written);
+    }
+    if (filled != msg.data.orderQuantity) {
+      m_book[msg.data.orderId] = Resting{
+          .ListingId = msg.data.listingId,
+          .Quantity = msg.data.orderQuantity - filled};
+    }
+  } else if (msgType == ModifyOrderQuantity::MESSAGE_TYPE) {
+    Message<ModifyOrderQuantity> msg;
+    WIRE_CODECS<ModifyOrderQuantity>[PROTOCOL_V2].Decode(frame, msg);
+    auto it = m_book.find(msg.data.orderId);
+    ack.orderId = msg.data.orderId;
+    if (it == m_book.end()) {
+      ack.status = OrderResponse::Status::REJECTED;
+    } else {
+      it->second.Quantity = msg.data.newQuantity;
+    }
+    written += encode_v2_message(ack, 0, out);
+  } else if (msgType == DeleteOrder::MESSAGE_TYPE) {
+    Message<DeleteOrder> msg;
+    WIRE_CODECS<DeleteOrder>[PROTOCOL_V2].Decode(frame, msg);
+    ack.orderId = msg.data.orderId;
+    if (m_book.erase(msg.data.orderId) == 0) {
+      ack.status = OrderResponse::Status::REJECTED;
+    }
+    written += encode_v2_message(ack, 0, out);
+  }
+  return written;
+}
+
+ExchangeGateway::ExchangeGateway()
+    : m_outbound(), m_fills(), m_backlog(), m_enabled(false),
+      m_pushed(false), m_orderEvent(INVALID_FD), m_fillEvent(INVALID_FD),
+      m_exchangeFd(INVALID_FD), m_sequenceNumber(0), m_nextExchangeId(1),
+      m_routes(), m_exchangeIds(), m_rxPos(0), m_rxBuf(), m_txBuf(),
+      m_mock(), m_thread() {}
+
+ExchangeGateway::~ExchangeGateway() {
+  if (m_thread.joinable()) {
+    m_thread.request_stop();
+    eventfd_write(m_orderEvent, 1);
+    m_thread.join();
+  }
+  for (int fd : {m_orderEvent, m_fillEvent, m_exchangeFd}) {
+    if (fd != INVALID_FD) {
+      close(fd);
+    }
+  }
+}
+
+bool ExchangeGateway::start(std::string const &exchange,
+                            uint32_t mockFillPct) {
+  if (exchange == "mock") {
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == -1) {
+      std::perror("gateway socketpair: ");
+      return false;
+    }
+    m_exchangeFd = pair[0];
+    m_mock.start(pair[1], mockFillPct);
+  } else {
+    m_exchangeFd = connect_exchange(exchange);
+    if (m_exchangeFd == INVALID_FD) {
+      return false;
+    }
+  }
+
+  m_outbound = std::make_unique<OrderQueue>();
+  m_fills = std::make_unique<FillQueue>();
+  m_rxBuf.resize(GATEWAY_BUF_SIZE);
+  m_txBuf.resize(GATEWAY_BUF_SIZE);
+  m_orderEvent = eventfd(0, EFD_NONBLOCK);
+  m_fillEvent = eventfd(0, EFD_NONBLOCK);
+  if (m_orderEvent == -1 || m_fillEvent == -1) {
+    std::perror("gateway eventfd: ");
+    return false;
+  }
+  m_enabled = true;
+  m_thread = std::jthread([this](std::stop_token stop) { run(stop); });
+  return true;
+}
+
+int ExchangeGateway::connect_exchange(std::string const &exchange) {
+  size_t colon = exchange.rfind(':');
+  if (colon == std::string::npos) {
+    std::cerr << "gateway: expected HOST:PORT, got " << exchange << "\n";
+    return INVALID_FD;
+  }
+  std::string host = exchange.substr(0, colon);
+  std::string port = exchange.substr(colon + 1);
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *out = nullptr;
+  if (int rv = getaddrinfo(host.c_str(), port.c_str(), &hints, &out);
+      rv != 0) {
+    std::cerr << "gateway getaddrinfo error: " << gai_strerror(rv) << "\n";
+    return INVALID_FD;
+  }
+
+  int fd = INVALID_FD;
+  for (addrinfo *ptr = out; ptr != nullptr; ptr = ptr->ai_next) {
+    fd = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+    if (fd == -1) {
+      fd = INVALID_FD;
+      continue;
+    }
+    if (connect(fd, ptr->ai_addr, ptr->ai_addrlen) == 0) {
+      break;
+    }
+    close(fd);
+    fd = INVALID_FD;
+  }
+  freeaddrinfo(out);
+
+  if (fd == INVALID_FD) {
+    std::cerr << "gateway: cannot connect to " << exchange << "\n";
+    return INVALID_FD;
+  }
+  int yes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  return fd;
+}
+
+void ExchangeGateway::run(std::stop_token stop) {
+  std::array<pollfd, 2> fds{
+      {{.fd = m_orderEvent, .events = POLLIN, .revents = 0},
+       {.fd = m_exchangeFd, .events = POLLIN, .revents = 0}}};
+  bool connected = true;
+  while (!stop.stop_requested()) {
+    if (poll(fds.data(), connected ? fds.size() : 1, GATEWAY_POLL_MS) <= 0) {
+      continue;
+    }
+    if (fds[0].revents & POLLIN) {
+      eventfd_t pending = 0;
+      eventfd_read(m_orderEvent, &pending);
+    }
+    if (connected && !send_orders()) {
+      std::cerr << "gateway: lost the exchange connection\n";
+      connected = false;
+    }
+    if (connected && (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) &&
+        !read_reports()) {
+      std::cerr << "gateway: lost the exchange connection\n";
+      connected = false;
+    }
+    if (!connected) { // orders can no longer reach the exchange
+      GatewayOrder order;
+      while (m_outbound->try_pop(order)) {
+        Metrics::add(Metric::GatewayDropped);
+      }
+    }
+  }
+}
+
+bool ExchangeGateway::send_orders() {
+  GatewayOrder order;
+  size_t txPos = 0, batch = 0;
+  static constexpr size_t MAX_FRAME = 64; // larger than any order frame
+  while (true) {
+    bool popped =
+        txPos + MAX_FRAME <= m_txBuf.size() && m_outbound->try_pop(order);
+    if (popped) {
+      size_t written = encode_order(order, m_txBuf.data() + txPos);
+      txPos += written;
+      batch += written != 0;
+      continue;
+    }
+    if (txPos == 0) {
+      return true;
+    }
+    if (!write_exchange(m_txBuf.data(), txPos)) {
+      return false;
+    }
+    Metrics::add(Metric::GatewayOrders, batch);
+    txPos = 0;
+    batch = 0;
+  }
+}
+
+bool ExchangeGateway::write_exchange(char const *data, size_t size) {
+  while (size != 0) {
+    ssize_t sent = send(m_exchangeFd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent > 0) {
+      data += sent;
+      size -= static_cast<size_t>(sent);
+      continue;
+    }
+    if (sent == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      return false;
+    }
+
+    // the exchange may be waiting for us to read its reports
+    pollfd pfd{.fd = m_exchangeFd, .events = POLLIN | POLLOUT, .revents = 0};
+    if (poll(&pfd, 1, GATEWAY_POLL_MS) > 0 && (pfd.revents & POLLIN) &&
+        !read_reports()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t ExchangeGateway::encode_order(GatewayOrder const &order, char *out) {
+  if (order.Type == GatewayOrder::Kind::New) {
+    uint64_t exchangeId = m_nextExchangeId++;
+    m_exchangeIds[order.TraderId][order.OrderId] = exchangeId;
+    m_routes[exchangeId] = Route{.TraderFd = order.TraderFd,
+                                 .TraderId = order.TraderId,
+                                 .OrderId = order.OrderId,
+                                 .ListingId = order.ListingId,
+                                 .Remaining = order.Quantity,
+                                 .Unacked = 1,
+                                 .Generation = order.Generation,
+                                 .Side = order.Side};
+
+    NewOrder payload;
+    payload.messageType = NewOrder::MESSAGE_TYPE;
+    payload.listingId = order.ListingId;
+    payload.orderId = exchangeId;
+    payload.orderQuantity = order.Quantity;
+    payload.orderPrice = order.Price;
+    payload.side = order.Side;
+    return encode_v2_message(payload, m_sequenceNumber++, out);
+  }
+
+  // the exchange never saw the order
+  auto trader_it = m_exchangeIds.find(order.TraderId);
+  if (trader_it == m_exchangeIds.end() ||
+      !trader_it->second.contains(order.OrderId)) {
+    Metrics::add(Metric::GatewayDropped);
+    return 0;
+  }
+  std::unordered_map<uint64_t, uint64_t> &ids = trader_it->second;
+  auto id_it = ids.find(order.OrderId);
+  uint64_t exchangeId = id_it->second;
+  Route &route = m_routes[exchangeId];
+  ++route.Unacked;
+  if (order.Type == GatewayOrder::Kind::Modify) {
+    route.Remaining = order.Quantity;
+    ModifyOrderQuantity payload;
+    payload.messageType = ModifyOrderQuantity::MESSAGE_TYPE;
+    payload.orderId = exchangeId;
+    payload.newQuantity = order.Quantity;
+    return encode_v2_message(payload, m_sequenceNumber++, out);
+  }
+
+  // the order id may be reused right away, fills racing the cancel still
+  // follow the route until the exchange acknowledges it
+  ids.erase(id_it);
+  if (ids.empty()) { // the trader has nothing open at the exchange
+    m_exchangeIds.erase(trader_it);
+  }
+  route.Cancelled = true;
+  DeleteOrder payload;
+  payload.messageType = DeleteOrder::MESSAGE_TYPE;
+  payload.orderId = exchangeId;
+  return encode_v2_message(payload, m_sequenceNumber++, out);
+}
+
+bool ExchangeGateway::read_reports() {
+  ssize_t nbytes = recv(m_exchangeFd, m_rxBuf.data() + m_rxPos,
+                        m_rxBuf.size() - m_rxPos, 0);
+  if (nbytes <= 0) {
+    return false;
+  }
+  m_rxPos += static_cast<uint32_t>(nbytes);
+
+  size_t rdPos = 0, frameSize = 0, fills = 0;
+  while ((frameSize = v2_frame_size(m_rxBuf.data() + rdPos,
+                                    m_rxPos - rdPos)) != 0 &&
+         frameSize <= m_rxPos - rdPos) {
+    char const *frame = m_rxBuf.data() + rdPos;
+    if (frameSize == WIRE_CODECS<Trade>[PROTOCOL_V2].FrameSize &&
+        load_u16(PROTOCOL_V2, frame + sizeof(Header)) == Trade::MESSAGE_TYPE) {
+      Message<Trade> msg;
+      WIRE_CODECS<Trade>[PROTOCOL_V2].Decode(frame, msg);
+      route_fill(msg.data.tradeId, msg.data.tradeQuantity,
+                 msg.data.tradePrice);
+      ++fills;
+    } else if (frameSize == WIRE_CODECS<OrderResponse>[PROTOCOL_V2].FrameSize &&
+               load_u16(PROTOCOL_V2, frame + sizeof(Header)) ==
+                   OrderResponse::MESSAGE_TYPE) {
+      Message<OrderResponse> msg;
+      WIRE_CODECS<OrderResponse>[PROTOCOL_V2].Decode(frame, msg);
+      acknowledge(msg.data.orderId);
+    }
+    rdPos += frameSize;
+  }
+  std::memmove(m_rxBuf.data(), m_rxBuf.data() + rdPos, m_rxPos - rdPos);
+  m_rxPos -= static_cast<uint32_t>(rdPos);
+
+  if (fills != 0) { // one wake up of the risk loop per read
+    eventfd_write(m_fillEvent, 1);
+  }
+  return true;
+}
+
+void ExchangeGateway::route_fill(uint64_t exchangeId, uint64_t quantity,
+                                 uint64_t price) {
+  auto route_it = m_routes.find(exchangeId);
+  if (route_it == m_routes.end()) {
+    Metrics::add(Metric::GatewayDropped);
+    return;
+  }
+
+  Route &route = route_it->second;
+  GatewayFill fill{.TraderFd = route.TraderFd,
+                   .TraderId = route.TraderId,
+                   .OrderId = route.OrderId,
+                   .ListingId = route.ListingId,
+                   .Quantity = quantity,
+                   .Price = price,
+                   .Side = route.Side,
+                   .Generation = route.Generation};
+  while (!m_fills->try_push(fill)) { // let the risk loop catch up
+    eventfd_write(m_fillEvent, 1);
+    std::this_thread::yield();
+  }
+  Metrics::add(Metric::GatewayFills);
+
+  route.Remaining -= std::min(route.Remaining, quantity);
+  if (route.Remaining == 0 && route.Unacked == 0) { // fully filled
+    end_route(route_it);
+  }
+}
+
+void ExchangeGateway::acknowledge(uint64_t exchangeId) {
+  auto route_it = m_routes.find(exchangeId);
+  if (route_it == m_routes.end()) {
+    return;
+  }
+
+  Route &route = route_it->second;
+  route.Unacked -= std::min(route.Unacked, 1u);
+  if (route.Unacked == 0 && (route.Cancelled || route.Remaining == 0)) {
+    end_route(route_it);
+  }
+}
+
+void ExchangeGateway::end_route(RouteMap::iterator route_it) {
+  Route const &route = route_it->second;
+  auto trader_it = m_exchangeIds.find(route.TraderId);
+  if (trader_it != m_exchangeIds.end()) {
+    std::unordered_map<uint64_t, uint64_t> &ids = trader_it->second;
+    auto id_it = ids.find(route.OrderId);
+    if (id_it != ids.end() && id_it->second == route_it->first) {
+      ids.erase(id_it); // the order id may be reused
+    }
+    if (ids.empty()) { // the trader has nothing open at the exchange
+      m_exchangeIds.erase(trader_it);
+    }
+  }
+  m_routes.erase(route_it);
+}
@@ -0,0 +1,68 @@
+#include "include/hot_memory.h"
+#include <cstdio>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+HotMemory::HotMemory(size_t bytes, HugePageMode pages)
+    : m_mapping(nullptr), m_mappingSize(0), m_size(0), m_hugeTlb(false),
+      m_arena(), m_pool() {
+  if (bytes == 0) {
+    return;
+  }
+
+  size_t size = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+  char *region = nullptr;
+  if (pages == HugePageMode::Explicit) {
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapping == MAP_FAILED) { // no huge pages reserved, use normal ones
+      std::perror("hot memory mmap MAP_HUGETLB: ");
+    } else {
+      m_mapping = mapping;
+      m_mappingSize = size;
+      m_hugeTlb = true;
+      region = static_cast<char *>(mapping);
+    }
+  }
+
+  if (region == nullptr) {
+    // one extra huge page so the region can start on a huge page boundary,
+    // transparent huge pages only back aligned 2MB ranges
+    size_t mappingSize = size + HUGE_PAGE_SIZE;
+    void *mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      std::perror("hot memory mmap: ");
+      return;
+    }
+    m_mapping = mapping;
+    m_mappingSize = mappingSize;
+    uintptr_t start = reinterpret_cast<uintptr_t>(mapping);
+    region = reinterpret_cast<char *>((start + HUGE_PAGE_SIZE - 1) &
+                                      ~(HUGE_PAGE_SIZE - 1));
+    if (pages == HugePageMode::Transparent &&
+        madvise(region, size, MADV_HUGEPAGE) == -1) {
+      std::perror("hot memory madvise: ");
+    }
+  }
+
+  // fault every page in now instead of on the first orders
+  size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  for (size_t offset = 0; offset < size; offset += pageSize) {
+    static_cast<char volatile *>(region)[offset] = 0;
+  }
+
+  m_size = size;
+  m_arena.emplace(region, size, std::pmr::new_delete_resource());
+  m_pool.emplace(&*m_arena);
+}
+
+HotMemory::~HotMemory() {
+  m_pool.reset(); // gives its blocks back to the arena first
+  m_arena.reset();
+  if (m_mapping != nullptr) {
+    munmap(m_mapping, m_mappingSize);
+  }
+}
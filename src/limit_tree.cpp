@@ -0,0 +1,118 @@
+#include "include/limit_tree.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+/// Parse a notional limit, - for none
+static bool parse_limit(std::string const &token, Notional &limit) {
+  if (token == "-") {
+    limit = NOTIONAL_MAX;
+    return true;
+  }
+  try {
+    size_t used = 0;
+    limit = std::stoll(token, &used);
+    return used == token.size() && limit >= 0;
+  } catch (std::exception const &) {
+    return false;
+  }
+}
+
+bool LimitTree::load(std::string const &path) {
+  std::ifstream in(path);
+  if (!in) {
+    std::perror("limit tree open: ");
+    return false;
+  }
+
+  std::string line;
+  for (size_t lineNo = 1; std::getline(in, line); ++lineNo) {
+    std::istringstream fields(line);
+    std::string kind;
+    if (!(fields >> kind) || kind[0] == '#') {
+      continue;
+    }
+
+    bool valid = false;
+    std::string extra;
+    if (kind == "group") {
+      std::string name, parent, gross, net;
+      Notional grossLimit = 0;
+      Notional netLimit = 0;
+      if (fields >> name >> parent >> gross >> net && !(fields >> extra) &&
+          name != "-" &&
+          parse_limit(gross, grossLimit) && parse_limit(net, netLimit)) {
+        auto parentIt = m_byName.find(parent);
+        uint32_t parentGroup =
+            parentIt == m_byName.end() ? NO_GROUP : parentIt->second;
+        valid = (parent == "-" || parentGroup != NO_GROUP) &&
+                add_group(name, parentGroup, grossLimit, netLimit) != NO_GROUP;
+      }
+    } else if (kind == "listing") {
+      uint64_t listingId = 0;
+      std::string group;
+      if (fields >> listingId >> group && !(fields >> extra)) {
+        auto groupIt = m_byName.find(group);
+        valid = groupIt != m_byName.end() &&
+                assign_listing(listingId, groupIt->second);
+      }
+    }
+
+    if (!valid) {
+      std::cerr << path << ":" << lineNo << ": invalid group limit line\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t LimitTree::add_group(std::string const &name, uint32_t parent,
+                              Notional grossLimit, Notional netLimit) {
+  if (m_byName.contains(name) ||
+      (parent != NO_GROUP && parent >= m_nodes.size())) {
+    return NO_GROUP;
+  }
+  uint32_t depth = 1;
+  for (uint32_t group = parent; group != NO_GROUP;
+       group = m_nodes[group].Parent) {
+    ++depth;
+  }
+  if (depth > MAX_GROUP_DEPTH) {
+    return NO_GROUP;
+  }
+
+  uint32_t group = static_cast<uint32_t>(m_nodes.size());
+  m_nodes.push_back(GroupNode{.Parent = parent,
+                              .GrossLimit = grossLimit,
+                              .NetLimit = netLimit,
+                              .Gross = 0,
+                              .Exposure = {}});
+  m_names.push_back(name);
+  m_byName.emplace(name, group);
+  return group;
+}
+
+bool LimitTree::update_limits(LimitTree const &loaded) {
+  if (loaded.m_names != m_names || loaded.m_listingGroup != m_listingGroup) {
+    return false;
+  }
+  for (size_t group = 0; group < m_nodes.size(); ++group) {
+    if (loaded.m_nodes[group].Parent != m_nodes[group].Parent) {
+      return false;
+    }
+  }
+  for (size_t group = 0; group < m_nodes.size(); ++group) {
+    m_nodes[group].GrossLimit = loaded.m_nodes[group].GrossLimit;
+    m_nodes[group].NetLimit = loaded.m_nodes[group].NetLimit;
+  }
+  return true;
+}
+
+bool LimitTree::assign_listing(uint64_t listingId, uint32_t group) {
+  if (group >= m_nodes.size()) {
+    return false;
+  }
+  m_listingGroup[listingId] = group;
+  return true;
+}
@@ -0,0 +1,234 @@
+#include "include/metrics.h"
+#include "include/orders.h"
+#include <arpa/inet.h>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+thread_local MetricsBlock *Metrics::t_block = nullptr;
+
+static constexpr int METRICS_BACK_LOG = 8;
+/// How long a scrape may take to send its request or read the response, a
+/// stalled client cannot hold the scrape thread and shutdown for longer
+static constexpr timeval METRICS_CLIENT_TIMEOUT{.tv_sec = 1, .tv_usec = 0};
+static std::mutex s_registryMutex;
+static std::vector<std::unique_ptr<MetricsBlock>> s_registry;
+
+struct MetricInfo {
+  char const *Name;
+  char const *Labels;
+  char const *Type;
+  char const *Help;
+};
+
+// Indexed by Metric, metrics sharing a name must be consecutive
+static constexpr std::array<MetricInfo, static_cast<size_t>(Metric::Count)>
+    s_metricInfo{{
+        {"risk_messages_total", "type=\"new_order\"", "counter",
+         "Requests received by message type"},
+        {"risk_messages_total", "type=\"delete_order\"", "counter", ""},
+        {"risk_messages_total", "type=\"modify_order_quantity\"", "counter",
+         ""},
+        {"risk_messages_total", "type=\"trade\"", "counter", ""},
+        {"risk_messages_total", "type=\"cancel_all\"", "counter", ""},
+        {"risk_messages_total", "type=\"cancel_by_listing\"", "counter", ""},
+        {"risk_messages_total", "type=\"hello\"", "counter", ""},
+        {"risk_messages_total", "type=\"pre_check\"", "counter", ""},
+        {"risk_messages_total", "type=\"unknown\"", "counter", ""},
+        {"risk_responses_total", "status=\"accepted\"", "counter",
+         "Order responses by status"},
+        {"risk_responses_total", "status=\"rejected\"", "counter", ""},
+        {"risk_responses_total", "status=\"throttled\"", "counter", ""},
+        {"risk_responses_total", "status=\"overloaded\"", "counter", ""},
+        {"risk_bytes_in_total", "", "counter", "Bytes read from traders"},
+        {"risk_bytes_out_total", "", "counter", "Bytes sent to traders"},
+        {"risk_sessions_accepted_total", "", "counter",
+         "Trader sessions accepted"},
+        {"risk_sessions_closed_total", "", "counter", "Trader sessions closed"},
+        {"risk_sessions_evicted_total", "", "counter",
+         "Trader sessions evicted for missing their heartbeat"},
+        {"risk_loop_iterations_total", "", "counter",
+         "Event loop iterations"},
+        {"risk_loop_time_ns_total", "", "counter",
+         "Time spent serving event loop iterations"},
+        {"risk_gateway_orders_total", "", "counter",
+         "Orders sent to the exchange"},
+        {"risk_gateway_fills_total", "", "counter",
+         "Fills received from the exchange"},
+        {"risk_gateway_dropped_total", "", "counter",
+         "Orders and fills the gateway could not route"},
+        {"risk_executor_tasks_total", "", "counter",
+         "Slow path tasks run by the executor"},
+        {"risk_executor_tasks_stolen_total", "", "counter",
+         "Slow path tasks run by a worker that stole them"},
+        {"risk_executor_task_wait_ns_total", "", "counter",
+         "Time slow path tasks spent queued"},
+        {"risk_executor_task_run_ns_total", "", "counter",
+         "Time spent running slow path tasks"},
+        {"risk_executor_completions_total", "", "counter",
+         "Completions run on the event loop"},
+        {"risk_drop_copy_events_total", "", "counter",
+         "Risk decisions copied to the drop copy feed"},
+        {"risk_drop_copy_lost_total", "", "counter",
+         "Risk decisions that did not fit the drop copy ring"},
+        {"risk_drop_copy_detached_total", "", "counter",
+         "Drop copy subscribers detached for falling behind or leaving"},
+        {"risk_active_sessions", "", "gauge", "Connected trader sessions"},
+        {"risk_resting_orders", "", "gauge", "Resting orders of all traders"},
+        {"risk_loop_time_ns", "", "gauge",
+         "Duration of the last event loop iteration"},
+        {"risk_executor_queued", "", "gauge",
+         "Slow path tasks waiting for a worker"},
+        {"risk_drop_copy_subscribers", "", "gauge",
+         "Connected drop copy subscribers"},
+        {"risk_gateway_backlog", "", "gauge",
+         "Orders waiting for room in the gateway queue"},
+        {"risk_pipeline_events_total", "stage=\"recv\"", "counter",
+         "Pipeline hooks hit by stage, counters and trace builds only"},
+        {"risk_pipeline_events_total", "stage=\"decode\"", "counter", ""},
+        {"risk_pipeline_events_total", "stage=\"decision\"", "counter", ""},
+        {"risk_pipeline_events_total", "stage=\"send\"", "counter", ""},
+    }};
+
+MetricsBlock *Metrics::register_thread() {
+  std::lock_guard<std::mutex> lock(s_registryMutex);
+  s_registry.push_back(std::make_unique<MetricsBlock>());
+  return s_registry.back().get();
+}
+
+Metric Metrics::message_metric(uint16_t messageType) noexcept {
+  switch (messageType) {
+  case NewOrder::MESSAGE_TYPE:
+    return Metric::MessagesNewOrder;
+  case DeleteOrder::MESSAGE_TYPE:
+    return Metric::MessagesDeleteOrder;
+  case ModifyOrderQuantity::MESSAGE_TYPE:
+    return Metric::MessagesModifyOrderQuantity;
+  case Trade::MESSAGE_TYPE:
+    return Metric::MessagesTrade;
+  case CancelAll::MESSAGE_TYPE:
+    return Metric::MessagesCancelAll;
+  case CancelByListing::MESSAGE_TYPE:
+    return Metric::MessagesCancelByListing;
+  case Hello::MESSAGE_TYPE:
+    return Metric::MessagesHello;
+  case PreCheck::MESSAGE_TYPE:
+    return Metric::MessagesPreCheck;
+  default:
+    return Metric::MessagesUnknown;
+  }
+}
+
+Metric Metrics::response_metric(uint16_t status) noexcept {
+  switch (static_cast<OrderResponse::Status>(status)) {
+  case OrderResponse::Status::ACCEPTED:
+    return Metric::ResponsesAccepted;
+  case OrderResponse::Status::THROTTLED:
+    return Metric::ResponsesThrottled;
+  case OrderResponse::Status::OVERLOADED:
+    return Metric::ResponsesOverloaded;
+  default:
+    return Metric::ResponsesRejected;
+  }
+}
+
+std::string Metrics::render() {
+  std::array<uint64_t, static_cast<size_t>(Metric::Count)> totals{};
+  {
+    std::lock_guard<std::mutex> lock(s_registryMutex);
+    for (auto const &block : s_registry) {
+      for (size_t idx = 0; idx != totals.size(); ++idx) {
+        totals[idx] += block->Values[idx].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::ostringstream out;
+  char const *lastName = "";
+  for (size_t idx = 0; idx != totals.size(); ++idx) {
+    MetricInfo const &info = s_metricInfo[idx];
+    if (std::strcmp(info.Name, lastName) != 0) {
+      out << "# HELP " << info.Name << " " << info.Help << "\n";
+      out << "# TYPE " << info.Name << " " << info.Type << "\n";
+      lastName = info.Name;
+    }
+
+    out << info.Name;
+    if (*info.Labels != '\0') {
+      out << "{" << info.Labels << "}";
+    }
+    if (std::strcmp(info.Type, "gauge") == 0) {
+      out << " " << static_cast<int64_t>(totals[idx]) << "\n";
+    } else {
+      out << " " << totals[idx] << "\n";
+    }
+  }
+  return out.str();
+}
+
+bool MetricsEndpoint::start(std::string const &port) {
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(std::stoi(port)));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  int yes = 1;
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener == -1 ||
+      setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) ==
+          -1 ||
+      bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ==
+          -1 ||
+      ::listen(listener, METRICS_BACK_LOG) == -1) {
+    std::perror("metrics endpoint: ");
+    if (listener != -1) {
+      close(listener);
+    }
+    return false;
+  }
+
+  m_thread = std::jthread([listener](std::stop_token stop) {
+    pollfd pfd{.fd = listener, .events = POLLIN, .revents = 0};
+    while (!stop.stop_requested()) {
+      if (poll(&pfd, 1, 200) <= 0) { // wake up to check for stop
+        continue;
+      }
+      int client = accept(listener, nullptr, nullptr);
+      if (client == -1) {
+        continue;
+      }
+      setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &METRICS_CLIENT_TIMEOUT,
+                 sizeof(METRICS_CLIENT_TIMEOUT));
+      setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &METRICS_CLIENT_TIMEOUT,
+                 sizeof(METRICS_CLIENT_TIMEOUT));
+
+      char request[1024];
+      (void)recv(client, request, sizeof(request), 0); // contents ignored
+      std::string body = Metrics::render();
+      std::string response =
+          "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+          "Content-Length: " +
+          std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+      size_t sent = 0;
+      while (sent < response.size()) {
+        ssize_t n = send(client, response.data() + sent,
+                         response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+          break;
+        }
+        sent += n;
+      }
+      close(client);
+    }
+    close(listener);
+  });
+  return true;
+}
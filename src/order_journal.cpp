@@ -0,0 +1,85 @@
+#include "include/order_journal.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+OrderJournal::OrderJournal()
+    : m_buffer(), m_mutex(), m_cv(), m_pending(), m_fd(INVALID_FD),
+      m_thread() {}
+
+OrderJournal::~OrderJournal() {
+  if (m_thread.joinable()) {
+    flush();
+    m_thread.request_stop();
+    m_thread.join();
+  }
+  if (m_fd != INVALID_FD) {
+    write_out(m_pending); // left behind when the writer stopped
+    close(m_fd);
+  }
+}
+
+bool OrderJournal::open(std::string const &path) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    std::perror("journal open: ");
+    return false;
+  }
+  m_fd = fd;
+
+  OrderLogHeader header;
+  char const *bytes = reinterpret_cast<char const *>(&header);
+  write_out(std::vector<char>(bytes, bytes + sizeof(header)));
+  m_thread = std::jthread([this](std::stop_token stop) { run(stop); });
+  return true;
+}
+
+void OrderJournal::append_fill(uint64_t timestampNs, uint32_t traderId,
+                               ExchangeFillRecord const &fill) {
+  append(timestampNs, traderId, ORDER_LOG_EXCHANGE_FILL,
+         reinterpret_cast<char const *>(&fill), sizeof(fill));
+}
+
+void OrderJournal::flush() {
+  if (m_buffer.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending.empty()) {
+      m_pending.swap(m_buffer);
+    } else { // the writer fell behind, keep the order of the records
+      m_pending.insert(m_pending.end(), m_buffer.begin(), m_buffer.end());
+    }
+  }
+  m_buffer.clear();
+  m_cv.notify_one();
+}
+
+void OrderJournal::run(std::stop_token stop) {
+  std::vector<char> records;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, stop, [this]() { return !m_pending.empty(); });
+      if (m_pending.empty()) { // stop requested and nothing left
+        return;
+      }
+      records.swap(m_pending);
+    }
+    write_out(records);
+    records.clear();
+  }
+}
+
+void OrderJournal::write_out(std::vector<char> const &records) {
+  size_t written = 0;
+  while (written != records.size()) {
+    ssize_t n = write(m_fd, records.data() + written, records.size() - written);
+    if (n == -1) {
+      std::perror("journal write: ");
+      return;
+    }
+    written += static_cast<size_t>(n);
+  }
+}
@@ -1,4 +1,5 @@
 #include "include/orders.h"
+#include "include/fixed_point.h"
 #include <iomanip>
 
 // Printing to ostream
@@ -16,7 +17,7 @@ std::ostream &operator<<(std::ostream &out, NewOrder const &h) {
       << "\nListingId: " << h.listingId << "\nOrderId: " << h.orderId
       << "\nOrderQuantity: " << h.orderQuantity
       << "\nOrderPrice: " << std::setprecision(4) << std::fixed
-      << static_cast<double>(h.orderPrice) / 10000.00 << std::endl;
+      << fixed_to_double(h.orderPrice) << std::endl;
   return out;
 }
 
@@ -41,14 +42,74 @@ std::ostream &operator<<(std::ostream &out, Trade const &h) {
       << "\nListingId: " << h.listingId << "\nTradeId: " << h.tradeId
       << "\nTradeQuantity: " << h.tradeQuantity
       << "\nTradePrice: " << std::setprecision(4) << std::fixed
-      << static_cast<double>(h.tradePrice) / 10000.00 << std::endl;
+      << fixed_to_double(h.tradePrice) << std::endl;
   return out;
 }
 
 std::ostream &operator<<(std::ostream &out, OrderResponse const &h) {
+  char const *status = "REJECTED";
+  switch (h.status) {
+  case OrderResponse::Status::ACCEPTED:
+    status = "ACCEPTED";
+    break;
+  case OrderResponse::Status::THROTTLED:
+    status = "THROTTLED";
+    break;
+  case OrderResponse::Status::OVERLOADED:
+    status = "OVERLOADED";
+    break;
+  default:
+    break;
+  }
   out << "MesageType: " << OrderResponse::MESSAGE_TYPE
-      << "\nOrderId: " << h.orderId << "\nStatus: "
-      << (h.status == OrderResponse::Status::ACCEPTED ? "ACCEPTED"
-                                                      : "REJECTED");
+      << "\nOrderId: " << h.orderId << "\nStatus: " << status;
+  return out;
+}
+
+std::ostream &operator<<(std::ostream &out, CancelAll const &) {
+  out << "CancelAll:\n";
+  out << "MessageType: " << CancelAll::MESSAGE_TYPE << std::endl;
+  return out;
+}
+
+std::ostream &operator<<(std::ostream &out, CancelByListing const &h) {
+  out << "CancelByListing:\n";
+  out << "MessageType: " << CancelByListing::MESSAGE_TYPE
+      << "\nListingId: " << h.listingId << std::endl;
+  return out;
+}
+
+std::ostream &operator<<(std::ostream &out, MassCancelResponse const &h) {
+  out << "MessageType: " << MassCancelResponse::MESSAGE_TYPE
+      << "\nListingId: " << h.listingId
+      << "\nCancelledCount: " << h.cancelledCount;
+  return out;
+}
+
+std::ostream &operator<<(std::ostream &out, Hello const &h) {
+  out << "Hello:\n";
+  out << "MessageType: " << Hello::MESSAGE_TYPE
+      << "\nMaxVersion: " << h.maxVersion << std::endl;
+  return out;
+}
+
+std::ostream &operator<<(std::ostream &out, HelloResponse const &h) {
+  out << "MessageType: " << HelloResponse::MESSAGE_TYPE
+      << "\nVersion: " << h.version;
+  return out;
+}
+
+std::ostream &operator<<(std::ostream &out, PreCheck const &h) {
+  out << "PreCheck:\n";
+  out << "MessageType: " << PreCheck::MESSAGE_TYPE
+      << "\nRequestId: " << h.requestId << "\nCount: " << h.count
+      << std::endl;
+  return out;
+}
+
+std::ostream &operator<<(std::ostream &out, PreCheckResponse const &h) {
+  out << "MessageType: " << PreCheckResponse::MESSAGE_TYPE
+      << "\nRequestId: " << h.requestId << "\nCount: " << h.count
+      << "\nPassed: " << std::hex << h.passed << std::dec;
   return out;
 }
@@ -0,0 +1,183 @@
+#include "include/position_view.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A busy slot is only held for a handful of stores, a reader that keeps
+// seeing it busy is looking at a writer that died mid update
+static constexpr int MAX_READ_RETRIES = 1000;
+
+static size_t view_size(uint32_t productSlots, uint32_t traderSlots) {
+  return sizeof(PositionViewHeader) +
+         (static_cast<size_t>(productSlots) + traderSlots) *
+             sizeof(PositionSlot);
+}
+
+PositionView::PositionView()
+    : m_header(nullptr), m_products(nullptr), m_traders(nullptr),
+      m_mapSize(0), m_freeTraders() {}
+
+PositionView::~PositionView() {
+  if (m_header != nullptr) {
+    munmap(m_header, m_mapSize);
+  }
+}
+
+bool PositionView::create(std::string const &path, uint32_t productSlots,
+                          uint32_t traderSlots) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    std::perror("position view open: ");
+    return false;
+  }
+
+  size_t size = view_size(productSlots, traderSlots);
+  if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+    std::perror("position view ftruncate: ");
+    close(fd);
+    return false;
+  }
+
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the file referenced
+  if (base == MAP_FAILED) {
+    std::perror("position view mmap: ");
+    return false;
+  }
+
+  // the file is zero filled, which is the initial state of every slot
+  m_mapSize = size;
+  m_header = new (base) PositionViewHeader();
+  m_header->ProductSlots = productSlots;
+  m_header->TraderSlots = traderSlots;
+  m_products = reinterpret_cast<PositionSlot *>(m_header + 1);
+  m_traders = m_products + productSlots;
+  m_header->Magic.store(POSITION_VIEW_MAGIC, std::memory_order_release);
+  return true;
+}
+
+void PositionView::release_trader(uint32_t slot) noexcept {
+  if (m_header == nullptr || slot == NO_VIEW_SLOT) {
+    return;
+  }
+  m_traders[slot].store(PositionRecord{});
+  m_freeTraders.push_back(slot);
+}
+
+void PositionView::add_product(uint64_t productId,
+                               ProductInfo &prod) noexcept {
+  uint32_t count = m_header->ProductCount.load(std::memory_order_relaxed);
+  if (count == m_header->ProductSlots) {
+    m_header->Dropped.fetch_add(1, std::memory_order_relaxed);
+    return; // retried on the next change of the product
+  }
+
+  // the record is stored before the count grows so readers never see an
+  // empty slot
+  prod.ViewSlot = count;
+  m_products[count].store(product_record(productId, prod));
+  m_header->ProductCount.store(count + 1, std::memory_order_release);
+}
+
+bool PositionView::assign_trader(uint32_t &slot) noexcept {
+  if (!m_freeTraders.empty()) {
+    slot = m_freeTraders.back();
+    m_freeTraders.pop_back();
+    return true;
+  }
+
+  uint32_t count = m_header->TraderCount.load(std::memory_order_relaxed);
+  if (count == m_header->TraderSlots) {
+    m_header->Dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  slot = count;
+  m_header->TraderCount.store(count + 1, std::memory_order_release);
+  return true;
+}
+
+PositionViewReader::PositionViewReader()
+    : m_base(nullptr), m_mapSize(0), m_header(nullptr), m_products(nullptr),
+      m_traders(nullptr) {}
+
+PositionViewReader::~PositionViewReader() {
+  if (m_base != nullptr) {
+    munmap(m_base, m_mapSize);
+  }
+}
+
+bool PositionViewReader::open(std::string const &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    std::perror("position view open: ");
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 ||
+      static_cast<size_t>(st.st_size) < sizeof(PositionViewHeader)) {
+    std::fprintf(stderr, "%s is not a position view\n", path.c_str());
+    close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void *base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    std::perror("position view mmap: ");
+    return false;
+  }
+
+  auto const *header = static_cast<PositionViewHeader const *>(base);
+  if (header->Magic.load(std::memory_order_acquire) != POSITION_VIEW_MAGIC ||
+      header->Version != POSITION_VIEW_VERSION ||
+      size < view_size(header->ProductSlots, header->TraderSlots)) {
+    std::fprintf(stderr, "%s is not a position view\n", path.c_str());
+    munmap(base, size);
+    return false;
+  }
+
+  m_base = base;
+  m_mapSize = size;
+  m_header = header;
+  m_products = reinterpret_cast<PositionSlot const *>(header + 1);
+  m_traders = m_products + header->ProductSlots;
+  return true;
+}
+
+uint32_t PositionViewReader::product_count() const noexcept {
+  return m_header->ProductCount.load(std::memory_order_acquire);
+}
+
+uint32_t PositionViewReader::trader_count() const noexcept {
+  return m_header->TraderCount.load(std::memory_order_acquire);
+}
+
+uint32_t PositionViewReader::dropped() const noexcept {
+  return m_header->Dropped.load(std::memory_order_relaxed);
+}
+
+std::optional<PositionRecord>
+PositionViewReader::product(uint32_t index) const noexcept {
+  return load(m_products[index]);
+}
+
+std::optional<PositionRecord>
+PositionViewReader::trader(uint32_t index) const noexcept {
+  return load(m_traders[index]);
+}
+
+std::optional<PositionRecord>
+PositionViewReader::load(PositionSlot const &slot) noexcept {
+  PositionRecord record;
+  for (int i = 0; i < MAX_READ_RETRIES; ++i) {
+    if (slot.try_load(record)) {
+      return record;
+    }
+  }
+  return std::nullopt;
+}
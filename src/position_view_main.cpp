@@ -0,0 +1,86 @@
+#include "include/position_view.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+void usage() {
+  char const *usage = R"(
+    ./build/position_view <view file> [--watch=MS]
+
+    Prints the positions a running server publishes with --position-view.
+    With --watch the view is printed again every MS milliseconds.
+  )";
+  std::cerr << usage << std::endl;
+}
+
+/**
+ * @brief Print every product and every connected trader of the view.
+ */
+void print_view(PositionViewReader const &reader) {
+  uint32_t products = reader.product_count();
+  std::cout << "Products: " << products << "\n";
+  for (uint32_t i = 0; i < products; ++i) {
+    std::optional<PositionRecord> rec = reader.product(i);
+    if (!rec.has_value()) {
+      std::cout << "Product slot " << i << " is busy\n";
+      continue;
+    }
+    std::cout << "ProductId: " << rec->Id << ", NetPos: " << rec->NetPos
+              << ", BuyQty: " << rec->BuyQty << ", SellQty: " << rec->SellQty
+              << ", GrossNotional: " << fixed_to_double(rec->Exposure.gross())
+              << ", NetNotional: " << fixed_to_double(rec->Exposure.net())
+              << "\n";
+  }
+
+  std::cout << "Traders:\n";
+  for (uint32_t i = 0; i < reader.trader_count(); ++i) {
+    std::optional<PositionRecord> rec = reader.trader(i);
+    if (!rec.has_value()) {
+      std::cout << "Trader slot " << i << " is busy\n";
+      continue;
+    }
+    if (rec->Id == 0) { // free slot
+      continue;
+    }
+    std::cout << "TraderId: " << rec->Id
+              << ", GrossNotional: " << fixed_to_double(rec->Exposure.gross())
+              << ", NetNotional: " << fixed_to_double(rec->Exposure.net())
+              << "\n";
+  }
+
+  if (reader.dropped() != 0) {
+    std::cout << "Dropped updates, the view is full: " << reader.dropped()
+              << "\n";
+  }
+  std::cout << std::endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    usage();
+    return 1;
+  }
+
+  long watchMs = 0;
+  if (argc == 3) {
+    std::string arg = argv[2];
+    if (arg.rfind("--watch=", 0) != 0) {
+      usage();
+      return 1;
+    }
+    watchMs = std::stol(arg.substr(8));
+  }
+
+  PositionViewReader reader;
+  if (!reader.open(argv[1])) {
+    return 1;
+  }
+
+  print_view(reader);
+  while (watchMs > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(watchMs));
+    print_view(reader);
+  }
+  return 0;
+}
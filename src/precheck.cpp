@@ -0,0 +1,47 @@
+#include "include/precheck.h"
+#include <algorithm>
+#include <array>
+
+static constexpr size_t PRECHECK_BLOCK = 64; // orders per word of the bitmap
+
+void precheck_orders(ServerInfo const &info, ProductTable const &products,
+                     LimitTree const &groups, NotionalExposure const &trader,
+                     std::span<WhatIfOrder const> orders,
+                     std::span<uint64_t> passed) {
+  static constexpr ProductInfo EMPTY{}; // listings without state
+  std::array<ProductInfo const *, PRECHECK_BLOCK> block;
+  std::array<uint32_t, PRECHECK_BLOCK> blockGroups;
+  for (size_t base = 0; base < orders.size(); base += PRECHECK_BLOCK) {
+    size_t count = std::min(PRECHECK_BLOCK, orders.size() - base);
+    std::span<WhatIfOrder const> chunk = orders.subspan(base, count);
+
+    // gather: independent lookups, their cache misses overlap
+    for (size_t i = 0; i < count; ++i) {
+      auto it = products.find(chunk[i].ListingId);
+      bool known = it != products.end();
+      block[i] = known ? &it->second : &EMPTY;
+      blockGroups[i] =
+          known ? it->second.Group : groups.group_of(chunk[i].ListingId);
+    }
+
+    // evaluate: the same arithmetic as a NewOrder, on copies of the state
+    uint64_t bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+      WhatIfOrder const &ord = chunk[i];
+      RiskDelta delta =
+          RiskDelta::resting(ord.Side, ord.Quantity, ord.OrderPrice, 1);
+      ProductInfo prod = *block[i];
+      NotionalExposure exposure = trader;
+      prod.apply(delta);
+      apply_delta(exposure, delta.Exposure);
+      Notional grossDelta =
+          notional_sub(prod.Exposure.gross(), block[i]->Exposure.gross());
+      bool exceeds = ord.Quantity > QUANTITY_MAX || !block[i]->fits(delta) ||
+                     info.exceeds_limits(prod, exposure) ||
+                     groups.exceeds_limits(blockGroups[i], delta.Exposure,
+                                           grossDelta);
+      bits |= uint64_t{!exceeds} << i;
+    }
+    passed[base / PRECHECK_BLOCK] = bits;
+  }
+}
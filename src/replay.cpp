@@ -0,0 +1,490 @@
+#include "include/replay.h"
+#include "include/protocol.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+/**
+ * @brief Routes the requests of the log to their listing partition, tracking
+ * which listing every order id of a trader was placed on.
+ */
+class LogPartitioner {
+  ReplayLog &m_log;
+  std::unordered_map<uint64_t, size_t> m_partitionOf;
+  // trader -> order id -> listing of the NewOrder that used the id
+  std::unordered_map<uint32_t, std::unordered_map<uint64_t, uint64_t>>
+      m_orderListing;
+  // trader -> listings the trader placed orders on since the last cancel
+  std::unordered_map<uint32_t, std::set<uint64_t>> m_traderListings;
+
+public:
+  explicit LogPartitioner(ReplayLog &log)
+      : m_log(log), m_partitionOf(), m_orderListing(), m_traderListings() {}
+
+  /**
+   * @brief Route one record of the log.
+   * @return false if the record carries no risk or cannot be decoded
+   */
+  bool add(OrderLogRecord const &record, char const *frame) {
+    if (record.Version == ORDER_LOG_SESSION_END) {
+      cancel_trader(record.TraderId);
+      return true;
+    }
+    if (record.Version == ORDER_LOG_EXCHANGE_FILL) {
+      return add_exchange_fill(record, frame);
+    }
+    if (record.Version < PROTOCOL_V1 || record.Version > PROTOCOL_MAX ||
+        record.FrameSize < sizeof(Header) + sizeof(uint16_t)) {
+      return false;
+    }
+
+    switch (load_u16(record.Version, frame + sizeof(Header))) {
+    case NewOrder::MESSAGE_TYPE:
+      return add_request<NewOrder>(record, frame);
+    case DeleteOrder::MESSAGE_TYPE:
+      return add_request<DeleteOrder>(record, frame);
+    case ModifyOrderQuantity::MESSAGE_TYPE:
+      return add_request<ModifyOrderQuantity>(record, frame);
+    case Trade::MESSAGE_TYPE:
+      return add_request<Trade>(record, frame);
+    case CancelAll::MESSAGE_TYPE:
+      return add_request<CancelAll>(record, frame);
+    case CancelByListing::MESSAGE_TYPE:
+      return add_request<CancelByListing>(record, frame);
+    default: // Hello and PreCheck carry no risk
+      return false;
+    }
+  }
+
+private:
+  template <Sendable T>
+  bool add_request(OrderLogRecord const &record, char const *frame) {
+    WireCodec<T> const &codec = WIRE_CODECS<T>[record.Version];
+    if (codec.FrameSize != record.FrameSize) {
+      return false;
+    }
+    Message<T> msg;
+    codec.Decode(frame, msg);
+    return route(record.TraderId, msg.data);
+  }
+
+  bool add_exchange_fill(OrderLogRecord const &record, char const *frame) {
+    if (record.FrameSize != sizeof(ExchangeFillRecord)) {
+      return false;
+    }
+    ExchangeFillRecord fill;
+    std::memcpy(&fill, frame, sizeof(fill));
+    push(fill.ListingId, ReplayEvent{.Type = ReplayEvent::Kind::ExchangeFill,
+                                     .Side = fill.Side,
+                                     .TraderId = record.TraderId,
+                                     .OrderId = fill.OrderId,
+                                     .Quantity = fill.Quantity,
+                                     .Price = fill.Price,
+                                     .Rested = fill.Rested});
+    return true;
+  }
+
+  bool route(uint32_t traderId, NewOrder const &order) {
+    // A live order id reused on another listing is replayed as a new order
+    // of that listing, the id is not checked across partitions
+    m_orderListing[traderId][order.orderId] = order.listingId;
+    m_traderListings[traderId].insert(order.listingId);
+    push(order.listingId, ReplayEvent{.Type = ReplayEvent::Kind::New,
+                                      .Side = order.side,
+                                      .TraderId = traderId,
+                                      .OrderId = order.orderId,
+                                      .Quantity = order.orderQuantity,
+                                      .Price = order.orderPrice});
+    return true;
+  }
+
+  bool route(uint32_t traderId, DeleteOrder const &order) {
+    return push_for_order(traderId, order.orderId,
+                          ReplayEvent{.Type = ReplayEvent::Kind::Delete,
+                                      .TraderId = traderId,
+                                      .OrderId = order.orderId});
+  }
+
+  bool route(uint32_t traderId, ModifyOrderQuantity const &order) {
+    return push_for_order(traderId, order.orderId,
+                          ReplayEvent{.Type = ReplayEvent::Kind::Modify,
+                                      .TraderId = traderId,
+                                      .OrderId = order.orderId,
+                                      .Quantity = order.newQuantity});
+  }
+
+  bool route(uint32_t traderId, Trade const &trade) {
+    // The server checks the listing of a fill against its order, a fill on
+    // another listing lands in a partition that does not know the order
+    push(trade.listingId, ReplayEvent{.Type = ReplayEvent::Kind::Fill,
+                                      .TraderId = traderId,
+                                      .OrderId = trade.tradeId,
+                                      .Quantity = trade.tradeQuantity,
+                                      .Price = trade.tradePrice});
+    return true;
+  }
+
+  bool route(uint32_t traderId, CancelAll const &) {
+    cancel_trader(traderId);
+    return true;
+  }
+
+  bool route(uint32_t traderId, CancelByListing const &cancel) {
+    auto listings_it = m_traderListings.find(traderId);
+    if (listings_it == m_traderListings.end() ||
+        listings_it->second.erase(cancel.listingId) == 0) {
+      return true; // nothing rests on the listing
+    }
+    push(cancel.listingId,
+         ReplayEvent{.Type = ReplayEvent::Kind::CancelTrader,
+                     .TraderId = traderId});
+    return true;
+  }
+
+  bool push_for_order(uint32_t traderId, uint64_t orderId,
+                      ReplayEvent const &event) {
+    auto trader_it = m_orderListing.find(traderId);
+    if (trader_it == m_orderListing.end()) {
+      return false; // rejected under any limits
+    }
+    auto order_it = trader_it->second.find(orderId);
+    if (order_it == trader_it->second.end()) {
+      return false;
+    }
+    push(order_it->second, event);
+    return true;
+  }
+
+  void cancel_trader(uint32_t traderId) {
+    auto listings_it = m_traderListings.find(traderId);
+    if (listings_it != m_traderListings.end()) {
+      for (uint64_t listingId : listings_it->second) {
+        push(listingId, ReplayEvent{.Type = ReplayEvent::Kind::CancelTrader,
+                                    .TraderId = traderId});
+      }
+      m_traderListings.erase(listings_it);
+    }
+    m_orderListing.erase(traderId);
+  }
+
+  void push(uint64_t listingId, ReplayEvent const &event) {
+    auto [pos, inserted] =
+        m_partitionOf.try_emplace(listingId, m_log.Partitions.size());
+    if (inserted) {
+      m_log.Listings.push_back(listingId);
+      m_log.Partitions.emplace_back();
+    }
+    m_log.Partitions[pos->second].push_back(event);
+  }
+};
+
+struct ReplayOrder {
+  char Side{0};
+  uint64_t Quantity{0};
+  uint64_t Price{0};
+};
+
+/**
+ * @brief State of one listing under one set of limits, mirrors the checks of
+ * Connection for the product limits.
+ */
+struct ListingReplay {
+  ReplayLimits Limits;
+  ProductInfo Product{};
+  std::unordered_map<uint32_t, std::unordered_map<uint64_t, ReplayOrder>>
+      Orders{}; // resting orders by trader and order id
+  std::unordered_map<uint32_t, ListingPosition>
+      Positions{}; // filled position by trader
+  std::map<uint32_t, TraderReplayStats> Traders{};
+
+  /**
+   * @brief Apply a delta to the product unless it breaks the limits.
+   * @return false if the delta was rejected
+   */
+  bool apply_risk(RiskDelta const &delta, bool enforce) {
+    if (enforce && !Product.fits(delta)) {
+      return false;
+    }
+    ProductInfo prod = Product;
+    prod.apply(delta);
+    if (enforce && Limits.exceeds_limits(prod)) {
+      return false;
+    }
+    Product = prod;
+    return true;
+  }
+
+  void handle(ReplayEvent const &event) {
+    TraderReplayStats &stats = Traders[event.TraderId];
+    std::unordered_map<uint64_t, ReplayOrder> &orders =
+        Orders[event.TraderId];
+    auto ord_it = orders.find(event.OrderId);
+
+    switch (event.Type) {
+    case ReplayEvent::Kind::New: {
+      ++stats.NewOrders;
+      if (ord_it != orders.end() || event.Quantity > QUANTITY_MAX ||
+          !apply_risk(RiskDelta::resting(event.Side, event.Quantity,
+                                         event.Price, 1),
+                      true)) {
+        ++stats.NewRejected;
+        return;
+      }
+      orders.emplace(event.OrderId, ReplayOrder{.Side = event.Side,
+                                                .Quantity = event.Quantity,
+                                                .Price = event.Price});
+      return;
+    }
+    case ReplayEvent::Kind::Delete: {
+      if (ord_it == orders.end()) {
+        return;
+      }
+      ReplayOrder const &ord = ord_it->second;
+      apply_risk(RiskDelta::resting(ord.Side, ord.Quantity, ord.Price, -1),
+                 false);
+      orders.erase(ord_it);
+      return;
+    }
+    case ReplayEvent::Kind::Modify: {
+      ++stats.Modifies;
+      if (ord_it == orders.end() || event.Quantity > QUANTITY_MAX) {
+        ++stats.ModifyRejected;
+        return;
+      }
+      ReplayOrder &ord = ord_it->second;
+      RiskDelta delta =
+          RiskDelta::resting(ord.Side, event.Quantity, ord.Price, 1);
+      RiskDelta removed =
+          RiskDelta::resting(ord.Side, ord.Quantity, ord.Price, -1);
+      delta.BuyQty += removed.BuyQty;
+      delta.SellQty += removed.SellQty;
+      if (!apply_risk(delta, event.Quantity > ord.Quantity)) {
+        ++stats.ModifyRejected;
+        return;
+      }
+      ord.Quantity = event.Quantity;
+      if (ord.Quantity == 0) {
+        orders.erase(ord_it);
+      }
+      return;
+    }
+    case ReplayEvent::Kind::Fill: {
+      ++stats.Fills;
+      if (ord_it == orders.end() || ord_it->second.Quantity < event.Quantity ||
+          !Product.fits(RiskDelta::traded(ord_it->second.Side,
+                                          event.Quantity))) {
+        ++stats.FillsDropped;
+        return;
+      }
+      ReplayOrder &ord = ord_it->second;
+      apply_risk(RiskDelta::fill(ord.Side, event.Quantity, event.Quantity,
+                                 ord.Price, event.Price,
+                                 Positions[event.TraderId]),
+                 false);
+      ord.Quantity -= event.Quantity;
+      if (ord.Quantity == 0) {
+        orders.erase(ord_it);
+      }
+      return;
+    }
+    case ReplayEvent::Kind::ExchangeFill: {
+      // Like the server, a fill racing a cancel or a decrease is booked and
+      // only releases what the server released, as far as it still rests
+      ++stats.Fills;
+      bool rests = event.Rested != 0 && ord_it != orders.end() &&
+                   ord_it->second.Side == event.Side;
+      uint64_t rested =
+          rests ? std::min(event.Rested, ord_it->second.Quantity) : 0;
+      apply_risk(RiskDelta::fill(event.Side, event.Quantity, rested,
+                                 rests ? ord_it->second.Price : event.Price,
+                                 event.Price, Positions[event.TraderId]),
+                 false);
+      if (rests) {
+        ord_it->second.Quantity -= rested;
+        if (ord_it->second.Quantity == 0) {
+          orders.erase(ord_it);
+        }
+      }
+      return;
+    }
+    case ReplayEvent::Kind::CancelTrader: {
+      for (auto const &[orderId, ord] : orders) {
+        apply_risk(RiskDelta::resting(ord.Side, ord.Quantity, ord.Price, -1),
+                   false);
+      }
+      Orders.erase(event.TraderId);
+      return;
+    }
+    }
+  }
+};
+
+/**
+ * @brief Replay one partition under every set of limits, event by event.
+ * @return the per trader statistics of every set of limits
+ */
+std::vector<std::map<uint32_t, TraderReplayStats>>
+replay_partition(std::vector<ReplayEvent> const &events,
+                 std::vector<ReplayLimits> const &limits) {
+  std::vector<ListingReplay> states;
+  states.reserve(limits.size());
+  for (ReplayLimits const &lim : limits) {
+    states.push_back(ListingReplay{.Limits = lim});
+  }
+  for (ReplayEvent const &event : events) {
+    for (ListingReplay &state : states) {
+      state.handle(event);
+    }
+  }
+
+  std::vector<std::map<uint32_t, TraderReplayStats>> stats;
+  stats.reserve(states.size());
+  for (ListingReplay &state : states) {
+    stats.push_back(std::move(state.Traders));
+  }
+  return stats;
+}
+
+/**
+ * @brief Deque of partitions of one worker. The owner takes from the front,
+ * the largest partitions first, thieves take from the back.
+ */
+struct WorkerQueue {
+  std::mutex Mutex{};
+  std::deque<size_t> Tasks{};
+
+  std::optional<size_t> pop_front() {
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (Tasks.empty()) {
+      return std::nullopt;
+    }
+    size_t task = Tasks.front();
+    Tasks.pop_front();
+    return task;
+  }
+
+  std::optional<size_t> steal_back() {
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (Tasks.empty()) {
+      return std::nullopt;
+    }
+    size_t task = Tasks.back();
+    Tasks.pop_back();
+    return task;
+  }
+};
+
+} // namespace
+
+bool load_order_log(std::string const &path, ReplayLog &log) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::perror("order log open: ");
+    return false;
+  }
+  std::vector<char> data((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+
+  OrderLogHeader header;
+  if (data.size() < sizeof(header)) {
+    std::cerr << "Not an order log: " << path << "\n";
+    return false;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.Magic != ORDER_LOG_MAGIC || header.Version != ORDER_LOG_VERSION) {
+    std::cerr << "Not an order log of version " << ORDER_LOG_VERSION << ": "
+              << path << "\n";
+    return false;
+  }
+
+  LogPartitioner partitioner(log);
+  size_t pos = sizeof(header);
+  while (data.size() - pos >= sizeof(OrderLogRecord)) {
+    OrderLogRecord record;
+    std::memcpy(&record, data.data() + pos, sizeof(record));
+    pos += sizeof(record);
+    if (data.size() - pos < record.FrameSize) {
+      break; // the server stopped in the middle of a write
+    }
+
+    ++log.Records;
+    if (!partitioner.add(record, data.data() + pos)) {
+      ++log.Skipped;
+    }
+    pos += record.FrameSize;
+  }
+  if (pos != data.size()) {
+    std::cerr << "Ignoring a truncated record at the end of " << path << "\n";
+  }
+  return true;
+}
+
+std::vector<ReplayResult> replay_order_log(ReplayLog const &log,
+                                           std::vector<ReplayLimits> const
+                                               &limits,
+                                           unsigned threads) {
+  size_t partitions = log.Partitions.size();
+  threads = std::max(1u, threads);
+
+  // Deal the partitions, largest first, round robin over the workers
+  std::vector<size_t> order(partitions);
+  for (size_t i = 0; i < partitions; ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&log](size_t a, size_t b) {
+    return log.Partitions[a].size() > log.Partitions[b].size();
+  });
+  std::vector<WorkerQueue> queues(threads);
+  for (size_t i = 0; i < partitions; ++i) {
+    queues[i % threads].Tasks.push_back(order[i]);
+  }
+
+  std::vector<std::vector<std::map<uint32_t, TraderReplayStats>>> results(
+      partitions);
+  auto worker = [&](unsigned self) {
+    while (true) {
+      std::optional<size_t> task = queues[self].pop_front();
+      for (unsigned i = 1; !task.has_value() && i < threads; ++i) {
+        task = queues[(self + i) % threads].steal_back();
+      }
+      if (!task.has_value()) { // nothing new is ever queued
+        return;
+      }
+      results[*task] = replay_partition(log.Partitions[*task], limits);
+    }
+  };
+
+  {
+    std::vector<std::jthread> workers;
+    for (unsigned i = 1; i < threads; ++i) {
+      workers.emplace_back(worker, i);
+    }
+    worker(0);
+  }
+
+  // Merge in partition order, the totals do not depend on who ran what
+  std::vector<ReplayResult> merged(limits.size());
+  for (size_t cfg = 0; cfg < limits.size(); ++cfg) {
+    merged[cfg].Limits = limits[cfg];
+  }
+  for (auto const &partition : results) {
+    for (size_t cfg = 0; cfg < partition.size(); ++cfg) {
+      for (auto const &[traderId, stats] : partition[cfg]) {
+        merged[cfg].Traders[traderId].merge(stats);
+        merged[cfg].Total.merge(stats);
+      }
+    }
+  }
+  return merged;
+}
@@ -0,0 +1,122 @@
+#include "include/replay.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+void usage() {
+  char const *usage = R"(
+    ./build/replay <order log> --limits=BUY:SELL [--limits=BUY:SELL ...]
+                   [--threads=N] [--per-trader=1]
+
+    Replays an order log written by the server with --order-log and reports
+    the NewOrder and ModifyOrderQuantity requests every set of buy / sell
+    limits would have rejected. All the limits are evaluated in one pass.
+
+    Options:
+      --limits=BUY:SELL           a set of limits to evaluate, repeatable
+      --threads=N                 worker threads, default one per core
+      --per-trader=0|1            also print the results of every trader
+  )";
+  std::cerr << usage << std::endl;
+}
+
+/**
+ * @brief Parse BUY:SELL into a set of limits.
+ * @return false if the value is malformed
+ */
+bool parse_limits(std::string const &value, ReplayLimits &limits) {
+  size_t colon = value.find(':');
+  if (colon == std::string::npos) {
+    return false;
+  }
+  limits.BuyLimit = std::stoull(value.substr(0, colon));
+  limits.SellLimit = std::stoull(value.substr(colon + 1));
+  return true;
+}
+
+void print_stats(TraderReplayStats const &stats) {
+  std::printf("%12lu %12lu %12lu %12lu %12lu\n", stats.NewOrders,
+              stats.NewRejected, stats.Modifies, stats.ModifyRejected,
+              stats.FillsDropped);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    usage();
+    return 1;
+  }
+
+  std::vector<ReplayLimits> limits;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  bool perTrader = false;
+  try {
+    for (int i = 2; i < argc; ++i) {
+      std::string arg = argv[i];
+      size_t eq = arg.find('=');
+      std::string name = eq == std::string::npos ? arg : arg.substr(0, eq);
+      std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+      ReplayLimits lim;
+      if (name == "--limits" && parse_limits(value, lim)) {
+        limits.push_back(lim);
+      } else if (name == "--threads") {
+        threads = std::stoul(value);
+      } else if (name == "--per-trader") {
+        perTrader = value == "1";
+      } else {
+        std::cerr << "Unknown or malformed option: " << arg << "\n";
+        usage();
+        return 1;
+      }
+    }
+  } catch (std::exception const &) {
+    usage();
+    return 1;
+  }
+  if (limits.empty()) {
+    usage();
+    return 1;
+  }
+
+  ReplayLog log;
+  auto start = std::chrono::steady_clock::now();
+  if (!load_order_log(argv[1], log)) {
+    return 1;
+  }
+  auto loaded = std::chrono::steady_clock::now();
+  std::vector<ReplayResult> results = replay_order_log(log, limits, threads);
+  auto done = std::chrono::steady_clock::now();
+
+  std::printf("%lu records (%lu skipped) over %zu listings, loaded in %.1f ms, "
+              "replayed with %u threads in %.1f ms\n\n",
+              log.Records, log.Skipped, log.Listings.size(),
+              std::chrono::duration<double, std::milli>(loaded - start).count(),
+              threads,
+              std::chrono::duration<double, std::milli>(done - loaded).count());
+  std::printf("%12s %12s %12s %12s %12s %12s %12s\n", "BuyLimit", "SellLimit",
+              "NewOrders", "NewRejected", "Modifies", "ModRejected",
+              "FillsDropped");
+  for (ReplayResult const &result : results) {
+    std::printf("%12lu %12lu ", result.Limits.BuyLimit,
+                result.Limits.SellLimit);
+    print_stats(result.Total);
+  }
+
+  if (!perTrader) {
+    return 0;
+  }
+  for (ReplayResult const &result : results) {
+    std::printf("\nLimits %lu:%lu\n%12s %12s %12s %12s %12s %12s\n",
+                result.Limits.BuyLimit, result.Limits.SellLimit, "TraderId",
+                "NewOrders", "NewRejected", "Modifies", "ModRejected",
+                "FillsDropped");
+    for (auto const &[traderId, stats] : result.Traders) {
+      std::printf("%12u ", traderId);
+      print_stats(stats);
+    }
+  }
+  return 0;
+}
@@ -1,21 +1,86 @@
 #include "include/server.h"
 #include "include/connection.h"
+#include "include/instrumentation.h"
+#include "include/metrics.h"
 #include "include/server_util.h"
+#include "include/tuning.h"
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <util/util.h>
 
+/// Modification time of a file, 0 if it cannot be read
+static int64_t file_mtime_ns(std::string const &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) == -1) {
+    return 0;
+  }
+  return st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
 Server::Server(std::string host, std::string port, ServerConfig info)
-    : m_clientName(), m_resources(), m_info(), m_clientAddr(), m_sinSize() {
+    : m_hotMemory(hot_memory_bytes(info.ExpectedListings, info.ExpectedTraders,
+                                   info.OrdersPerTrader),
+                  info.HugePages),
+      m_clientName(), m_resources(m_hotMemory.resource()), m_info(),
+      m_clientAddr(), m_sinSize(), m_metrics(), m_snapshots(), m_positions(),
+      m_gateway(), m_journal(), m_dropCopy(),
+      m_context{m_info,
+                m_resources.ProductMap,
+                m_resources.Groups,
+                m_resources.DirtyProducts,
+                m_positions,
+                m_gateway,
+                m_journal,
+                m_dropCopy,
+                m_hotMemory.resource()},
+      m_timers(TIMER_TICK_NS, FastClock::now_ns()), m_snapshotBatch(),
+      m_departed(), m_limitsMtimeNs(0), m_reloadPending(false), m_executor() {
 
   m_info.Host = std::move(host);
   m_info.Port = std::move(port);
   m_info.BuyLimit = std::move(info.BuyLimit);
   m_info.SellLimit = std::move(info.SellLimit);
+  m_info.ProductGrossLimit = info.ProductGrossLimit;
+  m_info.ProductNetLimit = info.ProductNetLimit;
+  m_info.TraderGrossLimit = info.TraderGrossLimit;
+  m_info.TraderNetLimit = info.TraderNetLimit;
+  m_info.MsgRate = info.MsgRate;
+  m_info.MsgBurst = info.MsgBurst;
+  m_info.FairBudget = std::max(info.FairBudget, 1u);
+  m_info.OverloadLoopNs = info.OverloadLoopNs;
+  m_info.OverloadQueueBytes = info.OverloadQueueBytes;
+  m_info.MetricsPort = std::move(info.MetricsPort);
+  m_info.HeartbeatMs = info.HeartbeatMs;
+  m_info.SnapshotIntervalMs = std::max<uint64_t>(info.SnapshotIntervalMs, 1);
+  m_info.SnapshotFile = std::move(info.SnapshotFile);
+  m_info.SnapshotSocket = std::move(info.SnapshotSocket);
+  m_info.PositionViewFile = std::move(info.PositionViewFile);
+  m_info.PositionViewProducts = info.PositionViewProducts;
+  m_info.PositionViewTraders = info.PositionViewTraders;
+  m_info.SpinPoll = info.SpinPoll;
+  m_info.CoroutineSessions = info.CoroutineSessions;
+  m_info.ExpectedListings = info.ExpectedListings;
+  m_info.ExpectedTraders = info.ExpectedTraders;
+  m_info.OrdersPerTrader = info.OrdersPerTrader;
+  m_info.HugePages = info.HugePages;
+  m_info.PinCpu = info.PinCpu;
+  m_info.FifoPriority = info.FifoPriority;
+  m_info.LockMemory = info.LockMemory;
+  m_info.BusyPollUs = info.BusyPollUs;
+  m_info.Exchange = std::move(info.Exchange);
+  m_info.MockFillPct = info.MockFillPct;
+  m_info.OrderLogFile = std::move(info.OrderLogFile);
+  m_info.DropCopy = std::move(info.DropCopy);
+  m_info.GroupLimitsFile = std::move(info.GroupLimitsFile);
+  m_info.ExecutorThreads = info.ExecutorThreads;
 
   std::optional<int> listener_opt = get_listener_fd();
   if (!listener_opt.has_value()) {
@@ -27,7 +92,17 @@ Server::Server(std::string host, std::string port, ServerConfig info)
 Server::~Server() {}
 
 void Server::listen() {
-  if (::listen(m_resources.ListenerFd, BACK_LOG) == -1) {
+  reserve_capacity(); // before the first trader can connect
+  if (!m_info.GroupLimitsFile.empty()) {
+    m_limitsMtimeNs = file_mtime_ns(m_info.GroupLimitsFile);
+    if (!m_resources.Groups.load(m_info.GroupLimitsFile)) {
+      exit(1);
+    }
+    std::cout << "Enforcing " << m_resources.Groups.size()
+              << " group limits from: " << m_info.GroupLimitsFile << "\n";
+  }
+  if (fcntl(m_resources.ListenerFd, F_SETFL, O_NONBLOCK) == -1 ||
+      ::listen(m_resources.ListenerFd, SESSION_BACK_LOG) == -1) {
     std::perror("server listen: ");
     close(m_resources.ListenerFd);
     exit(1);
@@ -38,40 +113,202 @@ void Server::listen() {
   listfd.events = POLLIN;
   m_resources.Fds.emplace_back(std::move(listfd)); // add listener to poll set
   std::cout << "Server started listening on port: " << m_info.Port << "\n";
+
+  if (!m_info.MetricsPort.empty() && m_metrics.start(m_info.MetricsPort)) {
+    std::cout << "Serving metrics on port: " << m_info.MetricsPort << "\n";
+  }
+  if (!m_snapshots.start(m_info.SnapshotFile, m_info.SnapshotSocket)) {
+    exit(1);
+  }
+  if (!m_info.PositionViewFile.empty()) {
+    if (!m_positions.create(m_info.PositionViewFile,
+                            m_info.PositionViewProducts,
+                            m_info.PositionViewTraders)) {
+      exit(1);
+    }
+    std::cout << "Publishing positions to: " << m_info.PositionViewFile
+              << "\n";
+  }
+  if (!m_info.Exchange.empty()) {
+    if (!m_gateway.start(m_info.Exchange, m_info.MockFillPct)) {
+      exit(1);
+    }
+    pollfd fillfd;
+    fillfd.fd = m_gateway.fill_fd();
+    fillfd.events = POLLIN;
+    m_resources.Fds.emplace_back(std::move(fillfd));
+    std::cout << "Forwarding accepted orders to: " << m_info.Exchange << "\n";
+  }
+  if (!m_info.OrderLogFile.empty()) {
+    if (!m_journal.open(m_info.OrderLogFile)) {
+      exit(1);
+    }
+    std::cout << "Journaling requests to: " << m_info.OrderLogFile << "\n";
+  }
+  if (!m_info.DropCopy.empty()) {
+    if (!m_dropCopy.start(m_info.DropCopy)) {
+      exit(1);
+    }
+    std::cout << "Copying risk decisions to: " << m_info.DropCopy << "\n";
+  }
+  if (!m_executor.start(m_info.ExecutorThreads)) {
+    exit(1);
+  }
+  if (m_executor.completion_fd() != INVALID_FD) {
+    pollfd donefd;
+    donefd.fd = m_executor.completion_fd();
+    donefd.events = POLLIN;
+    m_resources.Fds.emplace_back(std::move(donefd));
+    std::cout << "Running the slow path on " << m_executor.threads()
+              << " executor threads\n";
+  }
+  if (m_info.LockMemory && lock_memory()) { // after the startup allocations
+    std::cout << "Locked the server memory\n";
+  }
+}
+
+void Server::reserve_capacity() {
+  uint32_t listings = m_info.ExpectedListings;
+  uint32_t traders = m_info.ExpectedTraders;
+  m_resources.ProductMap.reserve(listings);
+  m_resources.DirtyProducts.reserve(listings);
+  m_snapshotBatch.reserve(listings);
+  // the listener, the standard streams and the helper threads take fds too
+  m_resources.Fds.reserve(traders + 8);
+  m_resources.Connections.reserve(traders + 64);
+  m_timers.reserve(traders + 8);
+
+  if (m_hotMemory.size() != 0) {
+    std::cout << "Reserved " << (m_hotMemory.size() >> 20)
+              << " MB of hot memory for " << listings << " listings, "
+              << traders << " traders, " << m_info.OrdersPerTrader
+              << " orders per trader"
+              << (m_hotMemory.huge_tlb() ? " on explicit huge pages" : "")
+              << "\n";
+  }
 }
 
 void Server::run() {
+  tune_event_loop_thread();
+  AdmissionState admission;
+  bool pending = false; // requests left over by the fair budget
+  uint64_t queuedBytes = 0;
+  uint64_t sweepNs = 0; // time spent serving the previous sweep
+  uint64_t now = FastClock::now_ns();
+  m_timers.schedule(now + NS_PER_SEC,
+                    ServerTimer{.Type = ServerTimer::Kind::Recalibrate});
+  m_timers.schedule(now + m_info.SnapshotIntervalMs * 1000000,
+                    ServerTimer{.Type = ServerTimer::Kind::Snapshot});
+  if (!m_info.GroupLimitsFile.empty()) {
+    m_timers.schedule(now + NS_PER_SEC,
+                      ServerTimer{.Type = ServerTimer::Kind::ReloadLimits});
+  }
   while (true) {
-    int poll_num = poll(m_resources.Fds.data(), m_resources.Fds.size(), -1);
+    // do not block while requests are buffered or a timer is due
+    int poll_num = poll(m_resources.Fds.data(), m_resources.Fds.size(),
+                        poll_timeout_ms(pending));
     if (poll_num == -1) {
       std::perror("poll");
       exit(1);
     }
+    if (poll_num == 0 && !pending) { // idle, only timers are due
+      fire_timers(FastClock::now_ns());
+      flush_outputs(); // the cancels of an eviction go out right away
+      continue;
+    }
 
-    std::cout << "Request Nums: " << poll_num << std::endl;
+    // shed load if the previous sweep was too slow or left too much queued
+    uint64_t sweepStart = FastClock::now_ns();
+    admission.Overloaded =
+        (m_info.OverloadLoopNs != 0 && sweepNs > m_info.OverloadLoopNs) ||
+        (m_info.OverloadQueueBytes != 0 &&
+         queuedBytes > m_info.OverloadQueueBytes);
+    admission.NowNs = sweepStart;
+    // without buffered requests only the fds with events need a look, idle
+    // sessions are not even touched
+    bool const runnable = pending;
+    pending = false;
+    queuedBytes = 0;
 
-    std::cout << "Fds size: " << m_resources.Fds.size() << std::endl;
-    for (auto const &fd : m_resources.Fds) {
-      std::cout << "it->fd: " << fd.fd << std::endl;
-      if (fd.revents & POLLIN) {
-        if (fd.fd == m_resources.ListenerFd) {
+    // new connections are appended to Fds so iterate over a stable snapshot
+    size_t const nfds = m_resources.Fds.size();
+    for (size_t idx = 0; idx != nfds; ++idx) {
+      pollfd const fd = m_resources.Fds[idx];
+      if (fd.revents == 0 && !runnable) {
+        continue;
+      }
+      if (fd.fd == m_resources.ListenerFd) {
+        if (fd.revents & POLLIN) {
           handle_new_connection();
-        } else {
-          std::cout << "New request\n";
-          std::cout << "conn fd: " << fd.fd << std::endl;
-          m_resources.Connections[fd.fd]->handle_client_request();
+        }
+        continue;
+      }
+      if (fd.fd == m_gateway.fill_fd()) {
+        if (fd.revents & POLLIN) {
+          apply_fills();
+        }
+        continue;
+      }
+      if (fd.fd == m_executor.completion_fd()) {
+        if (fd.revents & POLLIN) {
+          m_executor.run_completions();
+        }
+        continue;
+      }
+
+      Connection *conn = m_resources.Connections.get(fd.fd);
+      bool readable = fd.revents & (POLLIN | POLLHUP | POLLERR);
+      bool writable = fd.revents & POLLOUT;
+      if (conn == nullptr ||
+          (!readable && !writable && !conn->has_runnable_request())) {
+        continue;
+      }
+
+      if (!conn->handle_client_request(readable, admission, writable)) {
+        deregister_connection(*m_resources.Connections.handle(fd.fd));
+        continue;
+      }
+      pending = pending || conn->has_runnable_request();
+      queuedBytes += conn->buffered_bytes();
+    }
+
+    // drop the pollfds of the connections deregistered during the sweep
+    std::erase_if(m_resources.Fds,
+                  [](pollfd const &pfd) { return pfd.fd < 0; });
+    if (m_info.CoroutineSessions) { // a blocked session waits for POLLOUT
+      for (pollfd &pfd : m_resources.Fds) {
+        if (Connection *conn = m_resources.Connections.get(pfd.fd)) {
+          pfd.events = conn->poll_events();
         }
       }
     }
+    // evicted sessions are compacted next sweep, their cancels go out now
+    fire_timers(FastClock::now_ns());
+    flush_outputs();
+    sweepNs = FastClock::now_ns() - sweepStart;
+    Metrics::add(Metric::LoopIterations);
+    Metrics::add(Metric::LoopTimeNsTotal, sweepNs);
+    Metrics::set(Metric::LoopTimeNsLast, sweepNs);
+    Instrumentation::on_sweep(poll_num, sweepNs);
   }
 }
 
+void Server::flush_outputs() {
+  m_gateway.flush(); // one wake up of the gateway per iteration
+  m_journal.flush();
+  m_dropCopy.flush();
+}
+
 int Server::accept_connection() {
   m_sinSize = sizeof(struct sockaddr_storage);
-  int new_fd = accept(m_resources.ListenerFd,
-                      reinterpret_cast<sockaddr *>(&m_clientAddr), &m_sinSize);
+  // coroutine sessions suspend instead of blocking on their socket
+  int new_fd = accept4(m_resources.ListenerFd,
+                       reinterpret_cast<sockaddr *>(&m_clientAddr), &m_sinSize,
+                       m_info.CoroutineSessions ? SOCK_NONBLOCK : 0);
   if (new_fd == -1) {
-    std::perror("server accept:");
+    if (errno != EAGAIN && errno != EWOULDBLOCK) { // else the queue is empty
+      std::perror("server accept:");
+    }
     return INVALID_FD;
   }
   return new_fd;
@@ -86,33 +323,234 @@ void Server::print_new_connection() {
 }
 
 void Server::handle_new_connection() {
-  int new_fd = accept_connection(); // get fd for connection
-  if (new_fd == INVALID_FD) {
-    return;
-  }
+  // drain a connect storm in bursts, without starving the open sessions
+  for (int accepted = 0; accepted != ACCEPT_BURST; ++accepted) {
+    int new_fd = accept_connection(); // get fd for connection
+    if (new_fd == INVALID_FD) {
+      return;
+    }
 
-  pollfd conn_fd;
-  conn_fd.fd = new_fd;
-  conn_fd.events = POLLIN;
-  m_resources.Fds.push_back(conn_fd);
+    // fills are pushed without a request to piggyback on, Nagle would hold
+    // them back until the trader acknowledges the previous response
+    int yes = 1;
+    setsockopt(new_fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    if (m_info.BusyPollUs != 0) {
+      set_busy_poll(new_fd, m_info.BusyPollUs);
+    }
 
-  m_resources.Connections.insert_or_assign(
-      new_fd, std::make_shared<Connection>(new_fd, this));
-  print_new_connection();
+    pollfd conn_fd;
+    conn_fd.fd = new_fd;
+    conn_fd.events = POLLIN;
+    m_resources.Fds.push_back(conn_fd);
+
+    ConnectionHandle handle = m_resources.Connections.emplace(
+        new_fd, m_resources.NextTraderId++, &m_context,
+        m_info.CoroutineSessions);
+    if (m_info.HeartbeatMs != 0) {
+      m_timers.schedule(FastClock::now_ns() + m_info.HeartbeatMs * 1000000,
+                        ServerTimer{.Type = ServerTimer::Kind::Heartbeat,
+                                    .Session = handle});
+    }
+    Metrics::add(Metric::SessionsAccepted);
+    Metrics::add(Metric::ActiveSessions);
+    print_new_connection();
+  }
 }
 
-void Server::deregister_connection(std::shared_ptr<Connection> conn) {
+void Server::deregister_connection(ConnectionHandle handle) {
+  Connection *conn = m_resources.Connections.get(handle);
+  if (conn == nullptr) {
+    std::cerr << "No such connection in the server\n";
+    return; // No such connection exists
+  }
+
   int socket = conn->get_socket();
   auto pos =
       std::find_if(m_resources.Fds.begin(), m_resources.Fds.end(),
                    [socket](pollfd const &pfd) { return socket == pfd.fd; });
-  if (pos == m_resources.Fds.end()) {
-    std::cerr << "No such connection in the server\n";
-    return; // No such connection exists
+
+  m_journal.append(FastClock::now_ns(), conn->get_trader_id(),
+                   ORDER_LOG_SESSION_END, nullptr, 0);
+  conn->discard_trader_state();          // release the resting orders
+  if (PositionTable positions = conn->release_positions();
+      m_gateway.enabled() && !positions.empty()) { // fills may still arrive
+    m_departed.insert_or_assign(conn->get_trader_id(), std::move(positions));
+  }
+  m_positions.release_trader(conn->get_view_slot());
+  // the socket is closed on the slow path, the fd is not reused until then
+  m_executor.post(
+      [transport = std::shared_ptr<Transport>(conn->release_transport())] {});
+  m_resources.Connections.erase(handle);
+  Metrics::add(Metric::SessionsClosed);
+  Metrics::sub(Metric::ActiveSessions);
+  if (pos != m_resources.Fds.end()) {
+    pos->fd = -1; // poll ignores negative fds until the sweep compacts them
+  }
+}
+
+void Server::reload_group_limits() {
+  if (m_reloadPending) {
+    return;
+  }
+  m_reloadPending = true;
+  m_executor.post([this, path = m_info.GroupLimitsFile,
+                   loadedNs = m_limitsMtimeNs] {
+    int64_t mtimeNs = file_mtime_ns(path);
+    if (mtimeNs == loadedNs) {
+      m_executor.complete([this] { m_reloadPending = false; });
+      return;
+    }
+    // parsed here, only the validated limits reach the event loop
+    auto loaded = std::make_shared<LimitTree>();
+    bool valid = loaded->load(path);
+    m_executor.complete([this, loaded, valid, mtimeNs, path] {
+      m_reloadPending = false;
+      m_limitsMtimeNs = mtimeNs; // a broken file is retried once edited
+      if (!valid || !m_resources.Groups.update_limits(*loaded)) {
+        std::cerr << "Keeping the group limits, " << path
+                  << " is invalid or changes the groups\n";
+        return;
+      }
+      std::cout << "Reloaded the group limits from: " << path << "\n";
+    });
+  });
+}
+
+void Server::apply_fills() {
+  m_gateway.drain_fills([this](GatewayFill const &fill) {
+    Connection *conn = m_resources.Connections.get(fill.TraderFd);
+    if (conn == nullptr || conn->get_trader_id() != fill.TraderId) {
+      book_departed_fill(fill); // the trader is gone, its position is not
+      return;
+    }
+    conn->handle_fill(fill);
+  });
+}
+
+void Server::book_departed_fill(GatewayFill const &fill) {
+  uint64_t nowNs = FastClock::now_ns();
+  Trade trade = fill.trade();
+  m_journal.append_fill(nowNs, fill.TraderId, fill.record());
+
+  PositionTable &positions = m_departed[fill.TraderId];
+  auto position_it = positions.try_emplace(fill.ListingId).first;
+  RiskDelta delta = RiskDelta::fill(fill.Side, fill.Quantity, 0, fill.Price,
+                                    fill.Price, position_it->second);
+  ProductInfo &current = m_context.product(fill.ListingId);
+  ProductInfo prod = current;
+  prod.apply(delta);
+  m_context.commit(fill.ListingId, current, prod, delta.Exposure,
+                   notional_sub(prod.Exposure.gross(),
+                                current.Exposure.gross()));
+  if (position_it->second.NetPos == 0) { // flat, nothing left to track
+    positions.erase(position_it);
+    if (positions.empty()) {
+      m_departed.erase(fill.TraderId);
+    }
+  }
+
+  Instrumentation::on_decision(
+      fill.TraderId, Trade::MESSAGE_TYPE,
+      static_cast<uint16_t>(OrderResponse::Status::ACCEPTED));
+  m_dropCopy.publish(DropCopyEvent{
+      .TimestampNs = nowNs,
+      .TraderId = fill.TraderId,
+      .MessageType = Trade::MESSAGE_TYPE,
+      .Status = static_cast<uint16_t>(OrderResponse::Status::ACCEPTED),
+      .OrderId = trade.tradeId,
+      .ListingId = trade.listingId,
+      .Quantity = trade.tradeQuantity,
+      .Price = trade.tradePrice});
+}
+
+void Server::tune_event_loop_thread() {
+  if (m_info.PinCpu >= 0 && pin_thread(m_info.PinCpu)) {
+    std::cout << "Event loop pinned to cpu: " << m_info.PinCpu << "\n";
+  }
+  if (m_info.FifoPriority > 0 && set_fifo_priority(m_info.FifoPriority)) {
+    std::cout << "Event loop runs SCHED_FIFO at: " << m_info.FifoPriority
+              << "\n";
+  }
+  if (m_info.LockMemory) {
+    prefault_stack();
+  }
+}
+
+void Server::publish_snapshot(uint64_t nowNs) {
+  if (m_resources.DirtyProducts.empty()) {
+    return;
+  }
+
+  for (uint64_t productId : m_resources.DirtyProducts) {
+    ProductInfo &prod = m_resources.ProductMap[productId];
+    prod.Dirty = false;
+    m_snapshotBatch.push_back(ProductSnapshot{productId, prod});
+  }
+  m_resources.DirtyProducts.clear();
+  m_snapshots.publish(m_snapshotBatch, nowNs);
+}
+
+int Server::poll_timeout_ms(bool pending) const {
+  if (pending || m_info.SpinPoll) {
+    return 0;
+  }
+  // orders held back by the gateway are retried every millisecond
+  int const limit = m_gateway.backlogged() ? 1 : -1;
+  uint64_t next = m_timers.next_deadline_ns();
+  if (next == UINT64_MAX) {
+    return limit;
+  }
+
+  uint64_t now = FastClock::now_ns();
+  if (now >= next) {
+    return 0;
+  }
+  int timeout = static_cast<int>((next - now + 999999) / 1000000);
+  return limit == -1 ? timeout : std::min(timeout, limit);
+}
+
+void Server::fire_timers(uint64_t nowNs) {
+  m_timers.advance(nowNs, [this, nowNs](ServerTimer const &timer) {
+    switch (timer.Type) {
+    case ServerTimer::Kind::Heartbeat:
+      check_heartbeat(timer.Session, nowNs);
+      break;
+    case ServerTimer::Kind::Snapshot: // publish the changed products
+      publish_snapshot(nowNs);
+      m_timers.schedule(nowNs + m_info.SnapshotIntervalMs * 1000000, timer);
+      break;
+    case ServerTimer::Kind::Recalibrate: // refine the TSC rate
+      FastClock::recalibrate();
+      m_timers.schedule(FastClock::now_ns() + NS_PER_SEC, timer);
+      break;
+    case ServerTimer::Kind::ReloadLimits: // pick up edited group limits
+      reload_group_limits();
+      m_timers.schedule(nowNs + NS_PER_SEC, timer);
+      break;
+    }
+  });
+}
+
+void Server::check_heartbeat(ConnectionHandle handle, uint64_t nowNs) {
+  Connection *conn = m_resources.Connections.get(handle);
+  if (conn == nullptr) {
+    return; // closed in the meantime, the fd may belong to a new session
+  }
+
+  // a session that never sent anything missed its first heartbeat
+  uint64_t lastNs = conn->get_stamps().IngressNs;
+  uint64_t deadline = lastNs + m_info.HeartbeatMs * 1000000;
+  if (lastNs != 0 && deadline > nowNs) {
+    m_timers.schedule(deadline,
+                      ServerTimer{.Type = ServerTimer::Kind::Heartbeat,
+                                  .Session = handle});
+    return;
   }
 
-  m_resources.Connections.erase(socket); // remove connection for this socket
-  m_resources.Fds.erase(pos); // remove the socket from the pollfd list
+  std::cout << "Evicting trader " << conn->get_trader_id()
+            << " after a missed heartbeat\n";
+  Metrics::add(Metric::SessionsEvicted);
+  deregister_connection(handle);
 }
 
 void Server::print_system_state() {
@@ -1,26 +1,166 @@
 #include "include/server.h"
 #include <iostream>
+#include <vector>
 
 void usage() {
   char const *usage = R"(
-    ./build/server <buy limit> <sell limit>
+    ./build/server <buy limit> <sell limit> [product gross notional]
+                   [product net notional] [trader gross notional]
+                   [trader net notional] [--option=value ...]
+
+    Notional limits carry 4 implicit decimals like prices on the wire and
+    are unlimited when omitted.
+
+    Options:
+      --msg-rate=N                messages per second per session, 0 = off
+      --msg-burst=N               messages a session can save up
+      --fair-budget=N             messages per session per loop iteration
+      --overload-loop-ns=N        loop time that triggers load shedding
+      --overload-queue-bytes=N    buffered bytes that trigger load shedding
+      --metrics-port=N            serve Prometheus metrics on 127.0.0.1:N
+      --heartbeat-ms=N            evict traders that send nothing for N ms
+      --snapshot-interval-ms=N    how often changed products are published
+      --snapshot-file=PATH        append snapshots to a file instead of stdout
+      --snapshot-socket=PATH      publish snapshots to UNIX socket subscribers
+      --position-view=PATH        share live positions through a mapped file
+      --position-view-products=N  product slots of the position view
+      --position-view-traders=N   trader slots of the position view
+      --poll-mode=block|spin      block in poll or spin on it, default block
+      --cpu=N                     pin the event loop to core N
+      --sched-fifo=N              run the event loop SCHED_FIFO at priority N
+      --mlock=0|1                 lock and pre-fault the server memory
+      --busy-poll-us=N            SO_BUSY_POLL budget of the trader sockets
+      --session-mode=MODE         state (default) or coroutine sessions
+      --expected-listings=N       size the product tables for N listings
+      --expected-traders=N        size the session tables for N traders
+      --orders-per-trader=N       size the order tables for N resting orders
+      --huge-pages=MODE           off (default), thp or explicit huge pages
+      --exchange=mock|HOST:PORT   forward accepted orders to an exchange
+      --mock-fill-pct=N           share of each order the mock exchange fills
+      --order-log=PATH            journal every request for ./build/replay
+      --drop-copy=PORT|PATH       copy every risk decision to subscribers on
+                                  127.0.0.1:PORT or a UNIX socket
+      --group-limits=PATH         enforce the group limits in PATH, reloaded
+                                  when the file changes
+      --executor-threads=N        slow path workers, 0 = on the event loop
   )";
   std::cerr << usage << std::endl;
 }
 
+/**
+ * @brief Parse a single --name=value option into the config.
+ * @return false if the option is unknown or malformed
+ */
+bool parse_option(std::string const &arg, ServerConfig &config) {
+  size_t eq = arg.find('=');
+  if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+    return false;
+  }
+
+  std::string name = arg.substr(2, eq - 2);
+  std::string value = arg.substr(eq + 1);
+  if (name == "msg-rate") {
+    config.MsgRate = std::stoul(value);
+  } else if (name == "msg-burst") {
+    config.MsgBurst = std::stoul(value);
+  } else if (name == "fair-budget") {
+    config.FairBudget = std::stoul(value);
+  } else if (name == "overload-loop-ns") {
+    config.OverloadLoopNs = std::stoull(value);
+  } else if (name == "overload-queue-bytes") {
+    config.OverloadQueueBytes = std::stoull(value);
+  } else if (name == "metrics-port") {
+    config.MetricsPort = value;
+  } else if (name == "heartbeat-ms") {
+    config.HeartbeatMs = std::stoull(value);
+  } else if (name == "snapshot-interval-ms") {
+    config.SnapshotIntervalMs = std::stoull(value);
+  } else if (name == "snapshot-file") {
+    config.SnapshotFile = value;
+  } else if (name == "snapshot-socket") {
+    config.SnapshotSocket = value;
+  } else if (name == "position-view") {
+    config.PositionViewFile = value;
+  } else if (name == "position-view-products") {
+    config.PositionViewProducts = std::stoul(value);
+  } else if (name == "position-view-traders") {
+    config.PositionViewTraders = std::stoul(value);
+  } else if (name == "poll-mode" && (value == "block" || value == "spin")) {
+    config.SpinPoll = value == "spin";
+  } else if (name == "session-mode" &&
+             (value == "state" || value == "coroutine")) {
+    config.CoroutineSessions = value == "coroutine";
+  } else if (name == "expected-listings") {
+    config.ExpectedListings = std::stoul(value);
+  } else if (name == "expected-traders") {
+    config.ExpectedTraders = std::stoul(value);
+  } else if (name == "orders-per-trader") {
+    config.OrdersPerTrader = std::stoul(value);
+  } else if (name == "huge-pages" && value == "off") {
+    config.HugePages = HugePageMode::Off;
+  } else if (name == "huge-pages" && value == "thp") {
+    config.HugePages = HugePageMode::Transparent;
+  } else if (name == "huge-pages" && value == "explicit") {
+    config.HugePages = HugePageMode::Explicit;
+  } else if (name == "cpu") {
+    config.PinCpu = std::stoi(value);
+  } else if (name == "sched-fifo") {
+    config.FifoPriority = std::stoi(value);
+  } else if (name == "mlock") {
+    config.LockMemory = std::stoi(value) != 0;
+  } else if (name == "busy-poll-us") {
+    config.BusyPollUs = std::stoi(value);
+  } else if (name == "exchange") {
+    config.Exchange = value;
+  } else if (name == "mock-fill-pct") {
+    config.MockFillPct = std::stoul(value);
+  } else if (name == "order-log") {
+    config.OrderLogFile = value;
+  } else if (name == "drop-copy") {
+    config.DropCopy = value;
+  } else if (name == "group-limits") {
+    config.GroupLimitsFile = value;
+  } else if (name == "executor-threads") {
+    config.ExecutorThreads = std::stoul(value);
+  } else {
+    return false;
+  }
+  return true;
+}
+
 int main(int argc, char **argv) {
   ServerConfig Config;
-  if (argc == 0 || argc != 2) {
+  std::vector<std::string> positional;
+  for (int arg = 1; arg < argc; ++arg) {
+    std::string value{argv[arg]};
+    if (value.rfind("--", 0) != 0) {
+      positional.push_back(std::move(value));
+    } else if (!parse_option(value, Config)) {
+      std::cerr << "Unknown option: " << value << "\n";
+      usage();
+      return 1;
+    }
+  }
+
+  if (positional.size() < 2) {
     Config.BuyLimit = 100;
     Config.SellLimit = 100;
     usage();
   } else {
-    Config.BuyLimit = std::stoull(argv[1]);
-    Config.SellLimit = std::stoull(argv[2]);
+    Config.BuyLimit = std::stoull(positional[0]);
+    Config.SellLimit = std::stoull(positional[1]);
+  }
+
+  Notional *notionalLimits[] = {
+      &Config.ProductGrossLimit, &Config.ProductNetLimit,
+      &Config.TraderGrossLimit, &Config.TraderNetLimit};
+  for (size_t arg = 2; arg < positional.size() && arg < 6; ++arg) {
+    *notionalLimits[arg - 2] = std::stoll(positional[arg]);
   }
   std::string g_host{"127.0.0.1"};
   std::string g_port{"4000"};
 
+  FastClock::calibrate();
   Server srv{g_host, g_port, Config};
   srv.listen();
   srv.run();
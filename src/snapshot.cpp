@@ -0,0 +1,134 @@
+#include "include/snapshot.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+SnapshotPublisher::SnapshotPublisher()
+    : m_mutex(), m_cv(), m_pending(), m_pendingNs(0),
+      m_fileFd(STDOUT_FILENO), m_listenerFd(INVALID_FD), m_subscribers(),
+      m_thread() {}
+
+SnapshotPublisher::~SnapshotPublisher() {
+  if (m_thread.joinable()) {
+    m_thread.request_stop();
+    m_thread.join();
+  }
+  for (int fd : m_subscribers) {
+    close(fd);
+  }
+  if (m_listenerFd != INVALID_FD) {
+    close(m_listenerFd);
+  }
+  if (m_fileFd != STDOUT_FILENO) {
+    close(m_fileFd);
+  }
+}
+
+bool SnapshotPublisher::start(std::string const &file,
+                              std::string const &socketPath) {
+  if (!file.empty()) {
+    m_fileFd = open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (m_fileFd == -1) {
+      std::perror("snapshot open: ");
+      m_fileFd = STDOUT_FILENO;
+      return false;
+    }
+  }
+
+  if (!socketPath.empty()) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socketPath.c_str());
+
+    m_listenerFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (m_listenerFd == -1 ||
+        bind(m_listenerFd, reinterpret_cast<sockaddr *>(&addr),
+             sizeof(addr)) == -1 ||
+        listen(m_listenerFd, BACK_LOG) == -1) {
+      std::perror("snapshot socket: ");
+      return false;
+    }
+  }
+
+  m_thread = std::jthread([this](std::stop_token stop) { run(stop); });
+  return true;
+}
+
+void SnapshotPublisher::publish(std::vector<ProductSnapshot> &batch,
+                                uint64_t nowNs) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending.empty()) {
+      m_pending.swap(batch);
+    } else { // the writer fell behind, newer entries win when written
+      m_pending.insert(m_pending.end(), batch.begin(), batch.end());
+    }
+    m_pendingNs = nowNs;
+  }
+  batch.clear();
+  m_cv.notify_one();
+}
+
+void SnapshotPublisher::run(std::stop_token stop) {
+  std::vector<ProductSnapshot> batch;
+  while (!stop.stop_requested()) {
+    uint64_t tickNs = 0;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      // wake up regularly to pick up new subscribers
+      m_cv.wait_for(lock, stop, std::chrono::milliseconds(200),
+                    [this]() { return !m_pending.empty(); });
+      batch.swap(m_pending);
+      tickNs = m_pendingNs;
+    }
+
+    if (m_listenerFd != INVALID_FD) {
+      accept_subscribers();
+    }
+    if (batch.empty()) {
+      continue;
+    }
+
+    std::ostringstream out;
+    out << "Snapshot: " << tickNs << ", Products: " << batch.size() << "\n";
+    for (ProductSnapshot const &snap : batch) {
+      out << "ProductId: " << snap.ProductId << ", " << snap.Info << "\n";
+    }
+    write_out(out.str());
+    batch.clear();
+  }
+}
+
+void SnapshotPublisher::accept_subscribers() {
+  int fd;
+  while ((fd = accept4(m_listenerFd, nullptr, nullptr, SOCK_NONBLOCK)) != -1) {
+    m_subscribers.push_back(fd);
+  }
+}
+
+void SnapshotPublisher::write_out(std::string const &text) {
+  if (m_listenerFd == INVALID_FD) {
+    if (write(m_fileFd, text.data(), text.size()) == -1) {
+      std::perror("snapshot write: ");
+    }
+    return;
+  }
+
+  // a subscriber whose socket buffer is full is too slow and gets dropped
+  std::erase_if(m_subscribers, [&text](int fd) {
+    ssize_t n = send(fd, text.data(), text.size(), MSG_NOSIGNAL);
+    if (n != static_cast<ssize_t>(text.size())) {
+      close(fd);
+      return true;
+    }
+    return false;
+  });
+}
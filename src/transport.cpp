@@ -0,0 +1,39 @@
+#include "include/transport.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+SocketTransport::~SocketTransport() {
+  shutdown(m_fd, SHUT_RDWR);
+  close(m_fd);
+}
+
+ssize_t SocketTransport::read(char *buf, size_t size) {
+  return recv(m_fd, buf, size, 0);
+}
+
+ssize_t SocketTransport::write(char const *buf, size_t size) {
+  // a trader that hung up fails the write instead of raising SIGPIPE
+  return send(m_fd, buf, size, MSG_NOSIGNAL);
+}
+
+ssize_t MemoryTransport::read(char *buf, size_t size) {
+  if (m_nonBlocking && !has_input()) {
+    errno = EAGAIN;
+    return -1;
+  }
+  size_t nbytes = std::min({size, m_chunk, m_input.size() - m_inputPos});
+  std::memcpy(buf, m_input.data() + m_inputPos, nbytes);
+  m_inputPos += nbytes;
+  return static_cast<ssize_t>(nbytes); // 0 once consumed, like a hang up
+}
+
+ssize_t MemoryTransport::write(char const *buf, size_t size) {
+  if (m_capture != nullptr) {
+    m_capture->insert(m_capture->end(), buf, buf + size);
+  }
+  m_bytesOut += size;
+  return static_cast<ssize_t>(size);
+}
@@ -0,0 +1,51 @@
+#include "include/tuning.h"
+#include <cstdio>
+#include <cstring>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+bool pin_thread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) == -1) { // 0 = calling thread
+    std::perror("tuning sched_setaffinity: ");
+    return false;
+  }
+  return true;
+}
+
+bool set_fifo_priority(int priority) {
+  sched_param param;
+  std::memset(&param, 0, sizeof(param));
+  param.sched_priority = priority;
+  if (sched_setscheduler(0, SCHED_FIFO, &param) == -1) {
+    std::perror("tuning sched_setscheduler: ");
+    return false;
+  }
+  return true;
+}
+
+bool lock_memory() {
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+    std::perror("tuning mlockall: ");
+    return false;
+  }
+  return true;
+}
+
+void prefault_stack() {
+  volatile char stack[STACK_PREFAULT_BYTES];
+  for (size_t offset = 0; offset < sizeof(stack); offset += 4096) {
+    stack[offset] = 0;
+  }
+}
+
+bool set_busy_poll(int fd, int usec) {
+  if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) == -1) {
+    std::perror("tuning setsockopt SO_BUSY_POLL: ");
+    return false;
+  }
+  return true;
+}